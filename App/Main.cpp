@@ -7,6 +7,10 @@
 #include <cctype>
 #include <fstream>
 #include <filesystem> 
+#include <chrono>
+#include <cstring>
+#include <charconv>
+#include <vector>
 
 #include <juce_core/juce_core.h>
 #include <juce_audio_devices/juce_audio_devices.h>
@@ -21,6 +25,29 @@
 #include "midi_pulse.h"
 #include "letter_binds.h"
 #include "parse_line.h"
+#include "trace.h"
+#include "engine_callback.h"
+#include "engine_stats.h"
+#include "play_latency.h"
+#include "logger.h"
+#include "metrics.h"
+#include "memory_report.h"
+#include "golden.h"
+#include "rt_selfcheck.h"
+#include "quantum_bench.h"
+#include "q31_check.h"
+#include "parallel_render.h"
+#include "realtime_setup.h"
+#include "isa_dispatch.h"
+#include "fixed_rate.h"
+#include "analyzer_taps.h"
+#include "lazy_gates.h"
+#include "scenes.h"
+#include "journal.h"
+#include "load_test.h"
+#include "graph_export.h"
+#include "calibration.h"
+#include "score_profile.h"
 
 static std::atomic_bool keepRunning { true };
 
@@ -29,51 +56,257 @@ static void signalHandler (int)
     keepRunning = false;
 }
 
-static void printGraphStructure (std::shared_ptr<juce::AudioProcessorGraph> graph)
+static void printMultiRateSummary (std::shared_ptr<juce::AudioProcessorGraph> graph)
 {
-    std::cout << "=== Nodes ===\n";
+    int voices = 0, half = 0, quarter = 0;
     for (auto* node : graph->getNodes())
     {
-        std::cout << "Node ID: " << static_cast<int> (node->nodeID.uid)
-                  << ", Processor: " << node->getProcessor()->getName()
-                                         .toStdString()               << '\n';
+        if (auto* osc = dynamic_cast<OscillatorBase*> (node->getProcessor()))
+        {
+            ++voices;
+            half += osc->getDecimation() == 2;
+            quarter += osc->getDecimation() == 4;
+        }
     }
+    if (half + quarter > 0)
+        log_out() << "Multi-rate: " << quarter << " of " << voices << " voices at 1/4 rate, "
+                  << half << " at 1/2 rate\n";
+}
 
-    std::cout << "=== Connections ===\n";
-    for (const auto& c : graph->getConnections())
-    {
-        std::cout << "From Node " << static_cast<int> (c.source.nodeID.uid)
-                  << " [ch "      << c.source.channelIndex      << "]  →  "
-                  << "Node "      << static_cast<int> (c.destination.nodeID.uid)
-                  << " [ch "      << c.destination.channelIndex << "]\n";
+static int calibration_block(FixedRateHost& host) {
+    return host.getBlockSize() > 0 ? host.getBlockSize() : 512;
+}
+
+// Measures, applies and saves; the kernel level is applied by the measuring
+static void calibrate(EngineCallback& engine, FixedRateHost& host) {
+    const auto profile = calibration::run(calibration_block(host), log_out());
+    engine.setQuantum(profile.quantum);
+    if (calibration::save(calibration::profile_path(), profile)) {
+        log_out() << "Calibration saved to '" << calibration::profile_path().string() << "'\n";
+    } else {
+        log_err() << "Cannot write calibration profile '" << calibration::profile_path().string() << "'\n";
     }
+    isa::print_report(log_out());
+}
+
+// A profile measured on this CPU model at this block size, if there is one
+static void apply_saved_calibration(EngineCallback& engine, FixedRateHost& host) {
+    const auto profile = calibration::load(calibration::profile_path());
+    if (!profile || profile->cpu != calibration::cpu_model() || profile->block != calibration_block(host)) {
+        return;
+    }
+    engine.setQuantum(profile->quantum);
+    if (isa::source() != isa::Source::argument) {
+        isa::select(profile->level, isa::Source::calibration);
+    }
+    log_out() << "Calibration from '" << calibration::profile_path().string() << "': "
+              << (profile->quantum > 0 ? "quantum " + std::to_string(profile->quantum) : std::string("whole blocks"))
+              << ", " << isa::level_name(isa::kernels().level) << " kernels\n";
+}
+
+// What a journal records before its first command: every scene, every letter
+// binding, the quantum and multirate as they are now, and the score if one plays
+static std::vector<std::string> journal_preamble(const LetterRegistry& reg, const SceneBank& scenes, const EngineCallback& engine,
+                                                 const std::string& score, bool playing) {
+    auto lines = scenes.replay_lines();
+    for (auto& line : reg.set_lines()) {
+        lines.push_back(std::move(line));
+    }
+    lines.push_back("QUANTUM " + (engine.getQuantum() > 0 ? std::to_string(engine.getQuantum()) : std::string("OFF")));
+    lines.push_back(OscillatorBase::is_multirate_enabled() ? "MULTIRATE ON" : "MULTIRATE OFF");
+    if (!score.empty()) {
+        lines.push_back("\"" + score + "\"");
+    }
+    if (playing) {
+        lines.push_back("PLAY");
+    }
+    return lines;
 }
 
 struct InputProcessor {
-    InputProcessor(LetterRegistry &reg_in, Parser &parse_in, std::shared_ptr<juce::AudioProcessorGraph> graph_in) :
-        reg(reg_in), parse(parse_in), graph(graph_in) {}
+    InputProcessor(LetterRegistry &reg_in, Parser &parse_in, std::shared_ptr<juce::AudioProcessorGraph> graph_in, EngineCallback &engine_in, FixedRateHost &host_in) :
+        reg(reg_in), parse(parse_in), graph(graph_in), engine(engine_in), host(host_in) {}
 
     void process_line(std::string line) {
+        const auto received_us = Tracer::nowUs();
         bool set_command = line.starts_with("SET");
         bool play_command = line.starts_with("PLAY");
         bool pause_command = line.starts_with("PAUSE");
         bool print_command = line.starts_with("PRINT");
+        bool trace_command = line.starts_with("TRACE");
+        bool stats_command = line.starts_with("STATS");
+        bool metrics_command = line.starts_with("METRICS");
+        bool mem_command = line.starts_with("MEM");
+        bool log_command = line.starts_with("LOG");
+        bool multirate_command = line.starts_with("MULTIRATE");
+        bool quantum_command = line.starts_with("QUANTUM");
+        bool quality_command = line.starts_with("QUALITY");
+        bool realtime_command = line.starts_with("REALTIME");
+        bool rate_command = line.starts_with("RATE");
+        bool analyze_command = line.starts_with("ANALYZE");
+        bool lazy_command = line.starts_with("LAZY");
+        bool scene_command = line.starts_with("SCENE");
+        bool morph_command = line.starts_with("MORPH");
+        bool journal_command = line.starts_with("JOURNAL");
+        bool graph_command = line.starts_with("GRAPH");
+        bool calibrate_command = line.starts_with("CALIBRATE");
+        bool profile_command = line.starts_with("PROFILE");
+
+        if (!journal_command) {
+            Journal::get().record(line, EngineStats::get().samplesProcessed.load(std::memory_order_relaxed));
+        }
+
+        CommandCounter counter;
+
+        std::string command_name = line.substr(0, line.find(' '));
+        TraceScope scope("command", command_name.c_str());
+
+        // File paths in arguments keep their case
+        const std::string raw_line = line;
 
         std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return std::tolower(c); });
         if (set_command) {
             execute_bind_command(reg, line);
         } else if (play_command) {
+            auto start = std::chrono::steady_clock::now();
+            auto& latency = PlayLatency::get();
+            latency.begin(received_us);
+            engine.setGraphEmpty(true);
+            Analyzer::get().release_node_taps();
             parse.clear_graph();
+            parse.morph_highest = scenes.highest(&reg);
             parse.parse_and_initialize(saved_graph);
-            printGraphStructure(graph);
+            engine.setGraphEmpty(graph->getNumNodes() <= 1); // an empty score leaves just the output
+            for (auto const &selector : Analyzer::get().selectors) {
+                analysis::attach(*graph, parse.words, selector, host.getSampleRate(), log_err());
+            }
+            record_rebuild(start);
+            latency.finish(); // the latency line follows once the audio thread hears it
+            graph_export::print_summary(log_out(), *graph);
+            printMultiRateSummary(graph);
         } else if (pause_command) {
+            auto start = std::chrono::steady_clock::now();
+            engine.setGraphEmpty(true);
+            Analyzer::get().release_node_taps();
             parse.clear_graph();
+            record_rebuild(start);
         } else if (print_command) {
             if (line.find("v") != std::string::npos) {
-                reg.printBindingsDetailed();
+                reg.printBindingsDetailed(log_out());
             } else {
-                reg.printBindings();
+                reg.printBindings(log_out());
+            }
+        } else if (trace_command) {
+            execute_trace_command(raw_line);
+        } else if (stats_command) {
+            std::istringstream ss(line);
+            std::string cmd, arg;
+            double slo_ms = 0.0;
+            ss >> cmd >> arg >> slo_ms;
+            if (arg == "reset") {
+                EngineStats::get().reset_peaks();
+            } else if (arg == "slo" && slo_ms > 0.0) {
+                PlayLatency::get().set_slo_ms(slo_ms);
+            }
+            EngineStats::get().print(log_out());
+            RealtimeSetup::get().print(log_out());
+            host.print(log_out());
+            LazyGates::get().print(log_out());
+            isa::print_report(log_out());
+            QualityWatchdog::get().print(log_out());
+            PlayLatency::get().print(log_out());
+        } else if (metrics_command) {
+            execute_metrics_command(raw_line);
+        } else if (mem_command) {
+            print_memory_report(graph, parse.words, log_out());
+        } else if (log_command) {
+            execute_log_command(raw_line);
+        } else if (multirate_command) {
+            OscillatorBase::set_multirate_enabled(line.find("off") == std::string::npos);
+            log_out() << "Multi-rate rendering " << (OscillatorBase::is_multirate_enabled() ? "on" : "off")
+                      << " (takes effect at the next PLAY).\n";
+        } else if (quantum_command) {
+            std::istringstream ss(line);
+            std::string cmd, arg;
+            ss >> cmd >> arg;
+            int samples = 0;
+            const auto parsed = std::from_chars(arg.data(), arg.data() + arg.size(), samples);
+            if (arg != "off" && (arg.empty() || parsed.ec != std::errc {} || parsed.ptr != arg.data() + arg.size() || samples < 0)) {
+                log_err() << "Usage: QUANTUM <samples>|OFF\n";
+                return;
+            }
+            engine.setQuantum(samples);
+            if (engine.getQuantum() > 0) {
+                log_out() << "Graph runs in " << engine.getQuantum() << "-sample pieces of each device block.\n";
+            } else {
+                log_out() << "Graph runs on whole device blocks.\n";
+            }
+        } else if (quality_command) {
+            std::istringstream ss(line);
+            std::string cmd, arg;
+            ss >> cmd >> arg;
+            auto& watchdog = QualityWatchdog::get();
+            if (arg == "auto") {
+                watchdog.set_automatic();
+            } else if (!arg.empty()) {
+                int tier = 0;
+                const auto parsed = std::from_chars(arg.data(), arg.data() + arg.size(), tier);
+                if (parsed.ec != std::errc {} || parsed.ptr != arg.data() + arg.size()
+                    || tier < 0 || tier >= QualityWatchdog::numTiers) {
+                    log_err() << "Usage: QUALITY [<tier 0-" << QualityWatchdog::numTiers - 1 << ">|AUTO]\n";
+                    return;
+                }
+                watchdog.pin(tier);
+            }
+            watchdog.print(log_out());
+        } else if (realtime_command) {
+            execute_realtime_command(line);
+        } else if (analyze_command) {
+            execute_analyze_command(raw_line);
+        } else if (scene_command) {
+            execute_scene_command(raw_line);
+        } else if (morph_command) {
+            execute_morph_command(raw_line);
+        } else if (journal_command) {
+            execute_journal_command(raw_line);
+        } else if (graph_command) {
+            execute_graph_command(raw_line);
+        } else if (profile_command) {
+            execute_profile_command(raw_line);
+        } else if (calibrate_command) {
+            if (graph->getNumNodes() > 1) {
+                log_err() << "CALIBRATE renders offline on this thread and needs the modulators to itself: PAUSE first\n";
+                return;
             }
+            calibrate(engine, host);
+        } else if (lazy_command) {
+            std::istringstream ss(line);
+            std::string cmd, arg;
+            double seconds = 0.0;
+            ss >> cmd >> arg >> seconds;
+            if (arg == "on" || arg == "off") {
+                parse.lazy_gates = arg == "on";
+                log_out() << "Lazy gates " << arg << " (takes effect at the next PLAY).\n";
+            } else if (arg == "retire" && seconds > 0.0) {
+                LazyGates::get().set_retire_seconds(seconds);
+            } else if (!arg.empty()) {
+                log_err() << "Usage: LAZY [ON|OFF|RETIRE <seconds>]\n";
+                return;
+            }
+            LazyGates::get().print(log_out());
+        } else if (rate_command) {
+            std::istringstream ss(line);
+            std::string cmd, arg;
+            ss >> cmd >> arg;
+            if (arg == "device") {
+                host.setInternalRate(0.0);
+            } else if (!arg.empty() && std::atof(arg.c_str()) >= 8000.0) {
+                host.setInternalRate(std::atof(arg.c_str()));
+            } else if (!arg.empty()) {
+                log_err() << "Usage: RATE <hz>|DEVICE (8000 Hz or more)\n";
+                return;
+            }
+            host.print(log_out());
         } else {
             // This regex is not necessary and is totally overkill, I just
             // wrote this class when first starting the project and thought
@@ -86,23 +319,326 @@ struct InputProcessor {
         }
     }
 
+    // TRACE <file.json> starts recording a Chrome/Perfetto timeline, TRACE OFF stops it
+    void execute_trace_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, arg;
+        ss >> cmd >> arg;
+
+        auto& tracer = Tracer::get();
+        if (arg.empty() || arg == "OFF" || arg == "off") {
+            tracer.stop();
+            log_out() << "Tracing stopped (" << tracer.getDroppedCount() << " events dropped).\n";
+        } else if (tracer.start(arg)) {
+            log_out() << "Tracing to '" << arg << "'. Open it in ui.perfetto.dev after TRACE OFF.\n";
+        } else {
+            log_err() << "Cannot open trace file '" << arg << "'\n";
+        }
+    }
+
+    // PROFILE [seconds]: the score annotated with what each of its letters costs
+    void execute_profile_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd;
+        double seconds = 1.0;
+        ss >> cmd;
+        if (ss >> seconds; seconds <= 0.0) {
+            log_err() << "Usage: PROFILE [seconds]\n";
+            return;
+        }
+        graph_export::measure(*graph, seconds);
+        score_profile::print(log_out(), graph_export::snapshot(*graph, reg, parse.words, seconds));
+    }
+
+    // GRAPH [seconds] prints every node with its measured cost; GRAPH DOT|JSON <file> writes it out
+    void execute_graph_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, format, path;
+        double seconds = 1.0;
+        ss >> cmd >> format;
+        const bool to_file = format == "DOT" || format == "dot" || format == "JSON" || format == "json";
+        if (to_file) {
+            ss >> path >> seconds;
+        } else if (!format.empty()) {
+            seconds = std::atof(format.c_str());
+        }
+        if ((to_file && path.empty()) || seconds <= 0.0) {
+            log_err() << "Usage: GRAPH [seconds] | GRAPH DOT|JSON <file> [seconds]\n";
+            return;
+        }
+
+        graph_export::measure(*graph, seconds);
+        const auto snapshot = graph_export::snapshot(*graph, reg, parse.words, seconds);
+        if (!to_file) {
+            graph_export::print_table(log_out(), snapshot);
+            return;
+        }
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            log_err() << "Cannot write '" << path << "'\n";
+            return;
+        }
+        if (format == "DOT" || format == "dot") {
+            graph_export::write_dot(file, snapshot);
+        } else {
+            graph_export::write_json(file, snapshot);
+        }
+        log_out() << "Wrote " << snapshot.nodes.size() << " nodes and " << snapshot.edges.size()
+                  << " connections to '" << path << "' (measured over " << seconds << " s)\n";
+    }
+
+    // JOURNAL <file> records every command from now on, starting with the current state; JOURNAL OFF stops
+    void execute_journal_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, arg;
+        ss >> cmd >> arg;
+
+        auto& journal = Journal::get();
+        if (arg == "OFF" || arg == "off") {
+            journal.stop();
+        } else if (!arg.empty() && !journal.start(arg, EngineStats::get().sampleRate.load(std::memory_order_relaxed),
+                                                         EngineStats::get().samplesProcessed.load(std::memory_order_relaxed),
+                                                         journal_preamble(reg, scenes, engine, saved_graph, graph->getNumNodes() > 1))) {
+            log_err() << "Cannot write journal '" << arg << "'\n";
+            return;
+        }
+        journal.print(log_out());
+    }
+
+    // LOG <file.jsonl> also appends every console line, as JSON, to a file; LOG OFF stops
+    void execute_log_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, arg;
+        ss >> cmd >> arg;
+
+        auto& log = Log::get();
+        if (arg.empty() || arg == "OFF" || arg == "off") {
+            log.close_file();
+            log_out() << "Log file closed (" << log.getDroppedCount() << " messages dropped so far).\n";
+        } else if (log.open_file(arg)) {
+            log_out() << "Logging to '" << arg << "' as JSON lines.\n";
+        } else {
+            log_err() << "Cannot open log file '" << arg << "'\n";
+        }
+    }
+
+    // REALTIME PRIORITY <n>|OFF, CORES <list>[:<list>]|ALL, MLOCK ON|OFF, PREFAULT ON|OFF
+    void execute_realtime_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, what, arg;
+        ss >> cmd >> what >> arg;
+
+        auto& rt = RealtimeSetup::get();
+        if (what == "priority" && !arg.empty()) {
+            rt.set_priority(arg == "off" ? 0 : std::atoi(arg.c_str()));
+        } else if (what == "cores" && !arg.empty()) {
+            if (!rt.set_cores_from_text(arg)) {
+                log_err() << "REALTIME CORES takes CPU numbers like 2,3 or 2-3:0-1 (audio:workers), or ALL\n";
+                return;
+            }
+        } else if (what == "mlock" && !arg.empty()) {
+            if (const int err = rt.lock_memory(arg != "off"); err != 0) {
+                log_err() << "mlockall failed: " << std::strerror(err) << " (raise RLIMIT_MEMLOCK, ulimit -l)\n";
+            }
+        } else if (what == "prefault" && !arg.empty()) {
+            rt.set_prefault(arg != "off");
+            log_out() << "Prefaulting " << (arg != "off" ? "on" : "off") << " (buffers: from the next PLAY).\n";
+        } else if (!what.empty()) {
+            log_err() << "Usage: REALTIME [PRIORITY <n>|OFF] [CORES <list>[:<list>]|ALL] [MLOCK ON|OFF] [PREFAULT ON|OFF]\n";
+            return;
+        }
+        // Threads apply the change at their next callback or poll; give the
+        // audio thread a few blocks before reporting how it went
+        juce::Thread::sleep(50);
+        rt.print(log_out());
+    }
+
+    // ANALYZE [<letter>|WORD <n>|OUT|SPECTRUM|EXPORT <file.json>|OFF]
+    void execute_analyze_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, what, arg;
+        ss >> cmd >> what >> arg;
+        std::string lower = what;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        auto& analyzer = Analyzer::get();
+        if (what.empty()) {
+            analysis::print_meters(analyzer.reports(), log_out());
+            return;
+        }
+        if (lower == "spectrum") {
+            analysis::print_spectra(analyzer.reports(), log_out());
+            return;
+        }
+        if (lower == "export") {
+            if (arg.empty() || !analysis::export_json(analyzer.reports(), arg)) {
+                log_err() << "Cannot write analysis to '" << arg << "'\n";
+            } else {
+                log_out() << "Wrote " << analyzer.num_taps() << " taps to '" << arg << "'\n";
+            }
+            return;
+        }
+        if (lower == "off") {
+            analyzer.detach_all();
+            analyzer.selectors.clear();
+            log_out() << "All taps detached.\n";
+            return;
+        }
+
+        std::string selector;
+        if (lower == "out") {
+            selector = "out";
+        } else if (lower == "word" && !arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0]))) {
+            selector = "word " + std::to_string(std::atoi(arg.c_str()));
+        } else if (what.size() == 1) {
+            selector = what;
+        } else {
+            log_err() << "Usage: ANALYZE [<letter>|WORD <n>|OUT|SPECTRUM|EXPORT <file.json>|OFF]\n";
+            return;
+        }
+        const int attached = analysis::attach(*graph, parse.words, selector, host.getSampleRate(), log_err());
+        if (std::find(analyzer.selectors.begin(), analyzer.selectors.end(), selector) == analyzer.selectors.end()) {
+            analyzer.selectors.push_back(selector);
+        }
+        log_out() << "Tapped " << attached << " node" << (attached == 1 ? "" : "s") << " for '" << selector
+                  << "' (kept across PLAY); ANALYZE shows levels, ANALYZE SPECTRUM octave bands.\n";
+    }
+
+    // SCENE SAVE <name> | SCENE DROP <name> | SCENE (list them)
+    void execute_scene_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, what, name;
+        ss >> cmd >> what >> name;
+        std::transform(what.begin(), what.end(), what.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (what == "save" && !name.empty()) {
+            scenes.capture(name, reg);
+            log_out() << "Scene '" << name << "' saved at MORPH position " << scenes.index_of(name) << ".\n";
+        } else if (what == "drop" && !name.empty()) {
+            if (!scenes.remove(name)) {
+                log_err() << "No scene '" << name << "'\n";
+                return;
+            }
+        } else if (!what.empty()) {
+            log_err() << "Usage: SCENE [SAVE <name>|DROP <name>]\n";
+            return;
+        }
+        scenes.print(log_out(), reg);
+    }
+
+    // MORPH <position>|<scene> [glide seconds]
+    void execute_morph_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, where;
+        double glide = 0.0;
+        ss >> cmd >> where >> glide;
+
+        double position = -1.0;
+        if (!where.empty() && (std::isdigit(static_cast<unsigned char>(where[0])) || where[0] == '.')) {
+            position = std::atof(where.c_str());
+        } else if (!where.empty()) {
+            position = scenes.index_of(where);
+        }
+        if (scenes.size() == 0 || position < 0.0) {
+            log_err() << "Usage: MORPH <position>|<scene> [glide seconds], after SCENE SAVE; 0 is the first scene\n";
+            return;
+        }
+
+        const auto result = scenes.morph(position, juce::jmax(0.0, glide), reg, *graph);
+        log_out() << "Morphed " << result.letters << " letters, " << result.nodes << " running nodes";
+        if (glide > 0.0) {
+            log_out() << " (gliding over " << glide << " s)";
+        }
+        log_out() << ".\n";
+        if (scenes_exceed_build()) {
+            log_out() << "Scenes saved since the last PLAY go higher than its voices' render rates were chosen for;"
+                         " PLAY again to cover them.\n";
+        }
+        if (!result.skipped.empty()) {
+            log_out() << "Bound to another type in a scene, left alone:";
+            for (char letter : result.skipped) {
+                log_out() << " '" << letter << "'";
+            }
+            log_out() << "\n";
+        }
+    }
+
+    // Whether a scene now reaches above what the playing graph was built for
+    bool scenes_exceed_build() const {
+        for (const auto& [letter, values] : scenes.highest()) {
+            auto built = parse.morph_highest.find(letter);
+            for (std::size_t k = 0; k < values.size(); ++k) {
+                if (built == parse.morph_highest.end() || k >= built->second.size() || values[k] > built->second[k]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // METRICS FILE <path> [seconds] | METRICS SOCKET <path> [seconds] | METRICS OFF
+    void execute_metrics_command(std::string const &line) {
+        std::istringstream ss(line);
+        std::string cmd, kind, path;
+        double interval = 5.0;
+        ss >> cmd >> kind >> path >> interval;
+        std::transform(kind.begin(), kind.end(), kind.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (kind == "off" || kind.empty()) {
+            metrics.stop();
+            log_out() << "Metrics export stopped.\n";
+            return;
+        }
+        if ((kind != "file" && kind != "socket") || path.empty()) {
+            log_err() << "Usage: METRICS FILE <path> [seconds] | METRICS SOCKET <path> [seconds] | METRICS OFF\n";
+            return;
+        }
+
+        auto target = kind == "file" ? MetricsExporter::Target::file : MetricsExporter::Target::socket;
+        if (metrics.start(target, path, interval)) {
+            log_out() << "Publishing metrics to " << kind << " '" << path << "' every " << interval << " s\n";
+        } else {
+            log_err() << "Cannot publish metrics to " << kind << " '" << path << "'\n";
+        }
+    }
+
+    void record_rebuild(std::chrono::steady_clock::time_point start) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        EngineStats::get().record_rebuild(elapsed.count(),
+                                          graph->getNumNodes(),
+                                          static_cast<int>(graph->getConnections().size()));
+    }
+
+    // Counts a command from the moment it is received until it is handled
+    struct CommandCounter {
+        CommandCounter() {
+            EngineStats::get().commands.fetch_add(1, std::memory_order_relaxed);
+            EngineStats::get().commandsInFlight.fetch_add(1, std::memory_order_relaxed);
+        }
+        ~CommandCounter() { EngineStats::get().commandsInFlight.fetch_sub(1, std::memory_order_relaxed); }
+    };
+
     LetterRegistry &reg;
     Parser &parse;
     std::shared_ptr<juce::AudioProcessorGraph> graph;
+    EngineCallback &engine;
+    FixedRateHost &host;
     std::string saved_graph;
+    MetricsExporter metrics;
+    SceneBank scenes;
 };
 
-static void file_mode(std::string const &filename, LetterRegistry &reg, Parser &parse, std::shared_ptr<juce::AudioProcessorGraph> graph) {
+static void file_mode(std::string const &filename, LetterRegistry &reg, Parser &parse, std::shared_ptr<juce::AudioProcessorGraph> graph, EngineCallback &engine, FixedRateHost &host) {
     std::ifstream file(filename);
     if (!file.is_open())
     {
-        std::cerr << "Cannot open command file '" << filename << "'\n";
+        log_err() << "Cannot open command file '" << filename << "'\n";
         return;
     }
 
-    std::cout << "Running commands from '" << filename << "' …\n";
+    log_out() << "Running commands from '" << filename << "' …\n";
 
-    InputProcessor ip(reg, parse, graph);
+    InputProcessor ip(reg, parse, graph, engine, host);
 
     std::string line;
     while (keepRunning.load(std::memory_order_relaxed) &&
@@ -111,7 +647,7 @@ static void file_mode(std::string const &filename, LetterRegistry &reg, Parser &
         // “EXIT” inside file quits run early
         if (line == "EXIT" || line == "exit")
         {
-            std::cout << "'EXIT' directive found in file - stopping.\n";
+            log_out() << "'EXIT' directive found in file - stopping.\n";
             keepRunning.store(false, std::memory_order_relaxed);
             break;
         }
@@ -119,46 +655,109 @@ static void file_mode(std::string const &filename, LetterRegistry &reg, Parser &
         ip.process_line(line);
     }
 
-    std::cout << "[File mode] Finished processing '" << filename << "'. Type EXIT to stop.\n";
+    log_out() << "[File mode] Finished processing '" << filename << "'. Type EXIT to stop.\n";
 
     while (keepRunning) {
         std::getline(std::cin, line);
         if (line == "EXIT") {
-            std::cout << "'EXIT' command received. Signaling stop." << std::endl;
+            log_out() << "'EXIT' command received. Signaling stop." << std::endl;
             keepRunning.store(false, std::memory_order_relaxed); // Signal to stop
             break;
         }
     }
 }
 
-static void interactive_mode(LetterRegistry &reg, Parser &parse, std::shared_ptr<juce::AudioProcessorGraph> graph) {
-    std::cout << "| Hello! This is interactive mode. Commands:" << std::endl;
-    std::cout << "|   Bind a letter:" << std::endl;
-    std::cout << "|       SET <letter> <type> <parameter> <value>...  <- specify types and specific parameters" << std::endl;
-    std::cout << "|           e.g.: SET a sin note 66" << std::endl;
-    std::cout << "|           e.g.: SET a delay time 0.5 feedback 0.4" << std::endl;
-    std::cout << "|       SET <letter> <type>                         <- specifies just type, default parameters are selected" << std::endl;
-    std::cout << "|           e.g.: SET a delay" << std::endl;
-    std::cout << "|   Generate a graph:" << std::endl;
-    std::cout << "|       \"h (el lo)\"                               <- generates a graph with your specified letter bindings." << std::endl;
-    std::cout << "|                                                      Parenthesis have to do with rhythm, so try binding a letter like:" << std::endl;
-    std::cout << "|                                                      SET x midi and then generate something like x (a b)" << std::endl;
-    std::cout << "|   Play/Pause your graph:" << std::endl;
-    std::cout << "|       PLAY" << std::endl;
-    std::cout << "|       PAUSE" << std::endl;
-    std::cout << "|   Print your current letter : type bindings:" << std::endl;
-    std::cout << "|       PRINT" << std::endl;
-    std::cout << "|       PRINT v                                     <- verbose print includes all parameters and their defaults" << std::endl;
+static void interactive_mode(LetterRegistry &reg, Parser &parse, std::shared_ptr<juce::AudioProcessorGraph> graph, EngineCallback &engine, FixedRateHost &host) {
+    log_out() << "| Hello! This is interactive mode. Commands:" << std::endl;
+    log_out() << "|   Bind a letter:" << std::endl;
+    log_out() << "|       SET <letter> <type> <parameter> <value>...  <- specify types and specific parameters" << std::endl;
+    log_out() << "|           e.g.: SET a sin note 66" << std::endl;
+    log_out() << "|           e.g.: SET a delay time 0.5 feedback 0.4" << std::endl;
+    log_out() << "|       SET <letter> <type>                         <- specifies just type, default parameters are selected" << std::endl;
+    log_out() << "|           e.g.: SET a delay" << std::endl;
+    log_out() << "|   Move a parameter with an LFO or envelope (cutoff, wet, size, detune):" << std::endl;
+    log_out() << "|       SET <letter> lfo <target> <rate Hz> <depth> [sin|triangle|saw|square]" << std::endl;
+    log_out() << "|           e.g.: SET f lfo cutoff 0.25 1.5           <- +/-1.5 octaves every 4 seconds" << std::endl;
+    log_out() << "|       SET <letter> env <target> <attack s> <decay s> <depth>" << std::endl;
+    log_out() << "|           e.g.: SET a env detune 0.01 0.3 -12       <- an octave drop on every note" << std::endl;
+    log_out() << "|       SET <letter> lfo|env <target> off" << std::endl;
+    log_out() << "|   Generate a graph:" << std::endl;
+    log_out() << "|       \"h (el lo)\"                               <- generates a graph with your specified letter bindings." << std::endl;
+    log_out() << "|                                                      Parenthesis have to do with rhythm, so try binding a letter like:" << std::endl;
+    log_out() << "|                                                      SET x midi and then generate something like x (a b)" << std::endl;
+    log_out() << "|   Play/Pause your graph:" << std::endl;
+    log_out() << "|       PLAY" << std::endl;
+    log_out() << "|       PAUSE" << std::endl;
+    log_out() << "|   Print your current letter : type bindings:" << std::endl;
+    log_out() << "|       PRINT" << std::endl;
+    log_out() << "|       PRINT v                                     <- verbose print includes all parameters and their defaults" << std::endl;
+    log_out() << "|   Record a timeline of audio-thread activity (open in ui.perfetto.dev):" << std::endl;
+    log_out() << "|       TRACE <file.json>" << std::endl;
+    log_out() << "|       TRACE OFF" << std::endl;
+    log_out() << "|   Engine health (callback load, xruns, rebuild times):" << std::endl;
+    log_out() << "|       STATS" << std::endl;
+    log_out() << "|       STATS RESET                                 <- also clears the peak load" << std::endl;
+    log_out() << "|       STATS SLO <ms>                              <- PLAY-to-sound latency target to count against" << std::endl;
+    log_out() << "|       METRICS FILE <path> [seconds]               <- publish Prometheus text periodically" << std::endl;
+    log_out() << "|       METRICS SOCKET <path> [seconds]             <- serve it on a Unix socket instead" << std::endl;
+    log_out() << "|       METRICS OFF" << std::endl;
+    log_out() << "|       MEM                                         <- memory per letter, type and word" << std::endl;
+    log_out() << "|       LOG <file.jsonl>                            <- copy console output to a JSON-lines file" << std::endl;
+    log_out() << "|       LOG OFF" << std::endl;
+    log_out() << "|   Render low voices below the device rate (on by default):" << std::endl;
+    log_out() << "|       MULTIRATE ON|OFF" << std::endl;
+    log_out() << "|   Run the graph in fixed pieces of each device block (64 by default):" << std::endl;
+    log_out() << "|       QUANTUM <samples>|OFF" << std::endl;
+    log_out() << "|   Quality tier under CPU pressure (0 full .. 3 reverb off; automatic by default):" << std::endl;
+    log_out() << "|       QUALITY                                     <- current tier and time spent in each" << std::endl;
+    log_out() << "|       QUALITY <tier>                              <- hold a tier (QUALITY 0 keeps full quality)" << std::endl;
+    log_out() << "|       QUALITY AUTO" << std::endl;
+    log_out() << "|   Scheduling and memory (Linux; also --rt-priority, --rt-cores, --mlock, --prefault):" << std::endl;
+    log_out() << "|       REALTIME                                    <- current settings and any errors applying them" << std::endl;
+    log_out() << "|       REALTIME PRIORITY <1-98>|OFF                <- SCHED_FIFO for the audio thread, 10 lower for workers" << std::endl;
+    log_out() << "|       REALTIME CORES <list>[:<list>]|ALL          <- e.g. 3 or 2-3:0-1 (audio cores, then worker cores)" << std::endl;
+    log_out() << "|       REALTIME MLOCK ON|OFF                       <- keep all memory resident" << std::endl;
+    log_out() << "|       REALTIME PREFAULT ON|OFF                    <- touch buffers while preparing, not while playing" << std::endl;
+    log_out() << "|   Compare the STATS load histogram (after STATS RESET) with each setting on and off." << std::endl;
+    log_out() << "|   Levels and spectra, computed off the audio thread:" << std::endl;
+    log_out() << "|       ANALYZE <letter>|WORD <n>|OUT               <- tap nodes of a letter, a word's outputs, or the output" << std::endl;
+    log_out() << "|       ANALYZE                                     <- peak, RMS and max level of every tap" << std::endl;
+    log_out() << "|       ANALYZE SPECTRUM                            <- octave bands and loudest frequency" << std::endl;
+    log_out() << "|       ANALYZE EXPORT <file.json>                  <- everything, with the full spectrum" << std::endl;
+    log_out() << "|       ANALYZE OFF" << std::endl;
+    log_out() << "|   Run the engine at a fixed rate, resampled to the device's (also --rate <hz>):" << std::endl;
+    log_out() << "|       RATE <hz>                                   <- e.g. RATE 48000, or lower to save CPU" << std::endl;
+    log_out() << "|       RATE DEVICE                                 <- follow the device (the default)" << std::endl;
+    log_out() << "|   Scenes: snapshots of every letter's parameters, morphed on the playing graph without a rebuild:" << std::endl;
+    log_out() << "|       SCENE SAVE <name>                           <- e.g. SCENE SAVE calm, then SET ..., SCENE SAVE busy" << std::endl;
+    log_out() << "|       SCENE                                       <- scenes and the parameters that differ" << std::endl;
+    log_out() << "|       SCENE DROP <name>" << std::endl;
+    log_out() << "|       MORPH <position>|<scene> [glide seconds]    <- 0 first scene, 1 the second; e.g. MORPH 0.5 2" << std::endl;
+    log_out() << "|   Leave nodes behind closed pulser gates unprepared until just before they open (on by default):" << std::endl;
+    log_out() << "|       LAZY                                        <- gated nodes, how many are asleep, late wake-ups" << std::endl;
+    log_out() << "|       LAZY ON|OFF                                 <- from the next PLAY" << std::endl;
+    log_out() << "|       LAZY RETIRE <seconds>                       <- silence before a woken node is released again (5)" << std::endl;
+    log_out() << "|   The running graph, with CPU, silence and memory per node measured over a window:" << std::endl;
+    log_out() << "|       GRAPH [seconds]                             <- as a table (1 s window by default)" << std::endl;
+    log_out() << "|       GRAPH DOT <file.dot> [seconds]              <- Graphviz, hot nodes shaded red" << std::endl;
+    log_out() << "|       GRAPH JSON <file.json> [seconds]" << std::endl;
+    log_out() << "|       PROFILE [seconds]                           <- the score with each letter's CPU and silence under it" << std::endl;
+    log_out() << "|   Record every command with the sample position it arrived at (also --journal <file>; --replay <file> re-runs it offline):" << std::endl;
+    log_out() << "|       JOURNAL <file>                              <- start recording" << std::endl;
+    log_out() << "|       JOURNAL                                     <- where it's recording, and how much" << std::endl;
+    log_out() << "|       JOURNAL OFF" << std::endl;
+    log_out() << "|       CALIBRATE                                   <- time quantum and kernel choices here, apply and save (PAUSE first)" << std::endl;
+    log_out() << "|   DSP kernels are picked for this CPU; start with --isa generic|avx2|avx512 to force one (STATS shows it)." << std::endl;
 
     std::string line;
 
-    auto ip = InputProcessor(reg, parse, graph);
+    auto ip = InputProcessor(reg, parse, graph, engine, host);
 
     while (keepRunning.load(std::memory_order_relaxed)) {
-        std::cout << "cmd> " << std::flush;
+        log_out() << "cmd> " << std::flush;
         if (std::getline(std::cin, line)) {
             if (line == "EXIT") {
-                std::cout << "'EXIT' command received. Signaling stop." << std::endl;
+                log_out() << "'EXIT' command received. Signaling stop." << std::endl;
                 keepRunning.store(false, std::memory_order_relaxed); // Signal to stop
                 break;
             }
@@ -167,11 +766,11 @@ static void interactive_mode(LetterRegistry &reg, Parser &parse, std::shared_ptr
 
         } else {
             if (std::cin.eof()) {
-                std::cout << "[Input Thread] EOF detected on console input. Exiting input loop." << std::endl;
+                log_out() << "[Input Thread] EOF detected on console input. Exiting input loop." << std::endl;
             } else if (std::cin.bad()) {
-                std::cerr << "[Input Thread] Fatal error on std::cin. Exiting input loop." << std::endl;
+                log_err() << "[Input Thread] Fatal error on std::cin. Exiting input loop." << std::endl;
             } else if (std::cin.fail()) {
-                std::cerr << "[Input Thread] Non-fatal error on std::cin. Attempting to clear flags." << std::endl;
+                log_err() << "[Input Thread] Non-fatal error on std::cin. Attempting to clear flags." << std::endl;
                 std::cin.clear();
                 std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             }
@@ -179,23 +778,168 @@ static void interactive_mode(LetterRegistry &reg, Parser &parse, std::shared_ptr
             break;
         }
     }
-    std::cout << "[Input Thread] Loop finished. Thread is now terminating." << std::endl;
+    log_out() << "[Input Thread] Loop finished. Thread is now terminating." << std::endl;
+}
+
+// --load-test: the engine as main() sets it up, on a NullAudioDevice instead
+// of the sound card, with generated command traffic
+static int load_test_mode(int argc, char* argv[]) {
+    auto options = load_test::parse_options(argc, argv);
+    if (!options) {
+        log_err() << "Usage: --load-test [--seconds s] [--rate hz] [--block n] [--plays n] [--sets n]"
+                     " [--toggles n] [--spread] [--seed n]\n";
+        return 2;
+    }
+    const auto& o = *options;
+
+    juce::AudioProcessorPlayer player;
+    player.setDoublePrecisionProcessing(true);
+    EngineCallback engine(player);
+
+    auto graph = std::make_shared<juce::AudioProcessorGraph>();
+    FixedRateHost host(*graph);
+    graph->enableAllBuses();
+
+    LetterRegistry reg;
+    Parser parse(graph, reg);
+    parse.lazy_gates = true;
+    bind_all_letters_and_params_random(reg);
+
+    player.setProcessor(&host);
+    NullAudioDevice device(o.rate, o.block);
+    device.open({}, {}, o.rate, o.block);
+    device.start(&engine);
+
+    InputProcessor ip(reg, parse, graph, engine, host);
+    load_test::Traffic traffic(o);
+    load_test::Results results;
+
+    using clock = std::chrono::steady_clock;
+    const auto begin = clock::now();
+    const auto at = [&](double seconds) {
+        return begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+    };
+    for (int second = 0; second < static_cast<int>(o.seconds) && keepRunning.load(std::memory_order_relaxed); ++second) {
+        const auto commands = traffic.next_second();
+        const double burst = traffic.random().nextDouble() * 0.5;
+        for (std::size_t i = 0; i < commands.size(); ++i) {
+            std::this_thread::sleep_until(at(second + (o.spread ? static_cast<double>(i) / commands.size() : burst)));
+            const auto start = clock::now();
+            ip.process_line(commands[i].line);
+            results.latencyMs[commands[i].kind].push_back(
+                std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            if (commands[i].line.starts_with("PLAY")) {
+                results.rebuildMs.push_back(1000.0 * EngineStats::get().lastRebuildSeconds.load(std::memory_order_relaxed));
+            }
+        }
+    }
+    std::this_thread::sleep_until(at(o.seconds));
+
+    device.stop();
+    player.setProcessor(nullptr);
+    Log::get().flush();
+    auto& stats = EngineStats::get();
+    results.print(log_out(), o, device, stats.deadlineMisses.load(std::memory_order_relaxed),
+                  stats.peakLoad.load(std::memory_order_relaxed));
+    PlayLatency::get().print(log_out());
+    Log::get().flush();
+    return 0;
 }
 
 int main(int argc, char* argv[])
 {
     std::signal (SIGINT, signalHandler);
+    Tracer::nameThisThread("input");
+
+    // --isa works with every mode, so it's taken out before any of them look
+    std::vector<char*> argList(argv, argv + argc);
+    if (!isa::parse_argument(argList, log_err())) {
+        return 1;
+    }
+    argc = static_cast<int>(argList.size());
+    argList.push_back(nullptr);
+    argv = argList.data();
+
+    // Offline modes that never open an audio device
+    if (argc > 1 && std::string(argv[1]) == "--golden") {
+        return golden::run(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--rt-check") {
+        return rtcheck::run_self_check();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--quantum-bench") {
+        return quantum_bench::run(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--q31-check") {
+        return q31_check::run_check();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--parallel-render") {
+        return parallel_render::run(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--replay") {
+        return replay::run(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--load-test") {
+        return load_test_mode(argc, argv);
+    }
+
+    // Real-time options may appear anywhere; what's left is the command file
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (!RealtimeSetup::get().parse_arguments(args, log_err())) {
+        return 1;
+    }
+    double internalRate = 0.0;
+    if (auto it = std::find(args.begin(), args.end(), "--rate"); it != args.end()) {
+        if (it + 1 == args.end() || std::atof((it + 1)->c_str()) < 8000.0) {
+            log_err() << "--rate takes a sample rate of 8000 Hz or more\n";
+            return 1;
+        }
+        internalRate = std::atof((it + 1)->c_str());
+        args.erase(it, it + 2);
+    }
+    bool calibrateAtStart = false;
+    if (auto it = std::find(args.begin(), args.end(), "--calibrate"); it != args.end()) {
+        calibrateAtStart = true;
+        args.erase(it);
+    }
+    if (auto it = std::find(args.begin(), args.end(), "--profile"); it != args.end()) {
+        if (it + 1 == args.end()) {
+            log_err() << "--profile takes the calibration profile's path\n";
+            return 1;
+        }
+        calibration::profile_path() = *(it + 1);
+        args.erase(it, it + 2);
+    }
+    std::string journalPath;
+    if (auto it = std::find(args.begin(), args.end(), "--journal"); it != args.end()) {
+        if (it + 1 == args.end()) {
+            log_err() << "--journal takes a file to record commands to\n";
+            return 1;
+        }
+        journalPath = *(it + 1);
+        args.erase(it, it + 2);
+    }
+
+    LogStream rtLog(Log::Level::warning);
+    rtcheck::Monitor rtMonitor;
+    rtMonitor.log = &rtLog;
+    if (rtMonitor.start()) {
+        log_out() << "Real-time safety checker armed: violations in the audio callback are logged to stderr.\n";
+    }
 
     juce::AudioDeviceManager deviceManager;
     if (auto err = deviceManager.initialise (0, 2, nullptr, true); err.isNotEmpty())
     {
-        std::cerr << "Audio error: " << err << std::endl;
+        log_err() << "Audio error: " << err << std::endl;
         return 1;
     }
     juce::AudioProcessorPlayer player;
     player.setDoublePrecisionProcessing(true);
+    EngineCallback engine(player);
 
     auto graph = std::make_shared<juce::AudioProcessorGraph>();
+    FixedRateHost host(*graph);
+    host.setInternalRate(internalRate);
 
     auto inputDevice  = juce::MidiInput::getDefaultDevice();
     auto outputDevice = juce::MidiOutput::getDefaultDevice();
@@ -203,7 +947,7 @@ int main(int argc, char* argv[])
     graph->enableAllBuses();
 
     deviceManager.initialiseWithDefaultDevices (0, 2);
-    deviceManager.addAudioCallback (&player);
+    deviceManager.addAudioCallback (&engine);
     deviceManager.setMidiInputDeviceEnabled (inputDevice.identifier, true);
     deviceManager.addMidiInputDeviceCallback (inputDevice.identifier, &player);
     deviceManager.setDefaultMidiOutputDevice (outputDevice.identifier);
@@ -215,23 +959,47 @@ int main(int argc, char* argv[])
 
     LetterRegistry reg;
     Parser parse(graph, reg);
+    parse.lazy_gates = true;
 
     bind_all_letters_and_params_random(reg);
 
-    reg.printBindingsDetailed();
+    isa::print_report(log_out());
+
+    reg.printBindingsDetailed(log_out());
     
 
-    player.setProcessor (graph.get());
+    player.setProcessor (&host);
+
+    if (calibrateAtStart) {
+        calibrate(engine, host);
+    } else {
+        apply_saved_calibration(engine, host);
+    }
+
+    if (!journalPath.empty()) {
+        if (Journal::get().start(journalPath, EngineStats::get().sampleRate.load(std::memory_order_relaxed),
+                                 EngineStats::get().samplesProcessed.load(std::memory_order_relaxed),
+                                 journal_preamble(reg, SceneBank{}, engine, {}, false))) {
+            Journal::get().print(log_out());
+        } else {
+            log_err() << "Cannot write journal '" << journalPath << "'\n";
+        }
+    }
     
-    if (argc <= 1) {
-        interactive_mode(reg, parse, graph);
+    if (args.empty()) {
+        interactive_mode(reg, parse, graph, engine, host);
     } else {
-        file_mode(std::string(argv[1]), reg, parse, graph);
+        file_mode(args[0], reg, parse, graph, engine, host);
     }
 
-    std::cout << "Stopping …\n";
-    deviceManager.removeAudioCallback (&player);
+    log_out() << "Stopping …\n";
+    Tracer::get().stop();
+    if (rtcheck::available()) {
+        rtMonitor.print_summary(log_out());
+    }
+    deviceManager.removeAudioCallback (&engine);
     player.setProcessor (nullptr);
     deviceManager.closeAudioDevice();
+    Log::get().flush();
     return 0;
 }
@@ -0,0 +1,528 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "lockfree_ring.h"
+#include "realtime_setup.h"
+
+/* ANALYZE taps: level meters and spectra of selected nodes, or of the output,
+   computed off the audio thread.
+
+   A tap is one of a fixed pool of slots. A tapped node's Instrumented wrapper
+   sees its tap index in NodeInfo (analyzer_taps.h picks the nodes) and, after
+   processing, copies the block
+   (first two channels, as float) into the slot's staging chunk; full chunks
+   go into the slot's lock-free ring. That copy is all the audio thread pays,
+   and an untapped node pays one relaxed load. Attaching and detaching only
+   store the index, so neither touches the graph.
+
+   The analysis thread (started with the first tap, parked while no tap is
+   in use) drains the rings and keeps
+   per channel a decaying peak (20 dB/s), a 300 ms RMS and the largest peak
+   since the tap was attached, plus a 2048-point Hann-windowed spectrum of the
+   channel average, 50% overlapped and averaged over about half a second.
+   Levels are dBFS; a full-scale sine reads 0 dB peak and in its spectrum band.
+
+   Each reattachment bumps the slot's generation, so chunks still in flight
+   from the previous owner are dropped by the analysis thread. */
+
+class Analyzer
+{
+public:
+    static constexpr int maxTaps = 8;
+    static constexpr int chunkSamples = 256;
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int numBins = fftSize / 2 + 1;
+    static constexpr int numBands = 10; // octaves from 31.5 Hz to 16 kHz
+
+    static Analyzer& get()
+    {
+        static Analyzer a;
+        return a;
+    }
+
+    struct Report
+    {
+        std::string label;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        std::array<double, 2> peakDb { -120.0, -120.0 };
+        std::array<double, 2> rmsDb { -120.0, -120.0 };
+        std::array<double, 2> maxPeakDb { -120.0, -120.0 };
+        std::uint64_t samples = 0;
+        std::uint64_t dropped = 0;
+        std::array<double, numBands> bandDb {};
+        double peakFrequency = 0.0;
+        std::vector<float> spectrumDb; // numBins, empty until the first FFT frame
+    };
+
+    static double band_centre(int band) { return 31.25 * std::exp2(band); }
+
+    // ---- audio thread ----
+    template<typename Sample>
+    void capture(int index, const Sample* const* channels, int numChannels, int numSamples) noexcept
+    {
+        if (index < 0 || index >= maxTaps || numChannels <= 0)
+            return;
+        auto& tap = taps[static_cast<std::size_t>(index)];
+        auto& chunk = tap.staging;
+        const auto generation = tap.generation.load(std::memory_order_acquire);
+        if (chunk.generation != generation)
+        {
+            chunk.generation = generation;
+            chunk.numSamples = 0;
+        }
+        chunk.numChannels = static_cast<std::uint8_t>(juce::jmin(numChannels, 2));
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int n = juce::jmin(numSamples - done, chunkSamples - static_cast<int>(chunk.numSamples));
+            for (int ch = 0; ch < chunk.numChannels; ++ch)
+            {
+                float* dst = chunk.samples[ch] + chunk.numSamples;
+                const Sample* src = channels[ch] + done;
+                for (int i = 0; i < n; ++i)
+                    dst[i] = static_cast<float>(src[i]);
+            }
+            chunk.numSamples = static_cast<std::uint16_t>(chunk.numSamples + n);
+            done += n;
+
+            if (chunk.numSamples == chunkSamples)
+            {
+                if (!tap.ring.try_push(chunk))
+                    tap.dropped.fetch_add(1, std::memory_order_relaxed);
+                chunk.numSamples = 0;
+            }
+        }
+    }
+
+    template<typename Sample>
+    void capture(int index, const juce::AudioBuffer<Sample>& buffer) noexcept
+    {
+        capture(index, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+    }
+
+    // The device output's tap, or -1
+    int output_tap() const noexcept { return outputTap.load(std::memory_order_relaxed); }
+
+    // ---- command thread ----
+
+    // nodeTap is the node's NodeInfo::tap. Returns the slot, or -1 when all are taken
+    int attach(std::atomic<int>& nodeTap, const std::string& label, double sampleRate)
+    {
+        const int index = claim(label, sampleRate);
+        if (index >= 0)
+        {
+            taps[static_cast<std::size_t>(index)].node = &nodeTap;
+            nodeTap.store(index, std::memory_order_release);
+        }
+        return index;
+    }
+
+    int attach_output(double sampleRate)
+    {
+        if (output_tap() >= 0)
+            return output_tap();
+        const int index = claim("output", sampleRate);
+        if (index >= 0)
+            outputTap.store(index, std::memory_order_release);
+        return index;
+    }
+
+    // Frees every slot; live nodes stop copying first
+    void detach_all()
+    {
+        outputTap.store(-1, std::memory_order_release);
+        for (auto& tap : taps)
+        {
+            if (tap.node != nullptr)
+                tap.node->store(-1, std::memory_order_release);
+            release(tap);
+        }
+    }
+
+    // The graph is about to be cleared: slots held by its nodes are freed
+    // without touching the nodes. The output tap stays.
+    void release_node_taps()
+    {
+        for (auto& tap : taps)
+            if (tap.node != nullptr)
+                release(tap);
+    }
+
+    int num_taps() const
+    {
+        int n = 0;
+        for (auto& tap : taps)
+            n += tap.inUse.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    std::vector<Report> reports()
+    {
+        std::vector<Report> out;
+        for (auto& tap : taps)
+        {
+            if (!tap.inUse.load(std::memory_order_acquire))
+                continue;
+            std::lock_guard<std::mutex> lock(tap.reportLock);
+            out.push_back(tap.report);
+            out.back().dropped = tap.dropped.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    // Selectors re-applied after every PLAY (a letter, "word <n>" or "out")
+    std::vector<std::string> selectors;
+
+private:
+    struct Chunk
+    {
+        std::uint32_t generation = 0;
+        std::uint16_t numSamples = 0;
+        std::uint8_t numChannels = 0;
+        float samples[2][chunkSamples];
+    };
+
+    struct Tap
+    {
+        // shared with the audio thread
+        std::atomic<std::uint32_t> generation { 0 };
+        std::atomic<bool> inUse { false };
+        std::atomic<std::uint64_t> dropped { 0 };
+        LockFreeRing<Chunk, 32> ring;
+        Chunk staging {}; // audio thread only
+
+        // command thread
+        std::atomic<int>* node = nullptr; // the tapped node's index, null for the output
+
+        // analysis thread
+        std::uint32_t seenGeneration = 0;
+        std::array<double, 2> peak {}, meanSquare {}, maxPeak {};
+        std::uint64_t samples = 0;
+        std::vector<float> fifo, frame;
+        int fifoFill = 0;
+        std::vector<double> power;
+        bool hasSpectrum = false;
+
+        std::mutex reportLock;
+        Report report;
+    };
+
+    Analyzer() : fft(fftOrder), window(static_cast<std::size_t>(fftSize), juce::dsp::WindowingFunction<float>::hann, false)
+    {
+        for (auto& tap : taps)
+        {
+            tap.fifo.assign(fftSize, 0.0f);
+            tap.frame.assign(2 * fftSize, 0.0f);
+            tap.power.assign(numBins, 0.0);
+        }
+    }
+
+    ~Analyzer() { worker.stopThread(1000); }
+
+    int claim(const std::string& label, double sampleRate)
+    {
+        for (int i = 0; i < maxTaps; ++i)
+        {
+            auto& tap = taps[static_cast<std::size_t>(i)];
+            if (tap.inUse.load(std::memory_order_relaxed))
+                continue;
+            {
+                std::lock_guard<std::mutex> lock(tap.reportLock);
+                tap.report = Report {};
+                tap.report.label = label;
+                tap.report.sampleRate = sampleRate;
+            }
+            tap.dropped.store(0, std::memory_order_relaxed);
+            tap.generation.fetch_add(1, std::memory_order_acq_rel);
+            tap.inUse.store(true, std::memory_order_release);
+            if (!worker.isThreadRunning())
+                worker.startThread();
+            else
+                worker.notify();
+            return i;
+        }
+        return -1;
+    }
+
+    void release(Tap& tap)
+    {
+        tap.node = nullptr;
+        tap.generation.fetch_add(1, std::memory_order_acq_rel);
+        tap.inUse.store(false, std::memory_order_release);
+    }
+
+    // ---- analysis thread ----
+    void drain(Tap& tap)
+    {
+        const auto generation = tap.generation.load(std::memory_order_acquire);
+        if (generation != tap.seenGeneration)
+        {
+            tap.seenGeneration = generation;
+            tap.peak = tap.meanSquare = tap.maxPeak = {};
+            tap.samples = 0;
+            tap.fifoFill = 0;
+            std::fill(tap.power.begin(), tap.power.end(), 0.0);
+            tap.hasSpectrum = false;
+        }
+
+        double sampleRate;
+        {
+            std::lock_guard<std::mutex> lock(tap.reportLock);
+            sampleRate = tap.report.sampleRate > 0.0 ? tap.report.sampleRate : 48000.0;
+        }
+        const double peakDecay = std::pow(10.0, -1.0 / sampleRate);    // 20 dB/s
+        const double rmsCoeff = std::exp(-1.0 / (0.3 * sampleRate));   // 300 ms
+        const double spectrumCoeff = 0.8;                               // per 1024-sample hop
+
+        int numChannels = 0;
+        bool any = false;
+        Chunk chunk;
+        while (tap.ring.try_pop(chunk))
+        {
+            if (chunk.generation != generation)
+                continue;
+            any = true;
+            numChannels = chunk.numChannels;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto& peak = tap.peak[static_cast<std::size_t>(ch)];
+                auto& ms = tap.meanSquare[static_cast<std::size_t>(ch)];
+                auto& maxPeak = tap.maxPeak[static_cast<std::size_t>(ch)];
+                for (int i = 0; i < chunk.numSamples; ++i)
+                {
+                    const double x = chunk.samples[ch][i];
+                    peak = juce::jmax(std::abs(x), peak * peakDecay);
+                    ms = rmsCoeff * ms + (1.0 - rmsCoeff) * x * x;
+                    maxPeak = juce::jmax(maxPeak, std::abs(x));
+                }
+            }
+            tap.samples += chunk.numSamples;
+
+            for (int i = 0; i < chunk.numSamples; ++i)
+            {
+                float x = 0.0f;
+                for (int ch = 0; ch < numChannels; ++ch)
+                    x += chunk.samples[ch][i];
+                tap.fifo[static_cast<std::size_t>(tap.fifoFill++)] = x / static_cast<float>(numChannels);
+
+                if (tap.fifoFill == fftSize)
+                {
+                    std::copy(tap.fifo.begin(), tap.fifo.end(), tap.frame.begin());
+                    std::fill(tap.frame.begin() + fftSize, tap.frame.end(), 0.0f);
+                    window.multiplyWithWindowingTable(tap.frame.data(), static_cast<std::size_t>(fftSize));
+                    fft.performFrequencyOnlyForwardTransform(tap.frame.data(), true);
+                    const double k = tap.hasSpectrum ? spectrumCoeff : 0.0;
+                    for (int b = 0; b < numBins; ++b)
+                    {
+                        const double m = tap.frame[static_cast<std::size_t>(b)];
+                        tap.power[static_cast<std::size_t>(b)] = k * tap.power[static_cast<std::size_t>(b)] + (1.0 - k) * m * m;
+                    }
+                    tap.hasSpectrum = true;
+
+                    // 50% overlap
+                    std::copy(tap.fifo.begin() + fftSize / 2, tap.fifo.end(), tap.fifo.begin());
+                    tap.fifoFill = fftSize / 2;
+                }
+            }
+        }
+        if (any)
+            publish(tap, numChannels, sampleRate);
+    }
+
+    void publish(Tap& tap, int numChannels, double sampleRate)
+    {
+        auto db = [](double amplitude) { return amplitude > 1.0e-6 ? 20.0 * std::log10(amplitude) : -120.0; };
+
+        // A full-scale sine through the Hann window peaks at fftSize / 4
+        const double reference = (fftSize / 4.0) * (fftSize / 4.0);
+
+        std::lock_guard<std::mutex> lock(tap.reportLock);
+        auto& r = tap.report;
+        r.numChannels = numChannels;
+        r.samples = tap.samples;
+        for (std::size_t ch = 0; ch < 2; ++ch)
+        {
+            r.peakDb[ch] = db(tap.peak[ch]);
+            r.rmsDb[ch] = db(std::sqrt(tap.meanSquare[ch]));
+            r.maxPeakDb[ch] = db(tap.maxPeak[ch]);
+        }
+        if (!tap.hasSpectrum)
+            return;
+
+        r.spectrumDb.resize(numBins);
+        std::array<double, numBands> bands {};
+        double loudest = 0.0;
+        for (int b = 1; b < numBins; ++b)
+        {
+            const double p = tap.power[static_cast<std::size_t>(b)];
+            const double hz = b * sampleRate / fftSize;
+            r.spectrumDb[static_cast<std::size_t>(b)] = static_cast<float>(p > 0.0 ? 10.0 * std::log10(p / reference) : -120.0);
+            if (p > loudest)
+            {
+                loudest = p;
+                r.peakFrequency = hz;
+            }
+            const int band = static_cast<int>(std::floor(std::log2(hz / band_centre(0)) + 0.5));
+            if (band >= 0 && band < numBands)
+                bands[static_cast<std::size_t>(band)] += p;
+        }
+        r.spectrumDb[0] = r.spectrumDb.size() > 1 ? r.spectrumDb[1] : -120.0f;
+        // The window spreads a sine over about 1.5 bins' worth of power
+        for (int band = 0; band < numBands; ++band)
+            r.bandDb[static_cast<std::size_t>(band)] = juce::jmax(-120.0, 10.0 * std::log10(bands[static_cast<std::size_t>(band)] / (1.5 * reference) + 1.0e-12));
+    }
+
+    struct Worker : juce::Thread
+    {
+        explicit Worker(Analyzer& a) : juce::Thread("Analyzer"), owner(a) {}
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                RealtimeSetup::get().sync(RealtimeSetup::Role::worker);
+                for (auto& tap : owner.taps)
+                    if (tap.inUse.load(std::memory_order_acquire))
+                        owner.drain(tap);
+                // Parked after ANALYZE OFF until claim() has a tap for it
+                wait(owner.num_taps() > 0 ? 20 : -1);
+            }
+        }
+
+        Analyzer& owner;
+    };
+
+    std::array<Tap, maxTaps> taps;
+    std::atomic<int> outputTap { -1 };
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+    Worker worker { *this };
+};
+
+namespace analysis
+{
+
+inline std::string db_text(double db)
+{
+    char text[16];
+    if (db <= -120.0)
+        std::snprintf(text, sizeof(text), "   -inf");
+    else
+        std::snprintf(text, sizeof(text), "%7.1f", db);
+    return text;
+}
+
+inline void print_meters(const std::vector<Analyzer::Report>& reports, std::ostream& os)
+{
+    if (reports.empty())
+    {
+        os << "No taps. ANALYZE <letter>, ANALYZE WORD <n> or ANALYZE OUT attaches some.\n";
+        return;
+    }
+    os << "=== Levels (dBFS) ===            peak L/R        RMS L/R        max L/R   dropped\n";
+    for (const auto& r : reports)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "%-30.30s", r.label.c_str());
+        os << text;
+        if (r.samples == 0)
+        {
+            os << "  (no signal yet)\n";
+            continue;
+        }
+        const std::size_t right = r.numChannels > 1 ? 1 : 0;
+        os << ' ' << db_text(r.peakDb[0]) << db_text(r.peakDb[right])
+           << ' ' << db_text(r.rmsDb[0]) << db_text(r.rmsDb[right])
+           << ' ' << db_text(r.maxPeakDb[0]) << db_text(r.maxPeakDb[right])
+           << "  " << r.dropped << '\n';
+    }
+}
+
+inline void print_spectra(const std::vector<Analyzer::Report>& reports, std::ostream& os)
+{
+    os << "=== Octave bands (dBFS) ===     ";
+    for (int b = 0; b < Analyzer::numBands; ++b)
+    {
+        const double hz = Analyzer::band_centre(b);
+        char text[16];
+        std::snprintf(text, sizeof(text), hz < 1000.0 ? "%6.0f" : "%5.0fk", hz < 1000.0 ? hz : hz / 1000.0);
+        os << text;
+    }
+    os << "   loudest\n";
+    for (const auto& r : reports)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "%-30.30s", r.label.c_str());
+        os << text << "  ";
+        if (r.spectrumDb.empty())
+        {
+            os << "(under " << Analyzer::fftSize << " samples so far)\n";
+            continue;
+        }
+        for (double db : r.bandDb)
+        {
+            std::snprintf(text, sizeof(text), "%6.0f", juce::jmax(-99.0, db));
+            os << text;
+        }
+        std::snprintf(text, sizeof(text), "  %6.0f Hz\n", r.peakFrequency);
+        os << text;
+    }
+}
+
+inline bool export_json(const std::vector<Analyzer::Report>& reports, const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+
+    auto number = [](double v) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f", v);
+        return std::string(text);
+    };
+    file << "{\"fft_size\":" << Analyzer::fftSize << ",\"taps\":[";
+    for (std::size_t t = 0; t < reports.size(); ++t)
+    {
+        const auto& r = reports[t];
+        file << (t ? "," : "") << "\n{\"label\":\"";
+        for (char c : r.label)
+            if (c != '"' && c != '\\')
+                file << c;
+        file << "\",\"sample_rate\":" << r.sampleRate << ",\"channels\":" << r.numChannels
+             << ",\"samples\":" << r.samples << ",\"dropped_chunks\":" << r.dropped
+             << ",\"peak_db\":[" << number(r.peakDb[0]) << ',' << number(r.peakDb[1]) << ']'
+             << ",\"rms_db\":[" << number(r.rmsDb[0]) << ',' << number(r.rmsDb[1]) << ']'
+             << ",\"max_peak_db\":[" << number(r.maxPeakDb[0]) << ',' << number(r.maxPeakDb[1]) << ']'
+             << ",\"loudest_hz\":" << number(r.peakFrequency) << ",\"octave_bands_db\":[";
+        for (int b = 0; b < Analyzer::numBands; ++b)
+            file << (b ? "," : "") << "{\"hz\":" << Analyzer::band_centre(b) << ",\"db\":" << number(r.bandDb[static_cast<std::size_t>(b)]) << '}';
+        file << "],\"spectrum_db\":[";
+        for (std::size_t b = 0; b < r.spectrumDb.size(); ++b)
+            file << (b ? "," : "") << number(r.spectrumDb[b]);
+        file << "]}";
+    }
+    file << "\n]}\n";
+    return file.good();
+}
+
+} // namespace analysis
+
+#endif
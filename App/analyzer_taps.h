@@ -0,0 +1,85 @@
+#ifndef ANALYZER_TAPS_H
+#define ANALYZER_TAPS_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+#include "instrumented.h"
+#include "word_bus.h"
+
+/* Which nodes an ANALYZE selector taps. The selectors are kept and applied
+   again after every PLAY, since each rebuild makes new nodes. */
+
+namespace analysis
+{
+
+inline bool feeds_output(juce::AudioProcessorGraph& graph, juce::AudioProcessorGraph::NodeID id)
+{
+    for (const auto& c : graph.getConnections())
+    {
+        if (c.source.nodeID != id)
+            continue;
+        auto* dest = graph.getNodeForId(c.destination.nodeID);
+        if (dest != nullptr
+            && (dynamic_cast<juce::AudioProcessorGraph::AudioGraphIOProcessor*>(dest->getProcessor()) != nullptr
+                || dynamic_cast<WordBus*>(dest->getProcessor()) != nullptr))
+            return true;
+    }
+    return false;
+}
+
+/* Attaches taps for a selector: "out" (the device output), "word <n>" (the
+   nodes of that word that feed the output: its effect chain's last effect,
+   or its voices) or a letter (every node made from it). Returns how many
+   taps were attached; reports a full pool to err. */
+inline int attach(juce::AudioProcessorGraph& graph, const std::vector<std::string>& words,
+                  const std::string& selector, double deviceRate, std::ostream& err)
+{
+    auto& analyzer = Analyzer::get();
+    if (selector == "out")
+    {
+        if (analyzer.attach_output(deviceRate) >= 0)
+            return 1;
+        err << "ANALYZE: all " << Analyzer::maxTaps << " taps in use\n";
+        return 0;
+    }
+
+    const bool byWord = selector.rfind("word ", 0) == 0;
+    const int word = byWord ? std::atoi(selector.c_str() + 5) : -1;
+    const char letter = byWord || selector.empty() ? '\0' : selector[0];
+
+    int attached = 0;
+    std::map<char, int> occurrence;
+    for (auto* node : graph.getNodes())
+    {
+        auto* info = node_info(node->getProcessor());
+        if (info == nullptr)
+            continue;
+        const int nth = occurrence[info->letter]++;
+        const bool selected = byWord ? info->word == word && feeds_output(graph, node->nodeID)
+                                     : info->letter == letter;
+        if (!selected || info->tap.load(std::memory_order_relaxed) >= 0)
+            continue;
+
+        std::string label = std::string(1, info->letter) + "#" + std::to_string(nth) + " " + info->typeName;
+        if (info->word >= 0 && static_cast<std::size_t>(info->word) < words.size())
+            label += " (word " + std::to_string(info->word) + " " + words[static_cast<std::size_t>(info->word)] + ")";
+        if (analyzer.attach(info->tap, label, graph.getSampleRate()) < 0)
+        {
+            err << "ANALYZE: all " << Analyzer::maxTaps << " taps in use, " << label << " not tapped\n";
+            break;
+        }
+        ++attached;
+    }
+    return attached;
+}
+
+} // namespace analysis
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "golden.h"
+#include "isa_dispatch.h"
+#include "offline_render.h"
+#include "quantum.h"
+#include "quantum_bench.h"
+
+/* Calibration: which processing quantum and DSP kernel level run fastest on
+   this machine, measured instead of guessed, and remembered.
+
+     CALIBRATE               measure now (with nothing playing), apply, save
+     --calibrate             the same at startup, before the first command
+
+   Each candidate renders a few representative scores offline (the
+   --quantum-bench score and three of the --golden corpus) at the device's
+   block size: every quantum from 16 samples up to the block, whole blocks,
+   and every kernel level the CPU has. Candidates are run twice, interleaved,
+   and the faster time counts, so a hiccup doesn't decide it.
+
+   The winner is written to a profile (--profile <file>, default
+   $XDG_CONFIG_HOME/textgraph/calibration, or ~/.config/...), and each start
+   applies a profile written on the same CPU model for the same block size.
+   `--isa` on the command line still wins over the profile.
+
+   The graph itself renders on the one audio thread, so there is no worker
+   count to tune; the offline --parallel-render picks its threads per run. */
+
+namespace calibration
+{
+
+struct Profile
+{
+    std::string cpu;
+    int block = 0;
+    int quantum = defaultQuantum;   // 0: whole blocks
+    isa::Level level = isa::Level::generic;
+    double nsPerSample = 0.0;
+};
+
+inline std::filesystem::path default_path()
+{
+    if (const char* xdg = std::getenv("XDG_CONFIG_HOME"); xdg != nullptr && *xdg != '\0')
+        return std::filesystem::path(xdg) / "textgraph" / "calibration";
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+        return std::filesystem::path(home) / ".config" / "textgraph" / "calibration";
+    return "textgraph.calibration";
+}
+
+// Where the profile is read and written; --profile changes it
+inline std::filesystem::path& profile_path()
+{
+    static std::filesystem::path path = default_path();
+    return path;
+}
+
+inline std::string cpu_model() { return juce::SystemStats::getCpuModel().toStdString(); }
+
+inline bool save(const std::filesystem::path& path, const Profile& p)
+{
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream out(path);
+    if (!out.is_open())
+        return false;
+    out << "# textgraph calibration; delete to measure again (CALIBRATE)\n"
+        << "cpu " << p.cpu << '\n'
+        << "block " << p.block << '\n'
+        << "quantum " << p.quantum << '\n'
+        << "isa " << isa::level_name(p.level) << '\n'
+        << "ns_per_sample " << p.nsPerSample << '\n';
+    return out.good();
+}
+
+inline std::optional<Profile> load(const std::filesystem::path& path)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+        return std::nullopt;
+
+    Profile p;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        const auto space = line.find(' ');
+        const std::string key = line.substr(0, space);
+        const std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+        if (key == "cpu")                p.cpu = value;
+        else if (key == "block")         p.block = std::atoi(value.c_str());
+        else if (key == "quantum")       p.quantum = std::atoi(value.c_str());
+        else if (key == "isa")           { if (!isa::parse_level(value, p.level)) return std::nullopt; }
+        else if (key == "ns_per_sample") p.nsPerSample = std::atof(value.c_str());
+    }
+    if (p.cpu.empty() || p.block <= 0 || p.quantum < 0)
+        return std::nullopt;
+    return p;
+}
+
+// Seconds to render every representative score once
+inline double time_scores(const std::vector<std::vector<std::string>>& scores, int block, int quantum, double seconds)
+{
+    RenderSettings settings;
+    settings.blockSize = block;
+    settings.quantum = quantum;
+    settings.randomBindings = false;
+    const int total = static_cast<int>(seconds * settings.sampleRate);
+
+    double elapsed = 0.0;
+    juce::AudioBuffer<double> out(2, block);
+    for (const auto& lines : scores)
+    {
+        OfflineEngine engine(settings);
+        for (const auto& line : lines)
+            engine.command(line);
+        engine.render(out, 0, block); // allocations and first-touch page faults
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int done = 0; done < total; done += block)
+            engine.render(out, 0, juce::jmin(block, total - done));
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return elapsed;
+}
+
+// Measures every candidate and selects the winning kernel level (unless
+// --isa chose one); the caller applies the quantum
+inline Profile run(int block, std::ostream& os, double seconds = 1.0)
+{
+    std::vector<std::vector<std::string>> scores { quantum_bench::default_score() };
+    for (int i = 0; i < 3; ++i)
+        scores.push_back(golden::generate_score(i).lines);
+
+    std::vector<int> quanta { 0 };
+    for (int q = 16; q < block; q *= 2)
+        quanta.push_back(q);
+
+    struct Candidate { int quantum; isa::Level level; double seconds; };
+    std::vector<Candidate> candidates;
+    for (int l = 0; l <= static_cast<int>(isa::detect()); ++l)
+        for (int q : quanta)
+            candidates.push_back({ q, static_cast<isa::Level>(l), 1.0e30 });
+
+    const auto keepLevel = isa::kernels().level;
+    const auto keepSource = isa::source();
+    for (int round = 0; round < 2; ++round)
+        for (auto& c : candidates)
+        {
+            isa::select(c.level, isa::Source::calibration);
+            c.seconds = juce::jmin(c.seconds, time_scores(scores, block, c.quantum, seconds));
+        }
+
+    const Candidate* best = &candidates.front();
+    for (const auto& c : candidates)
+        if (c.seconds < best->seconds)
+            best = &c;
+
+    const double samples = seconds * RenderSettings {}.sampleRate * static_cast<double>(scores.size());
+    char text[160];
+    os << "Calibration at " << block << "-sample blocks (" << scores.size() << " scores, " << seconds << " s each):\n";
+    for (const auto& c : candidates)
+    {
+        std::snprintf(text, sizeof(text), "  %-8s %-14s %8.1f ns/sample%s\n", isa::level_name(c.level),
+                      c.quantum > 0 ? ("quantum " + std::to_string(c.quantum)).c_str() : "whole blocks",
+                      1.0e9 * c.seconds / samples, &c == best ? "  <- fastest" : "");
+        os << text;
+    }
+
+    if (keepSource == isa::Source::argument)
+        isa::select(keepLevel, isa::Source::argument);
+    else
+        isa::select(best->level, isa::Source::calibration);
+
+    Profile p;
+    p.cpu = cpu_model();
+    p.block = block;
+    p.quantum = best->quantum;
+    p.level = best->level;
+    p.nsPerSample = 1.0e9 * best->seconds / samples;
+    return p;
+}
+
+} // namespace calibration
+
+#endif
@@ -6,9 +6,17 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <string_view>
 #include <vector>
 #include <stdio.h>
 
+#include "modulation.h"
+#include "quality.h"
+#include "realtime_setup.h"
+#include "isa_dispatch.h"
+#include "q31.h"
+
 class EffectsBase  : public juce::AudioProcessor
 {
 public:
@@ -47,48 +55,239 @@ public:
     void getStateInformation (juce::MemoryBlock&) override       {}
     void setStateInformation (const void*, int) override         {}
 
+protected:
+    /* Idle short-circuit. Once input and output have both been silent for
+       longer than the effect's tail, nothing is left inside it, so further
+       silent blocks are cleared instead of processed: a reverb behind closed
+       gates costs a scan of its input. The first block with signal in it is
+       processed as usual. */
+    struct SilenceSkip
+    {
+        static constexpr double threshold = 1.0e-8; // -160 dBFS
+
+        // True if this block can be left silent without processing
+        bool skip (juce::AudioBuffer<double>& buffer) noexcept
+        {
+            const int n = buffer.getNumSamples();
+            inputSilent = buffer.getMagnitude (0, n) < threshold;
+            if (!inputSilent || silentFor < tailSamples)
+                return false;
+
+            silentFor += n;
+            buffer.clear();
+            return true;
+        }
+
+        // After processing a block that wasn't skipped
+        void processed (const juce::AudioBuffer<double>& buffer) noexcept
+        {
+            const int n = buffer.getNumSamples();
+            silentFor = inputSilent && buffer.getMagnitude (0, n) < threshold ? silentFor + n : 0;
+        }
+
+        juce::int64 tailSamples = 0;
+        juce::int64 silentFor = 0;
+        bool inputSilent = false;
+    };
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EffectsBase) // Renamed
 };
 
-class FilterProcessor  : public EffectsBase
+class FilterProcessor  : public EffectsBase, public Modulatable
 {
 public:
-    FilterProcessor() : initialCutoffFreq (2000.0)
+    static constexpr std::string_view modulation_target = "cutoff"; // octaves
+
+    FilterProcessor() : FilterProcessor (2000.0)
     {
     }
 
     FilterProcessor(double cutoffFrequency) : initialCutoffFreq (cutoffFrequency)
-    {}
+    {
+#if !TEXTGRAPH_FIXED_POINT
+        // The first assignment into the empty Coefficients would allocate; do it
+        // here, before any thread can reach set_cutoff (a MORPH can reach a node
+        // the lazy gates haven't prepared yet)
+        filter.state->coefficients.ensureStorageAllocated (6);
+#endif
+    }
 
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {
-        *filter.state = *juce::dsp::IIR::Coefficients<double>::makeLowPass (sampleRate, initialCutoffFreq);
+        preparedRate = sampleRate;
+        set_cutoff (initialCutoffFreq);
 
         auto numChannels = getTotalNumOutputChannels();
         if (numChannels == 0) numChannels = 2; // Default to stereo
 
         juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32> (samplesPerBlock), static_cast<juce::uint32>(numChannels) }; 
         filter.prepare (spec);
+        preparedChannels = numChannels;
+        cutoffMod.previous = 0.0;
+        silence = { 64 };
     }
 
     void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& /*midiMessages*/) override
     {
-        juce::dsp::AudioBlock<double> block (buffer);
-        juce::dsp::ProcessContextReplacing<double> context (block);
-        filter.process (context);
+        cutoffMod.follow_gates();
+        if (silence.skip (buffer))
+            return;
+
+        // Under CPU pressure one channel is filtered and copied
+        const bool mono = QualityWatchdog::tier() >= QualityWatchdog::monoEffects && buffer.getNumChannels() > 1;
+        if (mono)
+            quality::sum_to_first_channel (buffer);
+
+        // The other channels' state stood still while mono: they start clean
+        // and fade in from the first channel's output
+        const bool leavingMono = wasMono && !mono && buffer.getNumChannels() > 1;
+        wasMono = mono;
+        if (leavingMono)
+            for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+                filter.reset_channel (ch);
+
+        auto block = juce::dsp::AudioBlock<double> (buffer)
+                         .getSubsetChannelBlock (0, mono ? 1 : static_cast<size_t> (buffer.getNumChannels()));
+        filter_block (block, buffer.getNumSamples());
+
+        if (mono)
+            quality::copy_first_channel (buffer);
+        else if (leavingMono)
+            quality::fade_from_first_channel (buffer);
+        silence.processed (buffer);
+    }
+
+    ModInput* modulation_input (std::string_view target) override
+    {
+        return target == modulation_target ? &cutoffMod : nullptr;
     }
 
     void reset() override
     {
         filter.reset();
+        wasMono = false;
     }
 
+    using EffectsBase::processBlock;
+
     const juce::String getName() const override { return "Filter (Double)"; }
 
+    double getCutoffFrequency() const { return initialCutoffFreq; }
+
+    // MORPH, on the audio thread; modulation keeps sweeping around the new cutoff
+    void set_live_params (const double* values)
+    {
+        initialCutoffFreq = juce::jmax (20.0, values[0]);
+        if (!cutoffMod.active())
+            set_cutoff (juce::jlimit (20.0, 0.45 * preparedRate, initialCutoffFreq));
+    }
+
+    // Highest cutoff a MORPH between the saved scenes can set
+    void setMorphCeilingHz (double hz) { morphCeilingHz = hz; }
+
+    // Highest cutoff its modulators can sweep to, from the highest it can be morphed to
+    double getHighestCutoffFrequency() const
+    {
+        return juce::jmax (initialCutoffFreq, morphCeilingHz) * std::exp2 (cutoffMod.range);
+    }
+
+    // One biquad (and its 4-sample state) per channel plus the shared coefficients
+    std::size_t getHeapBytes() const
+    {
+        return static_cast<std::size_t>(preparedChannels)
+                   * (sizeof(juce::dsp::IIR::Filter<double>) + 4 * sizeof(double))
+               + sizeof(juce::dsp::IIR::Coefficients<double>) + 6 * sizeof(double);
+    }
+
 private:
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<double>, juce::dsp::IIR::Coefficients<double>> filter;
+    void filter_block (juce::dsp::AudioBlock<double>& block, int numSamples)
+    {
+        if (!cutoffMod.active())
+        {
+            juce::dsp::ProcessContextReplacing<double> context (block);
+            filter.process (context);
+            return;
+        }
+
+        // Modulated: step the coefficients along the sub-block's ramp every few samples
+        const auto ramp = cutoffMod.next_ramp();
+        for (int start = 0; start < numSamples; start += coefficientInterval)
+        {
+            const int n = juce::jmin (coefficientInterval, numSamples - start);
+            const double octaves = ramp.start + (ramp.end - ramp.start) * (start + n) / numSamples;
+            const double cutoff = juce::jlimit (20.0, 0.45 * preparedRate, initialCutoffFreq * std::exp2 (octaves));
+            set_cutoff (cutoff);
+
+            auto sub = block.getSubBlock (static_cast<size_t> (start), static_cast<size_t> (n));
+            filter.process (juce::dsp::ProcessContextReplacing<double> (sub));
+        }
+    }
+
+    // The array form of the design doesn't allocate, and assigning it reuses
+    // the coefficient storage reserved in the constructor
+    void set_cutoff (double hz)
+    {
+        const auto coefficients = juce::dsp::IIR::ArrayCoefficients<double>::makeLowPass (preparedRate, hz);
+#if TEXTGRAPH_FIXED_POINT
+        filter.set_coefficients (coefficients);
+#else
+        *filter.state = coefficients;
+#endif
+    }
+
+#if TEXTGRAPH_FIXED_POINT
+    q31::Biquad filter;
+#else
+    // A ProcessorDuplicator whose channels can be reset one at a time
+    struct ChannelFilters
+    {
+        juce::dsp::IIR::Coefficients<double>::Ptr state { new juce::dsp::IIR::Coefficients<double>() };
+        juce::OwnedArray<juce::dsp::IIR::Filter<double>> channels;
+
+        void prepare (const juce::dsp::ProcessSpec& spec)
+        {
+            channels.clear();
+            for (juce::uint32 ch = 0; ch < spec.numChannels; ++ch)
+            {
+                auto* f = channels.add (new juce::dsp::IIR::Filter<double> (state));
+                f->prepare ({ spec.sampleRate, spec.maximumBlockSize, 1 });
+            }
+        }
+
+        void reset() noexcept
+        {
+            for (auto* f : channels)
+                f->reset();
+        }
+
+        void reset_channel (int ch) noexcept
+        {
+            if (ch < channels.size())
+                channels[ch]->reset();
+        }
+
+        void process (const juce::dsp::ProcessContextReplacing<double>& context) noexcept
+        {
+            auto& block = context.getOutputBlock();
+            const auto n = juce::jmin (block.getNumChannels(), static_cast<size_t> (channels.size()));
+            for (size_t ch = 0; ch < n; ++ch)
+            {
+                auto one = block.getSingleChannelBlock (ch);
+                channels[static_cast<int> (ch)]->process (juce::dsp::ProcessContextReplacing<double> (one));
+            }
+        }
+    } filter;
+#endif
+    static constexpr int coefficientInterval = 16;
+
     double initialCutoffFreq = 2000.0;
+    double morphCeilingHz = 0.0;
+    int preparedChannels = 0;
+    double preparedRate = 48000.0;
+    bool wasMono = false;
+    ModInput cutoffMod;
+    SilenceSkip silence;
 };
 
  // These do, unfortunately, have to be floats, unless
@@ -97,9 +296,11 @@ private:
  // at the moment. I have my own API use doubles, but
  // translate internally
 
-class ReverbProcessor : public EffectsBase
+class ReverbProcessor : public EffectsBase, public Modulatable
 {
 public:
+    static constexpr std::string_view modulation_target = "size";
+
     ReverbProcessor(double size, double damp, double wet,
                     double dry, double width)
     {
@@ -109,6 +310,7 @@ public:
         params.dryLevel   = juce::jlimit(0.0f, 1.0f, static_cast<float>(dry));
         params.width      = juce::jlimit(0.0f, 1.0f, static_cast<float>(width));
         params.freezeMode = 0.0f;
+        baseRoomSize = params.roomSize;
     }
 
     void prepareToPlay (double sampleRate, int blockSize) override
@@ -123,43 +325,96 @@ public:
                                       static_cast<juce::uint32> (blockSize),
                                       static_cast<juce::uint32> (numCh) };
         reverb.prepare (spec);
+        preparedRate = sampleRate;
 
         tempFloat.setSize (numCh, blockSize, false, false, true);
+        prefault::touch (tempFloat); // the tanks themselves are cleared, so written, by prepare()
+        sizeMod.previous = 0.0;
+
+        // Longer than the longest comb plus all-pass chain at this rate
+        silence = { static_cast<juce::int64> (0.1 * sampleRate) };
     }
 
     void processBlock (juce::AudioBuffer<double>& buffer,
                        juce::MidiBuffer& /*midiMessages*/) override
     {
+        sizeMod.follow_gates();
+        if (silence.skip (buffer))
+            return;
+
         const int numCh      = buffer.getNumChannels();
         const int numSamples = buffer.getNumSamples();
 
-        if (tempFloat.getNumChannels() != numCh ||
-            tempFloat.getNumSamples()  != numSamples)
-            tempFloat.setSize (numCh, numSamples, false, false, true);
+        // The reverb smooths its room size internally, so once per sub-block will do
+        if (sizeMod.active())
+        {
+            params.roomSize = juce::jlimit (0.0f, 1.0f, baseRoomSize + static_cast<float> (sizeMod.next_ramp().end));
+            reverb.setParameters (params);
+        }
 
-        for (int ch = 0; ch < numCh; ++ch)
+        // Under CPU pressure: past the first tier one tank on the summed input,
+        // past the last no reverb at all (faded out, and back in over a block)
+        const int tier = QualityWatchdog::tier();
+        const bool off = tier >= QualityWatchdog::reverbOff;
+        const float dryGain = dryScale * params.dryLevel;
+        if (off && wasOff)
         {
-            const double* src = buffer.getReadPointer (ch);
-            float* dst = tempFloat.getWritePointer (ch);
+            buffer.applyGain (dryGain);
+            silence.processed (buffer);
+            return;
+        }
+        if (wasOff)
+            reverb.reset(); // the tank went stale while bypassed
 
-            for (int i = 0; i < numSamples; ++i) {
-                dst[i] = static_cast<float> (src[i]);
-            }
+        const bool mono = tier >= QualityWatchdog::monoReverb && numCh > 1;
+        const int tankCh = mono ? 1 : numCh;
+
+        // Hosts may hand us shorter blocks than we were prepared for; use the
+        // front of the buffer instead of resizing it on the audio thread. Only a
+        // block bigger than promised in prepareToPlay can make this grow.
+        if (tempFloat.getNumChannels() < numCh ||
+            tempFloat.getNumSamples()  < numSamples)
+            tempFloat.setSize (numCh, numSamples, false, false, true);
+
+        const auto& kernels = isa::kernels();
+        if (mono)
+        {
+            kernels.fold (tempFloat.getWritePointer (0), buffer.getArrayOfReadPointers(), numCh, numSamples);
+        }
+        else
+        {
+            for (int ch = 0; ch < numCh; ++ch)
+                kernels.to_float (tempFloat.getWritePointer (ch), buffer.getReadPointer (ch), numSamples);
         }
 
         // Process the audio using juce::dsp::Reverb (operates on floats).
         // Create a juce::dsp::AudioBlock referencing the temporary float buffer.
-        juce::dsp::AudioBlock<float> floatBlock (tempFloat);
+        auto floatBlock = juce::dsp::AudioBlock<float> (tempFloat)
+                              .getSubsetChannelBlock (0, static_cast<size_t> (tankCh))
+                              .getSubBlock (0, static_cast<size_t> (numSamples));
         reverb.process (juce::dsp::ProcessContextReplacing<float> (floatBlock));
 
+        const bool fading = off != wasOff;
+        wasOff = off;
         for (int ch = 0; ch < numCh; ++ch)
         {
-            const float* src = tempFloat.getReadPointer (ch);
+            const float* src = tempFloat.getReadPointer (mono ? 0 : ch);
             double* dst = buffer.getWritePointer(ch);
 
+            if (!fading)
+            {
+                kernels.to_double (dst, src, numSamples);
+                continue;
+            }
+
+            // dst still holds the input here, i.e. what the dry path is made of
             for (int i = 0; i < numSamples; ++i)
-                dst[i] = static_cast<double> (src[i]);
+            {
+                const double toDry = off ? (i + 1.0) / numSamples : 1.0 - (i + 1.0) / numSamples;
+                dst[i] = (1.0 - toDry) * src[i] + toDry * dryGain * dst[i];
+            }
         }
+        silence.processed (buffer);
     }
 
     void reset() override
@@ -167,6 +422,14 @@ public:
         reverb.reset();
     }
 
+    // juce::Reverb keeps its tanks until destroyed; the conversion buffer can go
+    void releaseResources() override
+    {
+        tempFloat.setSize (0, 0);
+    }
+
+    using EffectsBase::processBlock;
+
     const juce::String getName() const override { return "Reverb"; }
 
     void setReverbParameters (const juce::dsp::Reverb::Parameters& newParams)
@@ -177,20 +440,63 @@ public:
         params.dryLevel   = juce::jlimit(0.0f, 1.0f, newParams.dryLevel);
         params.width      = juce::jlimit(0.0f, 1.0f, newParams.width);
         params.freezeMode = juce::jlimit(0.0f, 1.0f, newParams.freezeMode);
+        baseRoomSize      = params.roomSize;
 
         reverb.setParameters (params);
     }
 
+    // MORPH, on the audio thread: size, damp, wet, dry, width (juce::Reverb
+    // smooths the gains itself)
+    void set_live_params (const double* values)
+    {
+        auto p = params;
+        p.roomSize = static_cast<float> (values[0]);
+        p.damping  = static_cast<float> (values[1]);
+        p.wetLevel = static_cast<float> (values[2]);
+        p.dryLevel = static_cast<float> (values[3]);
+        p.width    = static_cast<float> (values[4]);
+        setReverbParameters (p);
+    }
+
+    ModInput* modulation_input (std::string_view target) override
+    {
+        return target == modulation_target ? &sizeMod : nullptr;
+    }
+
+    std::size_t getHeapBytes() const
+    {
+        // juce::Reverb runs Freeverb: 8 combs and 4 all-passes per channel, tuned
+        // in samples at 44.1kHz and scaled to the actual rate. The right channel's
+        // lines are 23 samples longer.
+        constexpr int combSamples = 1116 + 1188 + 1277 + 1356 + 1422 + 1491 + 1557 + 1617;
+        constexpr int allPassSamples = 556 + 441 + 341 + 225;
+        constexpr int rightSpread = 23 * (8 + 4);
+        const double scale = preparedRate > 0.0 ? preparedRate / 44100.0 : 0.0;
+        const auto tank = static_cast<std::size_t>(scale * (2 * (combSamples + allPassSamples) + rightSpread));
+
+        return tank * sizeof(float)
+             + static_cast<std::size_t>(tempFloat.getNumChannels() * tempFloat.getNumSamples()) * sizeof(float);
+    }
+
 private:
     juce::dsp::Reverb             reverb;    // JUCE stock reverb, operates on floats.
     juce::dsp::Reverb::Parameters params;    // Stores the current reverb parameters.
     juce::AudioBuffer<float>      tempFloat; // Temporary buf for double-to-float and float-to-double conversion.
+    double                        preparedRate = 0.0;
+    float                         baseRoomSize = 0.5f; // before modulation
+    bool                          wasOff = false;      // bypassed by the quality watchdog last block
+    SilenceSkip                   silence;
+
+    static constexpr float dryScale = 2.0f; // juce::Reverb's own gain on the dry level
+    ModInput                      sizeMod;
 };
 
 
-class DelayProcessor : public EffectsBase
+class DelayProcessor : public EffectsBase, public Modulatable
 {
 public:
+    static constexpr std::string_view modulation_target = "wet";
+
     DelayProcessor(double delay, double fb, double wet, double dry)
         : delayTimeSeconds(delay), feedback(fb), wetLevel(wet), dryLevel(dry), currentSampleRate(48000.0)
     {
@@ -210,20 +516,51 @@ public:
             delayLines.emplace_back(static_cast<int>(sampleRate * 2.0)); 
         }
 
-        juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(samplesPerBlock), static_cast<juce::uint32>(numChannels) };
+        // Each line only ever carries one channel, so prepare it as mono; a stereo
+        // spec would allocate a second, never-used 2 second buffer per line.
+        juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(samplesPerBlock), 1 };
 
         for (auto& dl : delayLines)
         {
             dl.prepare(spec);
             dl.setDelay(sampleRate * delayTimeSeconds); 
+
+            // A 2 second line is most of a megabyte that the write head would
+            // otherwise fault in page by page over the first 2 seconds
+            if (RealtimeSetup::prefault())
+            {
+                for (int i = 0; i <= dl.getMaximumDelayInSamples() + 1; ++i)
+                    dl.pushSample(0, {});
+                dl.reset();
+            }
         }
+        wetMod.previous = 0.0;
+
+        // Silent output for a whole delay time means the lines hold only silence
+        silence = { static_cast<juce::int64>(sampleRate * delayTimeSeconds) + 1 };
     }
 
     void processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& /*midiMessages*/) override
     {
-        const int numChannels = buffer.getNumChannels();
+        wetMod.follow_gates();
+        if (silence.skip(buffer))
+            return;
+
         const int numSamples = buffer.getNumSamples();
 
+        // Under CPU pressure one channel goes through its line and is copied
+        const bool mono = QualityWatchdog::tier() >= QualityWatchdog::monoEffects && buffer.getNumChannels() > 1;
+        if (mono)
+            quality::sum_to_first_channel(buffer);
+        const int numChannels = mono ? 1 : buffer.getNumChannels();
+
+        // The other lines stood still while mono and hold stale echoes; they
+        // take over the first line's, which is what every channel was playing
+        if (wasMono && !mono)
+            for (std::size_t ch = 1; ch < delayLines.size(); ++ch)
+                delayLines[ch] = delayLines[0];
+        wasMono = mono;
+
         // Ensure we have a delay line for each channel.
         if (delayLines.size() != static_cast<size_t>(numChannels))
         {
@@ -231,6 +568,14 @@ public:
             // If it wasn't, this is an unexpected state.
         }
 
+        // A modulated wet level ramps sample by sample across the sub-block
+        const bool modulated = wetMod.active();
+        const auto ramp = modulated ? wetMod.next_ramp() : ModInput::Ramp { 0.0, 0.0 };
+        const double wetStep = (ramp.end - ramp.start) / juce::jmax(1, numSamples);
+#if TEXTGRAPH_FIXED_POINT
+        const q31::sample dryQ = q31::from_double(dryLevel), feedbackQ = q31::from_double(feedback);
+        const q31::sample wetQ = q31::from_double(wetLevel);
+#endif
 
         for (int channel = 0; channel < numChannels; ++channel)
         {
@@ -242,19 +587,32 @@ public:
 
                 for (int sample = 0; sample < numSamples; ++sample)
                 {
+                    const double wet = modulated ? juce::jlimit(0.0, 1.0, wetLevel + ramp.start + wetStep * (sample + 1))
+                                                 : wetLevel;
+#if TEXTGRAPH_FIXED_POINT
+                    const q31::sample dry = q31::from_double(channelData[sample]);
+                    const q31::sample delayed = delayLine.popSample(0);
+                    delayLine.pushSample(0, q31::add(dry, q31::mul(delayed, feedbackQ)));
+                    channelData[sample] = q31::to_double(q31::add(q31::mul(dry, dryQ), q31::mul(delayed, modulated ? q31::from_double(wet) : wetQ)));
+#else
                     const double drySample = channelData[sample];
                     const double delayedSample = delayLine.popSample(0); 
 
-                    const double outputSample = (drySample * dryLevel) + (delayedSample * wetLevel);
+                    const double outputSample = (drySample * dryLevel) + (delayedSample * wet);
                     
                     // Calculate sample to push back into delay line (input + feedback from delayed signal)
                     const double sampleToPush = drySample + (delayedSample * feedback);
                     
                     delayLine.pushSample(0, sampleToPush); 
                     channelData[sample] = outputSample;
+#endif
                 }
             }
         }
+
+        if (mono)
+            quality::copy_first_channel(buffer);
+        silence.processed(buffer);
     }
 
     void reset() override
@@ -263,8 +621,18 @@ public:
         {
             dl.reset();
         }
+        wasMono = false;
     }
 
+    // The lines go back to the heap; a retired node (lazy_gates.h) holds none
+    void releaseResources() override
+    {
+        delayLines.clear();
+        delayLines.shrink_to_fit();
+    }
+
+    using EffectsBase::processBlock;
+
     const juce::String getName() const override { return "Delay"; }
 
     void setDelayTimeSeconds(double newDelayTime)
@@ -276,6 +644,7 @@ public:
             {
                 dl.setDelay(currentSampleRate * delayTimeSeconds);
             }
+            silence.tailSamples = static_cast<juce::int64>(currentSampleRate * delayTimeSeconds) + 1;
         }
     }
 
@@ -295,15 +664,47 @@ public:
         dryLevel = juce::jlimit(0.0, 1.0, newDryLevel);
     }
 
+    // MORPH, on the audio thread: time (within the 2 second lines), feedback, wet, dry
+    void set_live_params(const double* values)
+    {
+        setDelayTimeSeconds(juce::jmin(values[0], 2.0));
+        setFeedback(values[1]);
+        setWetLevel(values[2]);
+        setDryLevel(values[3]);
+    }
+
+    ModInput* modulation_input(std::string_view target) override
+    {
+        return target == modulation_target ? &wetMod : nullptr;
+    }
+
+    // Dominated by the delay lines: max delay plus two guard samples each
+    std::size_t getHeapBytes() const
+    {
+        std::size_t bytes = delayLines.capacity() * sizeof(DelayLineType);
+        for (auto& dl : delayLines)
+            bytes += static_cast<std::size_t>(dl.getMaximumDelayInSamples() + 2) * sizeof(DelaySample);
+        return bytes;
+    }
 
 private:
-    std::vector<juce::dsp::DelayLine<double, juce::dsp::DelayLineInterpolationTypes::Linear>> delayLines; 
+#if TEXTGRAPH_FIXED_POINT
+    using DelaySample = q31::sample;
+    using DelayLineType = q31::DelayLine;
+#else
+    using DelaySample = double;
+    using DelayLineType = juce::dsp::DelayLine<double, juce::dsp::DelayLineInterpolationTypes::Linear>;
+#endif
+    std::vector<DelayLineType> delayLines; 
 
     double delayTimeSeconds;
     double feedback;
     double wetLevel;
     double dryLevel;
     double currentSampleRate;
+    bool wasMono = false;
+    ModInput wetMod;
+    SilenceSkip silence;
 };
 
 
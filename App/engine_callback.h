@@ -0,0 +1,171 @@
+#ifndef ENGINE_CALLBACK_H
+#define ENGINE_CALLBACK_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_utils/juce_audio_utils.h>
+
+#include "trace.h"
+#include "engine_stats.h"
+#include "rt_check.h"
+#include "play_latency.h"
+#include "logger.h"
+#include "quantum.h"
+#include "modulation.h"
+#include "quality.h"
+#include "realtime_setup.h"
+#include "analyzer.h"
+
+/* Sits between the audio device and the AudioProcessorPlayer so the engine
+   gets a look at every device callback without the player knowing. Everything
+   here runs on the audio thread: no locks, no allocation, no I/O (a build
+   with the real-time safety checker holds the whole callback to that). */
+
+class EngineCallback : public juce::AudioIODeviceCallback
+{
+public:
+    explicit EngineCallback(juce::AudioProcessorPlayer& player_in) : player(player_in) {}
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData,
+                                           int numInputChannels,
+                                           float* const* outputChannelData,
+                                           int numOutputChannels,
+                                           int numSamples,
+                                           const juce::AudioIODeviceCallbackContext& context) override
+    {
+        // Scheduling/affinity changes are applied by the thread itself, and
+        // only in the callback after they were made
+        RealtimeSetup::get().sync(RealtimeSetup::Role::audio);
+
+        rtcheck::RealtimeScope realtime;
+
+        auto& tracer = Tracer::get();
+        const bool tracing = tracer.isEnabled();
+        if (tracing)
+            Tracer::nameThisThread("audio");
+
+        const auto start = Tracer::nowUs();
+
+        // Nothing but the output node in the graph (after PAUSE, before the first
+        // PLAY): answer with silence instead of running the player at all
+        const bool idle = graphEmpty.load(std::memory_order_relaxed);
+        if (idle != wasIdle)
+        {
+            Log::get().set_idle(idle);
+            wasIdle = idle;
+        }
+        if (idle)
+        {
+            for (int ch = 0; ch < numOutputChannels; ++ch)
+                if (outputChannelData[ch] != nullptr)
+                    juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
+            EngineStats::get().idleCallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            run_graph(inputChannelData, numInputChannels, outputChannelData, numOutputChannels,
+                      numSamples, context);
+        }
+
+        if (const int tap = Analyzer::get().output_tap(); tap >= 0 && numOutputChannels > 0 && outputChannelData[0] != nullptr)
+            Analyzer::get().capture(tap, outputChannelData,
+                                    numOutputChannels > 1 && outputChannelData[1] != nullptr ? 2 : 1, numSamples);
+
+        const auto end = Tracer::nowUs();
+        PlayLatency::get().output_block(outputChannelData, numOutputChannels, numSamples);
+        if (tracing)
+            tracer.record("audio", "callback", start, end);
+
+        const double seconds = static_cast<double>(end - start) * 1.0e-6;
+        auto& stats = EngineStats::get();
+        stats.record_callback(seconds, numSamples, idle);
+        QualityWatchdog::get().observe(seconds, numSamples, currentRate);
+        if (auto* device = currentDevice.load(std::memory_order_relaxed))
+            stats.deviceXruns.store(static_cast<std::uint64_t>(juce::jmax(0, device->getXRunCount())),
+                                    std::memory_order_relaxed);
+    }
+
+    void audioDeviceAboutToStart (juce::AudioIODevice* device) override
+    {
+        const double rate = device->getCurrentSampleRate();
+        currentRate = rate;
+        EngineStats::get().sampleRate.store(rate, std::memory_order_relaxed);
+        if (rate > 0.0)
+            PlayLatency::get().set_device_latency_ms(1000.0 * (device->getOutputLatencyInSamples()
+                                                               + device->getCurrentBufferSizeSamples()) / rate);
+        currentDevice.store(device, std::memory_order_relaxed);
+        player.audioDeviceAboutToStart(device);
+    }
+
+    void audioDeviceStopped() override
+    {
+        currentDevice.store(nullptr, std::memory_order_relaxed);
+        Log::get().set_idle(true);
+        wasIdle = true;
+        player.audioDeviceStopped();
+    }
+
+    void audioDeviceError (const juce::String& errorMessage) override
+    {
+        Log::get().printf(Log::Level::error, "Audio device error: %s\n", errorMessage.toRawUTF8());
+        player.audioDeviceError(errorMessage);
+    }
+
+    // Runs the graph in pieces of this many samples (0 = whole device blocks),
+    // so intermediate buffers stay in cache however big the device buffer is
+    void setQuantum (int samples) { quantum.store(juce::jmax(0, samples), std::memory_order_relaxed); }
+    int getQuantum() const { return quantum.load(std::memory_order_relaxed); }
+
+    // Set on the command thread each time the graph is rebuilt or cleared
+    void setGraphEmpty (bool empty) { graphEmpty.store(empty, std::memory_order_relaxed); }
+
+private:
+    static constexpr int maxChannels = 64;
+
+    void run_graph (const float* const* inputChannelData, int numInputChannels,
+                    float* const* outputChannelData, int numOutputChannels,
+                    int numSamples, const juce::AudioIODeviceCallbackContext& context)
+    {
+        const int q = numInputChannels <= maxChannels && numOutputChannels <= maxChannels
+                        ? quantum.load(std::memory_order_relaxed) : 0;
+        for_each_quantum(numSamples, q, [&](int offset, int length) {
+            ModulationEngine::get().tick(length, currentRate);
+
+            if (offset == 0 && length == numSamples)
+            {
+                player.audioDeviceIOCallbackWithContext(inputChannelData, numInputChannels,
+                                                        outputChannelData, numOutputChannels,
+                                                        numSamples, context);
+                return;
+            }
+
+            for (int ch = 0; ch < numInputChannels; ++ch)
+                inputs[ch] = inputChannelData[ch] != nullptr ? inputChannelData[ch] + offset : nullptr;
+            for (int ch = 0; ch < numOutputChannels; ++ch)
+                outputs[ch] = outputChannelData[ch] != nullptr ? outputChannelData[ch] + offset : nullptr;
+
+            // Each piece gets the host time of its own first sample
+            juce::uint64 hostTime = 0;
+            juce::AudioIODeviceCallbackContext pieceContext;
+            if (context.hostTimeNs != nullptr && currentRate > 0.0)
+            {
+                hostTime = *context.hostTimeNs + static_cast<juce::uint64>(1.0e9 * offset / currentRate);
+                pieceContext.hostTimeNs = &hostTime;
+            }
+
+            player.audioDeviceIOCallbackWithContext(inputs, numInputChannels, outputs, numOutputChannels,
+                                                    length, pieceContext);
+        });
+    }
+
+    juce::AudioProcessorPlayer& player;
+    std::atomic<int> quantum { defaultQuantum };
+    std::atomic<bool> graphEmpty { true };
+    bool wasIdle = false; // audio thread only
+    double currentRate = 0.0;
+    const float* inputs[maxChannels] {};
+    float* outputs[maxChannels] {};
+    std::atomic<juce::AudioIODevice*> currentDevice { nullptr };
+};
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef ENGINE_STATS_H
+#define ENGINE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+ #include <unistd.h>
+#endif
+
+/* Counters and gauges describing the running engine. The audio thread only
+   ever does relaxed stores/adds on these; readers (STATS, the metrics exporter)
+   take whatever values are current, so a snapshot can be a block out of date. */
+
+struct EngineStats
+{
+    static EngineStats& get()
+    {
+        static EngineStats s;
+        return s;
+    }
+
+    // ---- audio thread ----
+    void record_callback(double seconds, int numSamples, bool idle = false) noexcept
+    {
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        samplesProcessed.fetch_add(static_cast<std::uint64_t>(numSamples), std::memory_order_relaxed);
+
+        const double rate = sampleRate.load(std::memory_order_relaxed);
+        if (rate <= 0.0 || numSamples <= 0)
+            return;
+
+        const double load = seconds * rate / numSamples;
+        lastLoad.store(load, std::memory_order_relaxed);
+        smoothedLoad.store(0.95 * smoothedLoad.load(std::memory_order_relaxed) + 0.05 * load,
+                           std::memory_order_relaxed);
+        if (load > peakLoad.load(std::memory_order_relaxed))
+            peakLoad.store(load, std::memory_order_relaxed);
+        if (load > 1.0)
+            deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+
+        // Callbacks in the first half second after a rebuild go in their own
+        // histogram: that's where page faults and cold caches show up
+        if (idle)
+            return;
+        if (const auto r = rebuilds.load(std::memory_order_relaxed); r != seenRebuilds)
+        {
+            seenRebuilds = r;
+            samplesSinceRebuild = 0;
+        }
+        const bool warmup = samplesSinceRebuild < static_cast<std::uint64_t>(warmupSeconds * rate);
+        samplesSinceRebuild += static_cast<std::uint64_t>(numSamples);
+        const int h = warmup ? 1 : 0;
+        loadHistogram[h][load_bucket(load)].fetch_add(1, std::memory_order_relaxed);
+        loadSum[h].store(loadSum[h].load(std::memory_order_relaxed) + load, std::memory_order_relaxed);
+    }
+
+    // ---- command thread ----
+    void record_rebuild(double seconds, int numNodes, int numConnections) noexcept
+    {
+        rebuilds.fetch_add(1, std::memory_order_relaxed);
+        rebuildSecondsTotal.store(rebuildSecondsTotal.load(std::memory_order_relaxed) + seconds,
+                                  std::memory_order_relaxed);
+        lastRebuildSeconds.store(seconds, std::memory_order_relaxed);
+        nodeCount.store(numNodes, std::memory_order_relaxed);
+        connectionCount.store(numConnections, std::memory_order_relaxed);
+    }
+
+    static int load_bucket(double load) noexcept
+    {
+        int b = 0;
+        while (b < loadBuckets - 1 && load > bucketUpper[b])
+            ++b;
+        return b;
+    }
+
+    // Resident set size of the whole process, in bytes (0 where unsupported)
+    static std::uint64_t resident_bytes()
+    {
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        std::uint64_t pages = 0, resident = 0;
+        if (statm >> pages >> resident)
+            return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+        return 0;
+    }
+
+    struct PageFaults { std::uint64_t minor = 0, major = 0; };
+
+    // Page faults of the whole process so far (zeros where unsupported)
+    static PageFaults page_faults()
+    {
+        PageFaults f;
+#if defined(__linux__)
+        // Fields 10 and 12 of /proc/self/stat; the command name (field 2) may hold spaces
+        std::ifstream stat("/proc/self/stat");
+        std::string line;
+        if (!std::getline(stat, line))
+            return f;
+        const auto close = line.rfind(')');
+        if (close == std::string::npos)
+            return f;
+        std::istringstream fields(line.substr(close + 2));
+        std::string skip;
+        for (int i = 3; i < 10; ++i)
+            fields >> skip;
+        fields >> f.minor >> skip >> f.major;
+#endif
+        return f;
+    }
+
+    // Prometheus text exposition format
+    void write_prometheus(std::ostream& os) const
+    {
+        auto metric = [&os](const char* name, const char* type, const char* help, auto value) {
+            os << "# HELP " << name << ' ' << help << '\n'
+               << "# TYPE " << name << ' ' << type << '\n'
+               << name << ' ' << value << '\n';
+        };
+
+        metric("textgraph_callback_load_ratio", "gauge", "Last audio callback time as a fraction of its deadline.",
+               lastLoad.load(std::memory_order_relaxed));
+        metric("textgraph_callback_load_smoothed_ratio", "gauge", "Exponentially smoothed callback load.",
+               smoothedLoad.load(std::memory_order_relaxed));
+        metric("textgraph_callback_load_peak_ratio", "gauge", "Highest callback load seen since start or STATS RESET.",
+               peakLoad.load(std::memory_order_relaxed));
+        metric("textgraph_callbacks_total", "counter", "Audio callbacks processed.",
+               callbacks.load(std::memory_order_relaxed));
+        metric("textgraph_idle_callbacks_total", "counter", "Callbacks answered with silence without running the graph.",
+               idleCallbacks.load(std::memory_order_relaxed));
+        metric("textgraph_deadline_misses_total", "counter", "Callbacks that took longer than their buffer duration.",
+               deadlineMisses.load(std::memory_order_relaxed));
+        metric("textgraph_device_xruns_total", "counter", "Xruns reported by the audio device driver.",
+               deviceXruns.load(std::memory_order_relaxed));
+        for (int h = 0; h < 2; ++h)
+        {
+            const char* name = h == 0 ? "textgraph_callback_load_ratio" : "textgraph_callback_load_after_rebuild_ratio";
+            os << "# HELP " << name << (h == 0 ? " Callback load outside the half second after each rebuild.\n"
+                                               : " Callback load in the half second after each rebuild.\n")
+               << "# TYPE " << name << " histogram\n";
+            std::uint64_t cumulative = 0;
+            for (int b = 0; b < loadBuckets; ++b)
+            {
+                cumulative += loadHistogram[h][static_cast<std::size_t>(b)].load(std::memory_order_relaxed);
+                os << name << "_bucket{le=\"";
+                if (b + 1 < loadBuckets)
+                    os << bucketUpper[b];
+                else
+                    os << "+Inf";
+                os << "\"} " << cumulative << '\n';
+            }
+            os << name << "_sum " << loadSum[static_cast<std::size_t>(h)].load(std::memory_order_relaxed) << '\n'
+               << name << "_count " << cumulative << '\n';
+        }
+        const auto faults = page_faults();
+        metric("textgraph_page_faults_minor_total", "counter", "Minor page faults of the process.", faults.minor);
+        metric("textgraph_page_faults_major_total", "counter", "Major page faults of the process.", faults.major);
+        metric("textgraph_sample_rate_hertz", "gauge", "Current device sample rate.",
+               sampleRate.load(std::memory_order_relaxed));
+        metric("textgraph_graph_nodes", "gauge", "Nodes in the current graph, including the output node.",
+               nodeCount.load(std::memory_order_relaxed));
+        metric("textgraph_graph_connections", "gauge", "Connections in the current graph.",
+               connectionCount.load(std::memory_order_relaxed));
+        metric("textgraph_resident_memory_bytes", "gauge", "Resident set size of the process.",
+               resident_bytes());
+        metric("textgraph_rebuild_last_seconds", "gauge", "Duration of the most recent graph rebuild.",
+               lastRebuildSeconds.load(std::memory_order_relaxed));
+        os << "# HELP textgraph_rebuild_seconds Graph rebuild durations.\n"
+           << "# TYPE textgraph_rebuild_seconds summary\n"
+           << "textgraph_rebuild_seconds_sum " << rebuildSecondsTotal.load(std::memory_order_relaxed) << '\n'
+           << "textgraph_rebuild_seconds_count " << rebuilds.load(std::memory_order_relaxed) << '\n';
+        metric("textgraph_commands_total", "counter", "Commands handled.",
+               commands.load(std::memory_order_relaxed));
+        metric("textgraph_commands_in_flight", "gauge", "Commands received but not yet finished.",
+               commandsInFlight.load(std::memory_order_relaxed));
+    }
+
+    void print(std::ostream& os) const
+    {
+        char line[160];
+        os << "=== Engine stats ===\n";
+        std::snprintf(line, sizeof(line), "Callback load:  %.1f%% now, %.1f%% smoothed, %.1f%% peak\n",
+                      100.0 * lastLoad.load(), 100.0 * smoothedLoad.load(), 100.0 * peakLoad.load());
+        os << line;
+        os << "Callbacks:      " << callbacks.load() << " (" << deadlineMisses.load()
+           << " missed deadline, " << deviceXruns.load() << " device xruns, "
+           << idleCallbacks.load() << " idle)\n";
+        os << "Graph:          " << nodeCount.load() << " nodes, " << connectionCount.load() << " connections\n";
+        std::snprintf(line, sizeof(line), "Rebuilds:       %llu, last %.2f ms\n",
+                      static_cast<unsigned long long>(rebuilds.load()), 1000.0 * lastRebuildSeconds.load());
+        os << line;
+        os << "Resident mem:   " << resident_bytes() / 1024 << " KiB\n";
+        const auto faults = page_faults();
+        os << "Page faults:    " << faults.minor << " minor, " << faults.major << " major\n";
+        print_histogram(os);
+    }
+
+    // Callback load, steady state next to the first half second after each PLAY
+    void print_histogram(std::ostream& os) const
+    {
+        std::uint64_t totals[2] = {};
+        for (int h = 0; h < 2; ++h)
+            for (auto& n : loadHistogram[h])
+                totals[h] += n.load(std::memory_order_relaxed);
+        if (totals[0] + totals[1] == 0)
+            return;
+
+        char line[160];
+        os << "Callback load    steady                      first 0.5 s after PLAY\n";
+        for (int b = 0; b < loadBuckets; ++b)
+        {
+            char range[16];
+            if (b + 1 < loadBuckets)
+                std::snprintf(range, sizeof(range), "%3.0f-%.0f%%", b == 0 ? 0.0 : 100.0 * bucketUpper[b - 1], 100.0 * bucketUpper[b]);
+            else
+                std::snprintf(range, sizeof(range), " >%.0f%%", 100.0 * bucketUpper[b - 1]);
+
+            std::string cells[2];
+            for (int h = 0; h < 2; ++h)
+            {
+                const auto n = loadHistogram[h][static_cast<std::size_t>(b)].load(std::memory_order_relaxed);
+                const double share = totals[h] > 0 ? static_cast<double>(n) / static_cast<double>(totals[h]) : 0.0;
+                char cell[64];
+                std::snprintf(cell, sizeof(cell), "%10llu %-16s", static_cast<unsigned long long>(n),
+                              std::string(static_cast<std::size_t>(share * 16.0 + 0.5), '#').c_str());
+                cells[h] = cell;
+            }
+            std::snprintf(line, sizeof(line), "  %-12s%s  %s\n", range, cells[0].c_str(), cells[1].c_str());
+            os << line;
+        }
+    }
+
+    void reset_peaks() noexcept
+    {
+        peakLoad.store(0.0, std::memory_order_relaxed);
+        for (auto& h : loadHistogram)
+            for (auto& n : h)
+                n.store(0, std::memory_order_relaxed);
+        for (auto& sum : loadSum)
+            sum.store(0.0, std::memory_order_relaxed);
+    }
+
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<double> lastLoad { 0.0 };
+    std::atomic<double> smoothedLoad { 0.0 };
+    std::atomic<double> peakLoad { 0.0 };
+    std::atomic<std::uint64_t> callbacks { 0 };
+    std::atomic<std::uint64_t> samplesProcessed { 0 };
+    std::atomic<std::uint64_t> deadlineMisses { 0 };
+    std::atomic<std::uint64_t> deviceXruns { 0 };
+    std::atomic<std::uint64_t> idleCallbacks { 0 };
+
+    // Load = callback time / buffer duration; the last bucket is open-ended
+    static constexpr int loadBuckets = 13;
+    static constexpr double bucketUpper[loadBuckets - 1] = { 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.5, 2.0 };
+    static constexpr double warmupSeconds = 0.5;
+    std::array<std::array<std::atomic<std::uint64_t>, loadBuckets>, 2> loadHistogram {}; // steady, after a rebuild
+    std::array<std::atomic<double>, 2> loadSum {};  // of every load counted in loadHistogram; audio thread writes
+    std::uint64_t seenRebuilds = 0;        // audio thread only
+    std::uint64_t samplesSinceRebuild = 0; // audio thread only
+
+    std::atomic<int> nodeCount { 0 };
+    std::atomic<int> connectionCount { 0 };
+    std::atomic<std::uint64_t> rebuilds { 0 };
+    std::atomic<double> rebuildSecondsTotal { 0.0 };
+    std::atomic<double> lastRebuildSeconds { 0.0 };
+
+    std::atomic<std::uint64_t> commands { 0 };
+    std::atomic<int> commandsInFlight { 0 };
+};
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef FIXED_RATE_H
+#define FIXED_RATE_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <atomic>
+#include <cmath>
+#include <ostream>
+
+#include "resampler.h"
+
+/* What the AudioProcessorPlayer plays: the graph, either prepared at the
+   device's rate and called directly (the default), or prepared at a fixed
+   internal rate and followed by an OutputResampler to the device's.
+
+   With a fixed rate everything that counts samples (pulse lengths, delay
+   times, modulation steps) sees the same rate whatever device is open, so
+   rhythms round the same way on every device, and a rate below the device's
+   is a way to spend less CPU. Each device block pulls as many internal
+   samples as its outputs need, so the graph runs on blocks that vary by a
+   sample or so; MIDI positions are scaled to match. The graph's input
+   channels are silent in this mode (the device has none open anyway).
+
+   Set with --rate <hz> or the RATE command; 0 follows the device. */
+
+class FixedRateHost : public juce::AudioProcessor
+{
+public:
+    explicit FixedRateHost(juce::AudioProcessorGraph& graph_in)
+        : AudioProcessor (BusesProperties().withInput ("Input", juce::AudioChannelSet::stereo())
+                                           .withOutput ("Output", juce::AudioChannelSet::stereo())),
+          graph(graph_in)
+    {}
+
+    // 0 = the device's rate. Takes effect at once if the device is running:
+    // the graph and every node in it are prepared again at the new rate.
+    void setInternalRate(double hz)
+    {
+        const juce::ScopedLock sl(getCallbackLock());
+        internalRate.store(juce::jmax(0.0, hz), std::memory_order_relaxed);
+        if (getSampleRate() > 0.0)
+        {
+            releaseResources();
+            prepareToPlay(getSampleRate(), getBlockSize());
+        }
+    }
+
+    double getInternalRate() const { return internalRate.load(std::memory_order_relaxed); }
+
+    // The rate the graph actually runs at (the device's when following it)
+    double getEngineRate() const { return engineRate; }
+
+    void prepareToPlay(double deviceRate, int samplesPerBlock) override
+    {
+        const double fixed = internalRate.load(std::memory_order_relaxed);
+        resampling = fixed > 0.0 && fixed != deviceRate;
+        engineRate = resampling ? fixed : deviceRate;
+
+        const int numIn = getTotalNumInputChannels(), numOut = getTotalNumOutputChannels();
+        const int numChannels = juce::jmax(numIn, numOut);
+        if (resampling)
+        {
+            resampler.prepare(engineRate, deviceRate, numChannels, samplesPerBlock);
+            engineBlock = resampler.input_needed(samplesPerBlock) + 2;
+            scaledMidi.ensureSize(4096);
+            setLatencySamples(resampler.getLatency());
+        }
+        else
+        {
+            engineBlock = samplesPerBlock;
+            setLatencySamples(0);
+        }
+
+        graph.setProcessingPrecision(getProcessingPrecision());
+        graph.setPlayConfigDetails(numIn, numOut, engineRate, engineBlock);
+        graph.prepareToPlay(engineRate, engineBlock);
+    }
+
+    void releaseResources() override { graph.releaseResources(); }
+
+    void reset() override
+    {
+        graph.reset();
+        if (resampling)
+            resampler.reset();
+    }
+
+    void processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midi) override
+    {
+        if (!resampling)
+        {
+            graph.processBlock(buffer, midi);
+            return;
+        }
+
+        // A device block larger than the one prepared for would overrun the
+        // resampler's history: it goes through in pieces of the prepared size
+        const int used = juce::jmin(buffer.getNumChannels(), static_cast<int>(maxChannels));
+        double* out[maxChannels] {};
+        for (int done = 0; done < buffer.getNumSamples();)
+        {
+            const int numOut = juce::jmin(buffer.getNumSamples() - done, resampler.max_output_block());
+            for (int ch = 0; ch < used; ++ch)
+                out[ch] = buffer.getWritePointer(ch, done);
+            process_piece(out, used, numOut, midi, done);
+            done += numOut;
+        }
+        midi.clear();
+    }
+
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        buffer.clear(); // the player is set to double precision
+    }
+
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    void print(std::ostream& os) const
+    {
+        os << "Engine rate:    ";
+        if (resampling)
+            os << engineRate << " Hz fixed, resampled to the device's " << getSampleRate() << " Hz ("
+               << resampler.getTaps() << " taps, " << getLatencySamples() << " samples latency)\n";
+        else if (getInternalRate() > 0.0)
+            os << engineRate << " Hz fixed, the same as the device's\n";
+        else
+            os << "follows the device (" << engineRate << " Hz)\n";
+    }
+
+    std::size_t getHeapBytes() const { return resampling ? resampler.getHeapBytes() : 0; }
+
+    const juce::String getName() const override                  { return "Engine"; }
+    double getTailLengthSeconds() const override                 { return graph.getTailLengthSeconds(); }
+    bool acceptsMidi() const override                            { return true; }
+    bool producesMidi() const override                           { return false; }
+
+    juce::AudioProcessorEditor* createEditor() override          { return nullptr; }
+    bool hasEditor() const override                              { return false; }
+
+    int getNumPrograms() override                                { return 1; }
+    int getCurrentProgram() override                             { return 0; }
+    void setCurrentProgram (int) override                        {}
+    const juce::String getProgramName (int) override             { return {}; }
+    void changeProgramName (int, const juce::String&) override   {}
+
+    void getStateInformation (juce::MemoryBlock&) override       {}
+    void setStateInformation (const void*, int) override         {}
+
+private:
+    static constexpr int maxChannels = 64;
+
+    // numOut device samples from the device block's sample offset on
+    void process_piece(double* const* out, int used, int numOut, const juce::MidiBuffer& midi, int offset)
+    {
+        const int numIn = resampler.input_needed(numOut);
+        jassert(numIn <= engineBlock);
+
+        // The graph writes straight into the resampler's history
+        double* channels[maxChannels] {};
+        for (int ch = 0; ch < used; ++ch)
+        {
+            channels[ch] = resampler.input(ch);
+            juce::FloatVectorOperations::clear(channels[ch], numIn);
+        }
+        juce::AudioBuffer<double> engineBuffer(channels, used, numIn);
+
+        // MIDI lands at the same point in time in the shorter or longer block
+        scaledMidi.clear();
+        for (const auto metadata : midi)
+        {
+            const int at = metadata.samplePosition - offset;
+            if (at < 0 || at >= numOut)
+                continue;
+            scaledMidi.addEvent(metadata.data, metadata.numBytes,
+                                juce::jlimit(0, juce::jmax(0, numIn - 1),
+                                             static_cast<int>(static_cast<juce::int64>(at) * numIn / numOut)));
+        }
+
+        if (numIn > 0)
+            graph.processBlock(engineBuffer, scaledMidi);
+
+        resampler.process(numIn, out, juce::jmin(used, getTotalNumOutputChannels()), numOut);
+    }
+
+    juce::AudioProcessorGraph& graph;
+    std::atomic<double> internalRate { 0.0 };
+    double engineRate = 0.0;
+    bool resampling = false;
+    int engineBlock = 0;
+    OutputResampler resampler;
+    juce::MidiBuffer scaledMidi;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FixedRateHost)
+};
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "offline_render.h"
+
+/* Golden-render regression harness:
+
+     ConsoleAppMessageThread --golden record [dir] [options] [score files...]
+     ConsoleAppMessageThread --golden check  [dir] [options] [score files...]
+
+   Renders each command file (default: the two examples) plus a corpus of
+   generated scores offline with a fixed noise seed, and either stores the
+   result or compares it against what is stored. Every word of a score is
+   captured through its own WordBus, so a mismatch is pinned to the word that
+   changed, not just to the mix. Renders run with the live app's quantum
+   (defaultQuantum) so they take the same path through the graph.
+
+   The directory defaults to App/golden and the examples to App/examples in
+   the source tree (TEXTGRAPH_SOURCE_DIR), wherever the binary runs from.
+   No baseline ships with the source: record one first, from the tree as it
+   is before a change, then check after it. Besides the tracks, record writes
+   checksums.txt (one line per track with a hash of its float32 samples), and
+   check falls back to it (bit-exact) for any track whose .f32 file is gone,
+   so the small file alone can be kept or passed around as a baseline.
+
+   Options:
+     --seconds <s>    length of each render (default 4)
+     --corpus <n>     number of generated scores (default 6)
+     --exact          require bit-exact output (default: tolerance mode
+                      where the .f32 tracks exist)
+     --max-abs <x>    tolerance: largest allowed sample difference (default 1e-4)
+     --max-lsd <dB>   tolerance: largest allowed log-spectral distance (default 0.5)
+
+   Exit code is 0 when everything matches, 1 otherwise. */
+
+#ifndef TEXTGRAPH_SOURCE_DIR
+#define TEXTGRAPH_SOURCE_DIR "App"
+#endif
+
+namespace golden
+{
+
+inline std::filesystem::path source_dir() { return TEXTGRAPH_SOURCE_DIR; }
+
+struct Score
+{
+    std::string name;
+    std::vector<std::string> lines;
+};
+
+struct Options
+{
+    bool record = false;
+    std::filesystem::path dir;
+    double seconds = 4.0;
+    int corpus = 6;
+    bool exact = false;
+    double maxAbs = 1.0e-4;
+    double maxLsdDb = 0.5;
+    std::vector<std::string> files;
+};
+
+// A random but fully SET score: every letter it uses is bound explicitly, so
+// the render doesn't depend on the compile-time random bindings.
+inline Score generate_score(int index)
+{
+    juce::Random rng(1000 + index);
+    Score score { "corpus" + std::to_string(index), {} };
+
+    static const char* osc_types[] = { "sin", "square", "saw", "triangle", "noise" };
+    const std::string oscs = "abcde", pulsers = "mnp";
+
+    for (char c : oscs)
+        score.lines.push_back(std::string("SET ") + c + " " + osc_types[rng.nextInt(5)]
+                              + " note " + std::to_string(36 + rng.nextInt(48)));
+    for (char c : pulsers)
+        score.lines.push_back(std::string("SET ") + c + " midi bpm " + std::to_string(60 + rng.nextInt(240))
+                              + " on " + std::to_string(1 + rng.nextInt(4))
+                              + " off " + std::to_string(rng.nextInt(4)));
+    score.lines.push_back("SET f filter cutoff " + std::to_string(300 + rng.nextInt(5000)));
+    score.lines.push_back("SET r reverb size 0." + std::to_string(rng.nextInt(10)) + " wet 0.4");
+    score.lines.push_back("SET s delay time 0." + std::to_string(1 + rng.nextInt(9)) + " feedback 0.3");
+
+    const std::string effects = "frs";
+    std::function<std::string(int)> group = [&](int depth) {
+        std::string g;
+        const int items = 1 + rng.nextInt(3);
+        for (int i = 0; i < items; ++i)
+        {
+            if (depth < 2 && rng.nextInt(3) == 0)
+                g += std::string(1, pulsers[static_cast<std::size_t>(rng.nextInt(3))]) + "(" + group(depth + 1) + ")";
+            else
+                g += oscs[static_cast<std::size_t>(rng.nextInt(5))];
+        }
+        if (rng.nextInt(2) == 0)
+            g += effects[static_cast<std::size_t>(rng.nextInt(3))];
+        return g;
+    };
+
+    std::string text;
+    const int words = 1 + rng.nextInt(4);
+    for (int w = 0; w < words; ++w)
+        text += (w > 0 ? " " : "") + group(0);
+
+    score.lines.push_back("\"" + text + "\"");
+    score.lines.push_back("PLAY");
+    return score;
+}
+
+inline std::optional<Score> load_score(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return std::nullopt;
+
+    Score score { std::filesystem::path(path).stem().string(), {} };
+    std::string line;
+    while (std::getline(file, line))
+        score.lines.push_back(line);
+    return score;
+}
+
+struct Track
+{
+    std::string label;    // "mix" or "word #2 (af)"
+    std::string fileName; // under the golden directory
+    juce::AudioBuffer<double> audio;
+};
+
+inline std::vector<Track> render(const Score& score, double seconds)
+{
+    RenderSettings settings;
+    settings.randomBindings = false;
+    settings.wordBuses = true;
+    settings.quantum = defaultQuantum;
+
+    OfflineEngine engine(settings);
+    for (auto& line : score.lines)
+        engine.command(line);
+
+    const int numSamples = static_cast<int>(seconds * settings.sampleRate);
+    std::vector<juce::AudioBuffer<double>> words;
+    engine.capture_words(words, numSamples);
+
+    std::vector<Track> tracks(1);
+    tracks[0].label = "mix";
+    tracks[0].fileName = score.name + ".mix.f32";
+    tracks[0].audio.setSize(2, numSamples);
+    engine.render(tracks[0].audio, 0, numSamples);
+
+    for (std::size_t w = 0; w < words.size(); ++w)
+    {
+        Track t;
+        t.label = "word #" + std::to_string(w) + " " + engine.words()[w];
+        t.fileName = score.name + ".word" + std::to_string(w) + ".f32";
+        t.audio = std::move(words[w]);
+        tracks.push_back(std::move(t));
+    }
+    return tracks;
+}
+
+// Golden files: "TGG1", channels, samples (uint32 each), then planar float32.
+// Float is what reaches the device, so that's the precision we pin down.
+// The length is fixed up front and blocks are appended as they're rendered,
+// each channel's part written at its place in that channel's run, so a long
+// render never has to be held in memory.
+class TrackWriter
+{
+public:
+    TrackWriter(const std::filesystem::path& path, int channels, juce::int64 samples)
+        : out(path, std::ios::binary | std::ios::trunc), numChannels(channels), total(samples)
+    {
+        if (!out.is_open() || channels < 0 || samples < 0 || samples > std::numeric_limits<std::uint32_t>::max())
+        {
+            out.setstate(std::ios::failbit);
+            return;
+        }
+        const std::uint32_t header[] = { 0x31474754u, static_cast<std::uint32_t>(channels), static_cast<std::uint32_t>(samples) };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+
+    // The first n samples of each of the buffer's channels go after what was written so far
+    bool append(const juce::AudioBuffer<double>& audio, int n)
+    {
+        if (!out.good() || n < 0 || written + n > total || audio.getNumChannels() < numChannels)
+            return false;
+        block.resize(static_cast<std::size_t>(n));
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const double* src = audio.getReadPointer(ch);
+            for (int i = 0; i < n; ++i)
+                block[static_cast<std::size_t>(i)] = static_cast<float>(src[i]);
+            out.seekp(static_cast<std::streamoff>(3 * sizeof(std::uint32_t) + (ch * total + written) * sizeof(float)));
+            out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(n * sizeof(float)));
+        }
+        written += n;
+        return out.good();
+    }
+
+    bool finish()
+    {
+        out.close();
+        return written == total && !out.fail();
+    }
+
+private:
+    std::ofstream out;
+    int numChannels;
+    juce::int64 total;
+    juce::int64 written = 0;
+    std::vector<float> block;
+};
+
+inline bool write_track(const std::filesystem::path& path, const juce::AudioBuffer<double>& audio)
+{
+    TrackWriter writer(path, audio.getNumChannels(), audio.getNumSamples());
+    return writer.append(audio, audio.getNumSamples()) && writer.finish();
+}
+
+inline std::optional<juce::AudioBuffer<float>> read_track(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::uint32_t header[3] {};
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 0x31474754u)
+        return std::nullopt;
+
+    juce::AudioBuffer<float> audio(static_cast<int>(header[1]), static_cast<int>(header[2]));
+    for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+        if (!in.read(reinterpret_cast<char*>(audio.getWritePointer(ch)),
+                     static_cast<std::streamsize>(header[2] * sizeof(float))))
+            return std::nullopt;
+    return audio;
+}
+
+// FNV-1a over the float32 samples as written to a track, channel after channel
+inline std::uint64_t checksum(const juce::AudioBuffer<double>& audio)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+    {
+        const double* src = audio.getReadPointer(ch);
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+        {
+            const float x = static_cast<float>(src[i]);
+            unsigned char bytes[sizeof(float)];
+            std::memcpy(bytes, &x, sizeof(float));
+            for (unsigned char b : bytes)
+                hash = (hash ^ b) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// checksums.txt: "<track file> <channels> <samples> <hash as 16 hex digits>" per line
+struct Checksum
+{
+    int channels = 0, samples = 0;
+    std::uint64_t hash = 0;
+};
+
+inline std::map<std::string, Checksum> read_checksums(const std::filesystem::path& path)
+{
+    std::map<std::string, Checksum> sums;
+    std::ifstream in(path);
+    std::string name, hex;
+    Checksum c;
+    while (in >> name >> c.channels >> c.samples >> hex)
+    {
+        c.hash = std::strtoull(hex.c_str(), nullptr, 16);
+        sums[name] = c;
+    }
+    return sums;
+}
+
+inline bool write_checksums(const std::filesystem::path& path, const std::map<std::string, Checksum>& sums)
+{
+    std::ofstream out(path);
+    for (const auto& [name, c] : sums)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s %d %d %016llx\n", name.c_str(), c.channels, c.samples,
+                      static_cast<unsigned long long>(c.hash));
+        out << line;
+    }
+    return out.good();
+}
+
+struct Difference
+{
+    double maxAbs = 0.0;
+    double lsdDb = 0.0; // worst per-frame log-spectral distance
+    bool bitExact = true;
+    bool sizeMismatch = false;
+};
+
+// Root-mean-square dB difference between the magnitude spectra of one frame
+inline double log_spectral_distance(std::vector<float>& a, std::vector<float>& b,
+                                    const juce::dsp::FFT& fft, std::size_t frameSize)
+{
+    fft.performFrequencyOnlyForwardTransform(a.data(), true);
+    fft.performFrequencyOnlyForwardTransform(b.data(), true);
+
+    double sum = 0.0;
+    const std::size_t bins = frameSize / 2 + 1;
+    for (std::size_t k = 0; k < bins; ++k)
+    {
+        const double da = 20.0 * std::log10(a[k] + 1.0e-9);
+        const double db = 20.0 * std::log10(b[k] + 1.0e-9);
+        sum += (da - db) * (da - db);
+    }
+    return std::sqrt(sum / static_cast<double>(bins));
+}
+
+inline Difference compare(const juce::AudioBuffer<float>& golden, const juce::AudioBuffer<double>& rendered)
+{
+    Difference d;
+    if (golden.getNumChannels() != rendered.getNumChannels()
+        || golden.getNumSamples() != rendered.getNumSamples())
+    {
+        d.sizeMismatch = true;
+        d.bitExact = false;
+        return d;
+    }
+
+    constexpr int fftOrder = 11;
+    constexpr std::size_t frameSize = 1 << fftOrder;
+    juce::dsp::FFT fft(fftOrder);
+    juce::dsp::WindowingFunction<float> window(frameSize, juce::dsp::WindowingFunction<float>::hann);
+    std::vector<float> a(2 * frameSize), b(2 * frameSize);
+
+    const int n = golden.getNumSamples();
+    for (int ch = 0; ch < golden.getNumChannels(); ++ch)
+    {
+        const float* g = golden.getReadPointer(ch);
+        const double* r = rendered.getReadPointer(ch);
+
+        for (int i = 0; i < n; ++i)
+        {
+            const float rf = static_cast<float>(r[i]);
+            d.bitExact = d.bitExact && std::memcmp(&rf, &g[i], sizeof(float)) == 0;
+            d.maxAbs = juce::jmax(d.maxAbs, std::abs(static_cast<double>(rf) - static_cast<double>(g[i])));
+        }
+
+        for (int start = 0; start + static_cast<int>(frameSize) <= n; start += static_cast<int>(frameSize / 2))
+        {
+            std::fill(a.begin(), a.end(), 0.0f);
+            std::fill(b.begin(), b.end(), 0.0f);
+            for (std::size_t i = 0; i < frameSize; ++i)
+            {
+                a[i] = g[static_cast<std::size_t>(start) + i];
+                b[i] = static_cast<float>(r[static_cast<std::size_t>(start) + i]);
+            }
+            window.multiplyWithWindowingTable(a.data(), frameSize);
+            window.multiplyWithWindowingTable(b.data(), frameSize);
+            d.lsdDb = juce::jmax(d.lsdDb, log_spectral_distance(a, b, fft, frameSize));
+        }
+    }
+    return d;
+}
+
+inline std::optional<Options> parse_options(int argc, char* argv[])
+{
+    // argv[1] is "--golden"
+    if (argc < 3)
+        return std::nullopt;
+
+    Options o;
+    const std::string mode = argv[2];
+    if (mode != "record" && mode != "check")
+        return std::nullopt;
+    o.record = mode == "record";
+
+    int i = 3;
+    o.dir = i < argc && argv[i][0] != '-' ? std::filesystem::path(argv[i++]) : source_dir() / "golden";
+
+    for (; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--seconds" && hasValue)      o.seconds = std::stod(argv[++i]);
+        else if (arg == "--corpus" && hasValue)  o.corpus = std::stoi(argv[++i]);
+        else if (arg == "--max-abs" && hasValue) o.maxAbs = std::stod(argv[++i]);
+        else if (arg == "--max-lsd" && hasValue) o.maxLsdDb = std::stod(argv[++i]);
+        else if (arg == "--exact")               o.exact = true;
+        else                                     o.files.push_back(arg);
+    }
+
+    if (o.files.empty())
+        o.files = { (source_dir() / "examples" / "example1.txt").string(),
+                    (source_dir() / "examples" / "example2.txt").string() };
+    return o;
+}
+
+inline int run(int argc, char* argv[])
+{
+    auto options = parse_options(argc, argv);
+    if (!options)
+    {
+        std::cerr << "Usage: --golden record|check [dir] [--seconds s] [--corpus n] [--exact]"
+                     " [--max-abs x] [--max-lsd dB] [score files...]\n";
+        return 1;
+    }
+    auto& o = *options;
+
+    std::vector<Score> scores;
+    for (auto& path : o.files)
+    {
+        if (auto score = load_score(path))
+            scores.push_back(std::move(*score));
+        else
+            std::cerr << "[golden] cannot open '" << path << "', skipping\n";
+    }
+    for (int i = 0; i < o.corpus; ++i)
+        scores.push_back(generate_score(i));
+
+    const auto checksumsPath = o.dir / "checksums.txt";
+    auto sums = o.record ? std::map<std::string, Checksum> {} : read_checksums(checksumsPath);
+    if (o.record)
+        std::filesystem::create_directories(o.dir);
+    else if (!std::filesystem::is_directory(o.dir))
+    {
+        std::cerr << "[golden] no baseline in '" << o.dir.string() << "': run --golden record before the change"
+                     " you want to check\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (auto& score : scores)
+    {
+        std::vector<Track> tracks;
+        try {
+            tracks = render(score, o.seconds);
+        } catch (const std::exception& e) {
+            std::cerr << "[golden] " << score.name << ": render failed: " << e.what() << "\n";
+            ++failures;
+            continue;
+        }
+
+        for (auto& track : tracks)
+        {
+            const auto path = o.dir / track.fileName;
+            char line[256];
+
+            if (o.record)
+            {
+                sums[track.fileName] = { track.audio.getNumChannels(), track.audio.getNumSamples(), checksum(track.audio) };
+                const bool ok = write_track(path, track.audio);
+                failures += ok ? 0 : 1;
+                std::snprintf(line, sizeof(line), "[golden] %-10s %-28s %s\n", score.name.c_str(),
+                              track.label.c_str(), ok ? "recorded" : "WRITE FAILED");
+                std::cout << line;
+                continue;
+            }
+
+            auto golden = read_track(path);
+            if (!golden && sums.count(track.fileName) != 0)
+            {
+                const auto& want = sums[track.fileName];
+                const bool pass = want.channels == track.audio.getNumChannels() && want.samples == track.audio.getNumSamples()
+                                  && want.hash == checksum(track.audio);
+                failures += pass ? 0 : 1;
+                std::snprintf(line, sizeof(line), "[golden] %-10s %-28s checksum %s\n", score.name.c_str(),
+                              track.label.c_str(), pass ? "bit-exact ok" : "FAIL");
+                std::cout << line;
+                continue;
+            }
+            if (!golden)
+            {
+                ++failures;
+                std::snprintf(line, sizeof(line), "[golden] %-10s %-28s MISSING %s\n", score.name.c_str(),
+                              track.label.c_str(), path.string().c_str());
+                std::cout << line;
+                continue;
+            }
+
+            const auto d = compare(*golden, track.audio);
+            const bool pass = !d.sizeMismatch
+                              && (o.exact ? d.bitExact : (d.maxAbs <= o.maxAbs && d.lsdDb <= o.maxLsdDb));
+            failures += pass ? 0 : 1;
+
+            if (d.sizeMismatch)
+                std::snprintf(line, sizeof(line), "[golden] %-10s %-28s FAIL length/channel mismatch\n",
+                              score.name.c_str(), track.label.c_str());
+            else
+                std::snprintf(line, sizeof(line), "[golden] %-10s %-28s max|err| %.3e  LSD %.3f dB  %s%s\n",
+                              score.name.c_str(), track.label.c_str(), d.maxAbs, d.lsdDb,
+                              d.bitExact ? "bit-exact " : "", pass ? "ok" : "FAIL");
+            std::cout << line;
+        }
+    }
+
+    if (o.record && !write_checksums(checksumsPath, sums))
+    {
+        std::cerr << "[golden] cannot write '" << checksumsPath.string() << "'\n";
+        ++failures;
+    }
+
+    std::cout << "[golden] " << scores.size() << " scores, " << failures << " failure(s)\n";
+    return failures == 0 ? 0 : 1;
+}
+
+}
+
+#endif
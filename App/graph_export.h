@@ -0,0 +1,305 @@
+#ifndef GRAPH_EXPORT_H
+#define GRAPH_EXPORT_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "instrumented.h"
+#include "letter_binds.h"
+#include "memory_report.h"
+
+/* GRAPH command: the running graph with what each node costs.
+
+     GRAPH                        nodes and connections as a table
+     GRAPH DOT <file> [seconds]   Graphviz, nodes shaded by CPU
+     GRAPH JSON <file> [seconds]  the same data for other tools
+
+   Costs are measured over a window (1 s by default) with NodeInfo's
+   counters switched on: time in processBlock per block and as a share of
+   all nodes' time, and the share of blocks that came out silent (a node
+   asleep behind a closed gate counts as silent and free). Memory is the
+   processor's heap plus MEM's estimate of its graph buffers. Parameters are
+   the letter's current bindings. Nodes not created from a letter (the
+   output, word buses, analyzer taps) appear with their JUCE name. */
+
+namespace graph_export
+{
+
+struct Node
+{
+    int id = 0;
+    char letter = 0;            // 0: not a letter's node
+    std::string type;           // type name, or the processor's name
+    int word = -1;
+    int offset = -1;            // character in the word
+    std::vector<std::pair<std::string, double>> params;
+    std::uint64_t blocks = 0;
+    double usPerBlock = 0.0;
+    double cpuShare = 0.0;      // of all measured node time
+    double silentRatio = 0.0;
+    std::size_t bytes = 0;
+};
+
+struct Edge
+{
+    int from = 0, to = 0;
+    int channels = 0;           // audio channels connected
+    bool midi = false;
+};
+
+struct Snapshot
+{
+    double window = 0.0;        // seconds measured (0: not measured)
+    std::vector<std::string> words;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+};
+
+// Switches the counters on for the window; the command thread waits it out
+inline void measure(juce::AudioProcessorGraph& graph, double seconds)
+{
+    for (auto* node : graph.getNodes())
+        if (auto* info = node_info(node->getProcessor()))
+            info->reset_cost();
+    NodeInfo::costing().store(true, std::memory_order_relaxed);
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    NodeInfo::costing().store(false, std::memory_order_relaxed);
+}
+
+inline Snapshot snapshot(juce::AudioProcessorGraph& graph, const LetterRegistry& reg,
+                         const std::vector<std::string>& words, double window)
+{
+    Snapshot s;
+    s.window = window;
+    s.words = words;
+
+    const double ticksPerUs = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()) * 1.0e-6;
+    double totalTicks = 0.0;
+    for (auto* node : graph.getNodes())
+    {
+        auto* proc = node->getProcessor();
+        Node n;
+        n.id = static_cast<int>(node->nodeID.uid);
+        n.bytes = graph_overhead(*proc).graph;
+
+        if (auto* info = node_info(proc))
+        {
+            n.letter = info->letter;
+            n.type = info->typeName;
+            n.word = info->word;
+            n.offset = info->offset;
+            n.bytes += info->heap_bytes();
+
+            const auto names = reg.param_names(info->letter);
+            const auto values = reg.param_values(info->letter);
+            for (std::size_t k = 0; k < names.size() && k < values.size(); ++k)
+                n.params.emplace_back(std::string(names[k]), values[k]);
+
+            n.blocks = info->cost.blocks.load(std::memory_order_relaxed);
+            const auto ticks = static_cast<double>(info->cost.ticks.load(std::memory_order_relaxed));
+            totalTicks += ticks;
+            n.cpuShare = ticks; // normalised below
+            if (n.blocks > 0)
+            {
+                n.usPerBlock = ticks / ticksPerUs / static_cast<double>(n.blocks);
+                n.silentRatio = static_cast<double>(info->cost.silent.load(std::memory_order_relaxed))
+                              / static_cast<double>(n.blocks);
+            }
+        }
+        else
+        {
+            n.type = proc->getName().toStdString();
+        }
+        s.nodes.push_back(std::move(n));
+    }
+    for (auto& n : s.nodes)
+        n.cpuShare = totalTicks > 0.0 ? n.cpuShare / totalTicks : 0.0;
+
+    std::map<std::pair<int, int>, std::size_t> audio;
+    for (const auto& c : graph.getConnections())
+    {
+        const int from = static_cast<int>(c.source.nodeID.uid), to = static_cast<int>(c.destination.nodeID.uid);
+        if (c.source.channelIndex == juce::AudioProcessorGraph::midiChannelIndex)
+        {
+            s.edges.push_back({ from, to, 0, true });
+            continue;
+        }
+        auto [it, added] = audio.try_emplace({ from, to }, s.edges.size());
+        if (added)
+            s.edges.push_back({ from, to, 0, false });
+        ++s.edges[it->second].channels;
+    }
+    return s;
+}
+
+inline std::string label(const Node& n)
+{
+    if (n.letter == 0)
+        return n.type;
+    return std::string(1, n.letter) + ":" + n.type;
+}
+
+inline std::string escaped(std::string_view text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+inline void write_dot(std::ostream& os, const Snapshot& s)
+{
+    char text[96];
+    os << "digraph textgraph {\n  rankdir=LR;\n  node [shape=box, style=filled, fontname=\"monospace\"];\n";
+    for (const auto& n : s.nodes)
+    {
+        // Each part escaped on its own; the "\n" between them is DOT's line break
+        std::string body = escaped(label(n));
+        if (n.word >= 0 && static_cast<std::size_t>(n.word) < s.words.size())
+            body += "  (word " + std::to_string(n.word) + ", char " + std::to_string(n.offset) + ")";
+        for (const auto& [name, value] : n.params)
+        {
+            std::snprintf(text, sizeof(text), " %g", value);
+            body += "\\n" + escaped(name) + text;
+        }
+        if (s.window > 0.0 && n.letter != 0)
+        {
+            std::snprintf(text, sizeof(text), "\\n%.2f us/block, %.1f%% CPU, %.0f%% silent",
+                          n.usPerBlock, 100.0 * n.cpuShare, 100.0 * n.silentRatio);
+            body += text;
+        }
+        body += "\\n" + format_bytes(n.bytes);
+
+        // White to red with the node's share of the time
+        const int shade = 255 - static_cast<int>(std::min(1.0, 2.0 * n.cpuShare) * 200.0);
+        std::snprintf(text, sizeof(text), "#ff%02x%02x", shade, shade);
+        os << "  n" << n.id << " [label=\"" << body << "\", fillcolor=\"" << text << "\"];\n";
+    }
+    for (const auto& e : s.edges)
+    {
+        os << "  n" << e.from << " -> n" << e.to;
+        if (e.midi)
+            os << " [style=dashed, label=\"midi\"]";
+        else if (e.channels != 2)
+            os << " [label=\"" << e.channels << " ch\"]";
+        os << ";\n";
+    }
+    os << "}\n";
+}
+
+inline void write_json(std::ostream& os, const Snapshot& s)
+{
+    char text[64];
+    // JSON has no nan or inf
+    auto number = [&text](double v) {
+        if (!std::isfinite(v))
+            return std::string("null");
+        std::snprintf(text, sizeof(text), "%.6g", v);
+        return std::string(text);
+    };
+    os << "{\"window_s\":" << number(s.window) << ",\"words\":[";
+    for (std::size_t w = 0; w < s.words.size(); ++w)
+        os << (w ? "," : "") << '"' << escaped(s.words[w]) << '"';
+    os << "],\"nodes\":[";
+    for (std::size_t i = 0; i < s.nodes.size(); ++i)
+    {
+        const auto& n = s.nodes[i];
+        os << (i ? "," : "") << "\n{\"id\":" << n.id << ",\"letter\":";
+        if (n.letter != 0)
+            os << "\"" << escaped(std::string(1, n.letter)) << "\"";
+        else
+            os << "null";
+        os << ",\"type\":\"" << escaped(n.type) << "\",\"word\":" << n.word << ",\"offset\":" << n.offset << ",\"params\":{";
+        for (std::size_t k = 0; k < n.params.size(); ++k)
+            os << (k ? "," : "") << '"' << escaped(n.params[k].first) << "\":" << number(n.params[k].second);
+        os << "},\"blocks\":" << n.blocks << ",\"us_per_block\":" << number(n.usPerBlock)
+           << ",\"cpu_share\":" << number(n.cpuShare) << ",\"silent_ratio\":" << number(n.silentRatio)
+           << ",\"bytes\":" << n.bytes << '}';
+    }
+    os << "\n],\"edges\":[";
+    for (std::size_t i = 0; i < s.edges.size(); ++i)
+    {
+        const auto& e = s.edges[i];
+        os << (i ? "," : "") << "\n{\"from\":" << e.from << ",\"to\":" << e.to << ",\"kind\":\""
+           << (e.midi ? "midi" : "audio") << "\",\"channels\":" << e.channels << '}';
+    }
+    os << "\n]}\n";
+}
+
+inline void print_table(std::ostream& os, const Snapshot& s)
+{
+    char text[200];
+    std::snprintf(text, sizeof(text), "=== Graph: %d nodes, %d connections, measured over %.1f s ===\n",
+                  static_cast<int>(s.nodes.size()), static_cast<int>(s.edges.size()), s.window);
+    os << text;
+    os << "    id  node             word  us/block    CPU  silent      memory  parameters\n";
+    for (const auto& n : s.nodes)
+    {
+        std::string params;
+        for (const auto& [name, value] : n.params)
+        {
+            char p[48];
+            std::snprintf(p, sizeof(p), "%s%s %g", params.empty() ? "" : ", ", name.c_str(), value);
+            params += p;
+        }
+        std::snprintf(text, sizeof(text), "  %4d  %-16.16s %4d  %8.2f %5.1f%%   %4.0f%%  %10s  %s\n",
+                      n.id, label(n).c_str(), n.word, n.usPerBlock, 100.0 * n.cpuShare, 100.0 * n.silentRatio,
+                      format_bytes(n.bytes).c_str(), params.c_str());
+        os << text;
+    }
+    os << "  connections:";
+    int perLine = 0;
+    for (const auto& e : s.edges)
+    {
+        os << (perLine++ % 8 == 0 ? "\n   " : "") << ' ' << e.from << (e.midi ? " ~> " : " -> ") << e.to;
+    }
+    os << "\n  (-> audio, ~> midi)\n";
+}
+
+// What PLAY prints instead of the whole graph
+inline void print_summary(std::ostream& os, juce::AudioProcessorGraph& graph)
+{
+    std::map<std::string, int> types;
+    int other = 0;
+    for (auto* node : graph.getNodes())
+    {
+        if (auto* info = node_info(node->getProcessor()))
+            ++types[info->typeName];
+        else
+            ++other;
+    }
+    int midi = 0;
+    const auto connections = graph.getConnections();
+    for (const auto& c : connections)
+        midi += c.source.channelIndex == juce::AudioProcessorGraph::midiChannelIndex;
+
+    os << "Graph: " << graph.getNumNodes() << " nodes (";
+    bool first = true;
+    for (const auto& [type, count] : types)
+    {
+        os << (first ? "" : ", ") << count << ' ' << type;
+        first = false;
+    }
+    os << (first ? "" : ", ") << other << " other), " << connections.size() - static_cast<std::size_t>(midi)
+       << " audio and " << midi << " MIDI connections; GRAPH for details\n";
+}
+
+} // namespace graph_export
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef INSTRUMENTED_H
+#define INSTRUMENTED_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "trace.h"
+#include "play_latency.h"
+#include "analyzer.h"
+#include "lazy_gates.h"
+#include "live_params.h"
+
+/* Every processor the LetterRegistry hands to the graph is wrapped in
+   Instrumented<Proc>. It still *is* a Proc (so the parser's dynamic_casts to
+   OscillatorBase etc. keep working) but also carries NodeInfo: which letter and
+   type it was created from, plus the hooks the engine uses to observe it, and
+   the LazyNode side that lets LazyGates leave it unprepared behind a closed
+   gate. */
+
+struct NodeInfo : LazyNode
+{
+    virtual ~NodeInfo() = default;
+
+    void set_identity(char letter_in, std::string_view type_in)
+    {
+        letter = letter_in;
+        typeName = std::string(type_in);
+        std::snprintf(traceName, sizeof(traceName), "%c:%s", letter, typeName.c_str());
+    }
+
+    // Bytes the processor itself keeps on the heap (delay lines, tables, ...)
+    virtual std::size_t heap_bytes() const = 0;
+
+    char letter = '?';
+    std::string typeName;
+    char traceName[32] {};
+    int word = -1;   // index of the score word this node was created for
+    int offset = -1; // and the character in that word
+    std::atomic<int> tap { -1 }; // Analyzer slot copying this node's output, if any
+    LiveParams live;             // letter parameters posted by MORPH
+    bool seeking = false;        // OfflineEngine::seek: keep time, skip the sound
+
+    // While costing() is on (GRAPH, for a measuring window): blocks this node
+    // ran, how many came out silent, and high-resolution ticks spent in
+    // processBlock. Off, it's one relaxed load per block.
+    struct Cost
+    {
+        std::atomic<std::uint64_t> blocks { 0 }, silent { 0 }, ticks { 0 };
+    };
+    Cost cost;
+
+    static std::atomic<bool>& costing()
+    {
+        static std::atomic<bool> on { false };
+        return on;
+    }
+
+    void reset_cost()
+    {
+        cost.blocks.store(0, std::memory_order_relaxed);
+        cost.silent.store(0, std::memory_order_relaxed);
+        cost.ticks.store(0, std::memory_order_relaxed);
+    }
+};
+
+static NodeInfo* node_info(juce::AudioProcessor* p)
+{
+    return dynamic_cast<NodeInfo*>(p);
+}
+
+template<typename Proc>
+class Instrumented final : public Proc, public NodeInfo
+{
+public:
+    using Proc::Proc;
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override
+    {
+        process(buffer, midi);
+    }
+
+    void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midi) override
+    {
+        process(buffer, midi);
+    }
+
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        if (is_lazy())
+            LazyGates::get().prepare(*this, sampleRate, samplesPerBlock);
+        else
+            Proc::prepareToPlay(sampleRate, samplesPerBlock);
+    }
+
+    void releaseResources() override
+    {
+        if (is_lazy())
+            LazyGates::get().release(*this);
+        else
+            Proc::releaseResources();
+    }
+
+    std::size_t heap_bytes() const override
+    {
+        if (!is_lazy())
+            return Proc::getHeapBytes();
+        const juce::ScopedLock sl(LazyGates::get().lock);
+        return Proc::getHeapBytes();
+    }
+
+    void prepare_processor() override { Proc::prepareToPlay(rate, blockSize); }
+    void release_processor() override { Proc::releaseResources(); }
+
+private:
+    template<typename Sample>
+    void process (juce::AudioBuffer<Sample>& buffer, juce::MidiBuffer& midi)
+    {
+        PlayLatency::get().node_processed();
+
+        if (seeking)
+        {
+            if constexpr (requires (Proc& p, juce::AudioBuffer<Sample>& b, juce::MidiBuffer& m) { p.seek_block(b, m); })
+                Proc::seek_block(buffer, midi);
+            else
+                buffer.clear(); // effects start again from silence after the seek
+            return;
+        }
+
+        const bool costing = NodeInfo::costing().load(std::memory_order_relaxed);
+
+        if (is_lazy() && !enter())
+        {
+            if (sleep_through(buffer, midi, Proc::getTotalNumInputChannels() > 0))
+                LazyGates::get().missed();
+            if (costing)
+                count_block(true, 0);
+        }
+        else
+        {
+            if constexpr (requires (Proc& p, const double* v) { p.set_live_params(v); })
+            {
+                double values[LiveParams::maxParams];
+                if (live.next(buffer.getNumSamples(), Proc::getSampleRate(), values))
+                    Proc::set_live_params(values);
+            }
+
+            auto& tracer = Tracer::get();
+            if (costing)
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+                Proc::processBlock(buffer, midi);
+                const auto ticks = juce::Time::getHighResolutionTicks() - start;
+                count_block(buffer.getNumSamples() == 0 || buffer.getMagnitude(0, buffer.getNumSamples()) < 1.0e-6f,
+                            static_cast<std::uint64_t>(juce::jmax<juce::int64>(0, ticks)));
+            }
+            else if (!tracer.isEnabled())
+            {
+                Proc::processBlock(buffer, midi);
+            }
+            else
+            {
+                const auto start = Tracer::nowUs();
+                Proc::processBlock(buffer, midi);
+                tracer.record("node", traceName, start, Tracer::nowUs());
+            }
+
+            if (is_lazy())
+                leave(buffer);
+        }
+
+        if (const int t = tap.load(std::memory_order_relaxed); t >= 0)
+            Analyzer::get().capture(t, buffer);
+    }
+
+    void count_block(bool silent, std::uint64_t ticks) noexcept
+    {
+        cost.blocks.fetch_add(1, std::memory_order_relaxed);
+        cost.silent.fetch_add(silent ? 1 : 0, std::memory_order_relaxed);
+        cost.ticks.fetch_add(ticks, std::memory_order_relaxed);
+    }
+};
+
+#endif
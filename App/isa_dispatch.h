@@ -0,0 +1,311 @@
+#ifndef ISA_DISPATCH_H
+#define ISA_DISPATCH_H
+
+#include <atomic>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Runtime CPU-feature dispatch for the DSP kernels this project owns. The
+   build targets the baseline ISA (x86-64: SSE2), so each kernel below is
+   compiled three times from the same body, with GCC/Clang target attributes
+   for baseline, AVX2 and AVX-512F, and the best one the CPU supports is picked
+   once at startup. `--isa generic|avx2|avx512` forces a lower level to
+   compare them; a calibration profile (calibration.h) may pick one too.
+
+   The bodies keep a fixed order of operations (independent accumulators
+   instead of one running sum, no FMA), so every variant produces the same
+   bits: golden renders don't depend on the machine they were recorded on.
+
+   Kernels:
+     polyphase   the multi-rate voices' interpolator (PolyphaseUpsampler)
+     to_float    double -> float, into the reverb's tank buffer
+     to_double   float -> double, back out of it
+     fold        channels summed and scaled into one float channel (the mono
+                 reverb tier)
+     resample    the fixed-rate engine's output stage (OutputResampler)
+
+   The filters, delay lines, reverb tank and the graph's own mixing are
+   JUCE's and stay on the baseline build.
+
+   So do the oscillators, and there is no oscillator kernel. Their sample
+   loop is juce::dsp::Oscillator calling the waveform (a std::function around
+   std::sin, a comparison or a harmonic sum of std::sin) once per sample, and
+   the noise voice draws from juce::Random's serial generator; neither has a
+   body the compiler could widen, so an AVX2 or AVX-512 copy would run the
+   same scalar code. A voice's cost is cut by rendering it at a lower rate
+   instead (multirate, through the polyphase kernel above). */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+ #define TEXTGRAPH_ISA_X86 1
+ #define TEXTGRAPH_TARGET(isa) __attribute__((target(isa)))
+#else
+ #define TEXTGRAPH_ISA_X86 0
+ #define TEXTGRAPH_TARGET(isa)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+ #define TEXTGRAPH_ALWAYS_INLINE [[gnu::always_inline]] inline
+#else
+ #define TEXTGRAPH_ALWAYS_INLINE inline
+#endif
+
+namespace isa
+{
+
+enum class Level { generic, avx2, avx512, count };
+
+inline const char* level_name(Level l)
+{
+    switch (l)
+    {
+        case Level::generic: return "generic";
+        case Level::avx2:    return "avx2";
+        case Level::avx512:  return "avx512";
+        case Level::count:   break;
+    }
+    return "?";
+}
+
+struct Kernels
+{
+    // Writes numIn * factor samples; returns the new history position
+    int (*polyphase)(const double* phases, int factor, int taps, double* history, int position,
+                     const double* in, int numIn, double* out) noexcept;
+    void (*to_float)(float* dst, const double* src, int n) noexcept;
+    void (*to_double)(double* dst, const float* src, int n) noexcept;
+    void (*fold)(float* dst, const double* const* src, int numChannels, int n) noexcept;
+    // n outputs at in-positions position + k * step; returns position + n * step
+    double (*resample)(const double* table, int phases, int taps, const double* in, double position, double step,
+                       double* out, int n) noexcept;
+    Level level;
+};
+
+namespace body
+{
+// taps is a multiple of lanes; each lane sums every lanes-th product, then the
+// lanes are added pairwise, the same way whatever the vector width
+constexpr int lanes = 8;
+
+TEXTGRAPH_ALWAYS_INLINE double sum_lanes(const double* acc) noexcept
+{
+    return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+TEXTGRAPH_ALWAYS_INLINE int polyphase(const double* phases, int factor, int taps, double* history, int position,
+                                      const double* in, int numIn, double* out) noexcept
+{
+    for (int k = 0; k < numIn; ++k)
+    {
+        position = (position == 0 ? taps : position) - 1;
+        history[position] = in[k];
+        history[position + taps] = in[k];
+
+        // x[0] is the newest input, x[j] the one j samples before it
+        const double* x = history + position;
+        for (int p = 0; p < factor; ++p)
+        {
+            const double* h = phases + p * taps;
+            double acc[lanes] = {};
+            for (int j = 0; j < taps; j += lanes)
+                for (int l = 0; l < lanes; ++l)
+                    acc[l] += h[j + l] * x[j + l];
+            *out++ = sum_lanes(acc);
+        }
+    }
+    return position;
+}
+
+TEXTGRAPH_ALWAYS_INLINE void to_float(float* dst, const double* src, int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = static_cast<float>(src[i]);
+}
+
+TEXTGRAPH_ALWAYS_INLINE void to_double(double* dst, const float* src, int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = static_cast<double>(src[i]);
+}
+
+TEXTGRAPH_ALWAYS_INLINE void fold(float* dst, const double* const* src, int numChannels, int n) noexcept
+{
+    const double scale = 1.0 / numChannels;
+    for (int i = 0; i < n; ++i)
+    {
+        double sum = 0.0;
+        for (int ch = 0; ch < numChannels; ++ch)
+            sum += src[ch][i];
+        dst[i] = static_cast<float>(sum * scale);
+    }
+}
+// table has phases + 1 rows of taps, row p for a position p / phases past an
+// input sample; the two rows either side are both applied and the results
+// interpolated. in[i - taps / 2 + 1] .. in[i + taps / 2] must be readable.
+TEXTGRAPH_ALWAYS_INLINE double resample(const double* table, int phases, int taps, const double* in, double position,
+                                        double step, double* out, int n) noexcept
+{
+    for (int k = 0; k < n; ++k)
+    {
+        const double t = position + k * step;
+        const int i = static_cast<int>(t);
+        const double f = (t - i) * phases;
+        const int p = static_cast<int>(f);
+        const double w = f - p;
+
+        const double* x = in + i - taps / 2 + 1;
+        const double* h0 = table + p * taps;
+        const double* h1 = h0 + taps;
+        double a[lanes] = {}, b[lanes] = {};
+        for (int j = 0; j < taps; j += lanes)
+            for (int l = 0; l < lanes; ++l)
+            {
+                a[l] += h0[j + l] * x[j + l];
+                b[l] += h1[j + l] * x[j + l];
+            }
+        const double y0 = sum_lanes(a), y1 = sum_lanes(b);
+        out[k] = y0 + w * (y1 - y0);
+    }
+    return position + n * step;
+}
+} // namespace body
+
+// One set of entry points per level, all from the bodies above
+#define TEXTGRAPH_ISA_VARIANT(ns, attribute, lvl)                                                             \
+    namespace ns                                                                                              \
+    {                                                                                                         \
+    attribute inline int polyphase(const double* phases, int factor, int taps, double* history, int position, \
+                                   const double* in, int numIn, double* out) noexcept                         \
+    {                                                                                                         \
+        return body::polyphase(phases, factor, taps, history, position, in, numIn, out);                      \
+    }                                                                                                         \
+    attribute inline void to_float(float* dst, const double* src, int n) noexcept { body::to_float(dst, src, n); } \
+    attribute inline void to_double(double* dst, const float* src, int n) noexcept { body::to_double(dst, src, n); } \
+    attribute inline void fold(float* dst, const double* const* src, int numChannels, int n) noexcept           \
+    {                                                                                                         \
+        body::fold(dst, src, numChannels, n);                                                                 \
+    }                                                                                                         \
+    attribute inline double resample(const double* table, int phases, int taps, const double* in,             \
+                                     double position, double step, double* out, int n) noexcept               \
+    {                                                                                                         \
+        return body::resample(table, phases, taps, in, position, step, out, n);                               \
+    }                                                                                                         \
+    inline constexpr Kernels kernels { polyphase, to_float, to_double, fold, resample, lvl };                  \
+    }
+
+TEXTGRAPH_ISA_VARIANT(generic, , Level::generic)
+#if TEXTGRAPH_ISA_X86
+TEXTGRAPH_ISA_VARIANT(avx2, TEXTGRAPH_TARGET("avx2"), Level::avx2)
+TEXTGRAPH_ISA_VARIANT(avx512, TEXTGRAPH_TARGET("avx512f"), Level::avx512)
+#endif
+
+#undef TEXTGRAPH_ISA_VARIANT
+
+// Highest level this CPU (and OS, for the wider registers) can run
+inline Level detect()
+{
+#if TEXTGRAPH_ISA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Level::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return Level::avx2;
+#endif
+    return Level::generic;
+}
+
+inline const Kernels& table(Level l)
+{
+#if TEXTGRAPH_ISA_X86
+    if (l == Level::avx512) return avx512::kernels;
+    if (l == Level::avx2)   return avx2::kernels;
+#endif
+    (void) l;
+    return generic::kernels;
+}
+
+// Who picked the level in use
+enum class Source { cpuid, argument, calibration };
+
+namespace detail
+{
+inline std::atomic<const Kernels*>& selected()
+{
+    static std::atomic<const Kernels*> k { &table(detect()) };
+    return k;
+}
+inline Source& source()
+{
+    static Source s = Source::cpuid;
+    return s;
+}
+} // namespace detail
+
+// What the processors call. Every level gives the same bits, so a switch
+// while audio runs (CALIBRATE) only changes the speed.
+inline const Kernels& kernels() noexcept { return *detail::selected().load(std::memory_order_relaxed); }
+
+inline Source source() { return detail::source(); }
+
+// Selects a level no higher than the CPU supports; false if it's higher
+inline bool select(Level l, Source from = Source::argument)
+{
+    if (l > detect())
+        return false;
+    detail::selected().store(&table(l), std::memory_order_relaxed);
+    detail::source() = from;
+    return true;
+}
+
+inline bool parse_level(const std::string& name, Level& l)
+{
+    for (int i = 0; i < static_cast<int>(Level::count); ++i)
+        if (name == level_name(static_cast<Level>(i)))
+        {
+            l = static_cast<Level>(i);
+            return true;
+        }
+    return false;
+}
+
+// Removes "--isa <level>" from args and applies it; false with a message on a bad value
+inline bool parse_argument(std::vector<char*>& args, std::ostream& err)
+{
+    for (std::size_t i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == nullptr || std::strcmp(args[i], "--isa") != 0)
+            continue;
+
+        const std::string name = i + 1 < args.size() && args[i + 1] != nullptr ? args[i + 1] : "";
+        if (name != "auto")
+        {
+            Level found = Level::generic;
+            if (!parse_level(name, found))
+            {
+                err << "--isa takes generic, avx2, avx512 or auto\n";
+                return false;
+            }
+            if (!select(found))
+            {
+                err << "--isa " << name << ": this CPU only supports up to " << level_name(detect()) << '\n';
+                return false;
+            }
+        }
+        args.erase(args.begin() + static_cast<std::ptrdiff_t>(i), args.begin() + static_cast<std::ptrdiff_t>(i + 2));
+        --i;
+    }
+    return true;
+}
+
+inline void print_report(std::ostream& os)
+{
+    const auto& k = kernels();
+    os << "DSP kernels:    " << level_name(k.level) << " (CPU supports " << level_name(detect())
+       << (source() == Source::argument ? ", set by --isa" : source() == Source::calibration ? ", from calibration" : ", chosen by CPUID")
+       << "): polyphase, to_float, to_double, fold, resample\n";
+}
+
+} // namespace isa
+
+#endif
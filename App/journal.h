@@ -0,0 +1,368 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "golden.h"
+#include "offline_render.h"
+#include "scenes.h"
+
+/* Command journal: every command the app processes, stamped with the
+   transport position (device samples played so far) it arrived at, so a
+   session can be re-run later exactly as it was typed or scripted.
+
+     JOURNAL <file>      start recording (or --journal <file> at startup)
+     JOURNAL OFF         stop
+
+   The file is binary and small: "TGJ1", the device sample rate (float64),
+   then one record per command: position (uint64, samples since the journal
+   started), length (uint32) and the line's bytes as typed. Each record is
+   flushed as it is written, so a session that ends in a crash keeps
+   everything up to the crash.
+
+   A journal starts with the state it needs at position 0: every scene (SET
+   lines and SCENE SAVE), every letter's binding and modulators as SET lines,
+   the quantum and multi-rate setting, and the score and PLAY if one is
+   playing. So it replays the same on any build, whatever that build's
+   compile-time random bindings are.
+
+     ConsoleAppMessageThread --replay <file> [--block 512] [--tail 2] [--out <file.f32>]
+
+   renders the journal on the OfflineEngine: up to each command's position,
+   then the command, then on. The noise seed is fixed and there is no device,
+   so the replay comes out the same every time and on any machine; it
+   reports how long each command took and the slowest block after it against
+   the block's real-time budget, which is where a reported glitch shows up.
+   Everything that changes the sound is replayed: SET, scores, PLAY, PAUSE,
+   QUANTUM, MULTIRATE, SCENE and MORPH. A journal that changes what the
+   offline engine can't reproduce (RATE, LAZY or QUALITY with an argument)
+   is refused, naming the command. Commands that only report (STATS, GRAPH,
+   ...) are listed and skipped. --out writes the audio in the --golden track
+   format. */
+
+class Journal
+{
+public:
+    static constexpr std::uint32_t magic = 0x314a4754u; // "TGJ1"
+
+    struct Entry
+    {
+        std::uint64_t position = 0;
+        std::string line;
+    };
+
+    struct Recording
+    {
+        double sampleRate = 0.0;
+        std::vector<Entry> entries;
+    };
+
+    static Journal& get()
+    {
+        static Journal j;
+        return j;
+    }
+
+    // ---- command thread ----
+
+    // Positions count from origin (the transport position now); the preamble
+    // is recorded at 0, before anything else
+    bool start(const std::filesystem::path& path_in, double sampleRate, std::uint64_t origin_in,
+               const std::vector<std::string>& preamble)
+    {
+        stop();
+        out.open(path_in, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+        out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        out.write(reinterpret_cast<const char*>(&sampleRate), sizeof(sampleRate));
+        out.flush();
+        path = path_in;
+        origin = 0;
+        for (const auto& line : preamble)
+            record(line, 0);
+        origin = origin_in;
+        recorded = 0;
+        return out.good();
+    }
+
+    void stop()
+    {
+        if (out.is_open())
+            out.close();
+    }
+
+    bool active() const { return out.is_open(); }
+
+    void record(std::string_view line, std::uint64_t position)
+    {
+        if (!out.is_open())
+            return;
+        position = position > origin ? position - origin : 0;
+        const auto length = static_cast<std::uint32_t>(line.size());
+        out.write(reinterpret_cast<const char*>(&position), sizeof(position));
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        out.flush();
+        ++recorded;
+    }
+
+    void print(std::ostream& os) const
+    {
+        if (active())
+            os << "Journal: recording to '" << path.string() << "', " << recorded << " commands so far\n";
+        else
+            os << "Journal: off (JOURNAL <file> to record)\n";
+    }
+
+    static std::optional<Recording> load(const std::filesystem::path& from)
+    {
+        std::ifstream in(from, std::ios::binary);
+        std::uint32_t header = 0;
+        Recording r;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header != magic
+            || !in.read(reinterpret_cast<char*>(&r.sampleRate), sizeof(r.sampleRate)))
+            return std::nullopt;
+
+        Entry e;
+        std::uint32_t length = 0;
+        while (in.read(reinterpret_cast<char*>(&e.position), sizeof(e.position))
+               && in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+        {
+            e.line.resize(length);
+            if (!in.read(e.line.data(), static_cast<std::streamsize>(length)))
+                break; // cut short mid-record: keep what came before
+            r.entries.push_back(e);
+        }
+        return r;
+    }
+
+private:
+    Journal() = default;
+
+    std::ofstream out;
+    std::filesystem::path path;
+    std::uint64_t origin = 0;
+    std::uint64_t recorded = 0;
+};
+
+namespace replay
+{
+
+struct Options
+{
+    std::string file;
+    int block = 512;
+    double tail = 2.0;  // seconds rendered after the last command
+    std::string out;
+};
+
+enum class Kind { renders, reports, unreplayable };
+
+inline Kind classify(const std::string& line)
+{
+    auto with_argument = [&](std::string_view command) {
+        return line.starts_with(command) && line.find_first_not_of(' ', command.size()) != std::string::npos;
+    };
+    if (with_argument("RATE") || with_argument("LAZY") || with_argument("QUALITY"))
+        return Kind::unreplayable;
+    for (std::string_view command : { "SET", "PLAY", "PAUSE", "QUANTUM", "MULTIRATE", "SCENE", "MORPH" })
+        if (line.starts_with(command))
+            return Kind::renders;
+    return line.find('"') != std::string::npos ? Kind::renders : Kind::reports;
+}
+
+// The OfflineEngine plus what the live app keeps around it: the quantum,
+// the multi-rate switch and the scenes
+struct Session
+{
+    explicit Session(OfflineEngine& engine_in) : engine(engine_in) {}
+
+    void apply(const std::string& line)
+    {
+        std::istringstream ss(line);
+        std::string cmd, arg, name;
+        ss >> cmd >> arg >> name;
+        std::string lower = arg;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (cmd == "QUANTUM") {
+            // A bad argument was refused live too, and left the quantum as it was
+            int samples = 0;
+            const auto parsed = std::from_chars(arg.data(), arg.data() + arg.size(), samples);
+            if (lower == "off" || (!arg.empty() && parsed.ec == std::errc {} && parsed.ptr == arg.data() + arg.size() && samples >= 0))
+                engine.settings.quantum = samples;
+        } else if (cmd == "MULTIRATE") {
+            OscillatorBase::set_multirate_enabled(lower != "off");
+        } else if (cmd == "SCENE") {
+            if (lower == "save" && !name.empty())
+                scenes.capture(name, engine.reg);
+            else if (lower == "drop" && !name.empty())
+                scenes.remove(name);
+        } else if (cmd == "MORPH") {
+            const double glide = name.empty() ? 0.0 : std::atof(name.c_str());
+            const double position = !arg.empty() && (std::isdigit(static_cast<unsigned char>(arg[0])) || arg[0] == '.')
+                                  ? std::atof(arg.c_str()) : scenes.index_of(arg);
+            if (scenes.size() > 0 && position >= 0.0)
+                scenes.morph(position, juce::jmax(0.0, glide), engine.reg, *engine.graph);
+        } else {
+            if (line.starts_with("PLAY"))
+                engine.parse.morph_highest = scenes.highest(&engine.reg);
+            engine.command(line);
+        }
+    }
+
+    OfflineEngine& engine;
+    SceneBank scenes;
+};
+
+inline int run(int argc, char* argv[])
+{
+    Options o;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if (arg == "--block")       o.block = std::atoi(next());
+        else if (arg == "--tail")   o.tail = std::atof(next());
+        else if (arg == "--out")    o.out = next();
+        else                        o.file = arg;
+    }
+    if (o.file.empty() || o.block <= 0 || o.tail < 0.0)
+    {
+        std::cerr << "usage: --replay <journal> [--block <n>] [--tail <s>] [--out <file.f32>]\n";
+        return 2;
+    }
+
+    auto recording = Journal::load(o.file);
+    if (!recording)
+    {
+        std::cerr << "Cannot read journal '" << o.file << "'\n";
+        return 2;
+    }
+
+    for (const auto& e : recording->entries)
+    {
+        if (classify(e.line) == Kind::unreplayable)
+        {
+            std::cerr << "Cannot replay '" << e.line << "' (at " << static_cast<double>(e.position) / recording->sampleRate
+                      << " s): the offline engine has no fixed-rate host, lazy gates or quality watchdog to change\n";
+            return 2;
+        }
+    }
+
+    RenderSettings settings;
+    settings.sampleRate = recording->sampleRate > 0.0 ? recording->sampleRate : settings.sampleRate;
+    settings.blockSize = o.block;
+    OfflineEngine engine(settings);
+    Session session(engine);
+
+    const auto end = static_cast<juce::int64>((recording->entries.empty() ? 0 : recording->entries.back().position)
+                                              + static_cast<std::uint64_t>(o.tail * settings.sampleRate));
+    // One block at a time; with --out each is appended to the file as it's rendered
+    juce::AudioBuffer<double> audio(2, o.block);
+    audio.clear();
+    std::optional<golden::TrackWriter> track;
+    if (!o.out.empty())
+    {
+        track.emplace(o.out, audio.getNumChannels(), end);
+        if (!track->append(audio, 0))
+        {
+            std::cerr << "Cannot write '" << o.out << "'\n";
+            return 1;
+        }
+    }
+    bool writeFailed = false;
+
+    const double budgetMs = 1000.0 * o.block / settings.sampleRate;
+    using clock = std::chrono::steady_clock;
+    char text[240];
+    std::snprintf(text, sizeof(text), "Replaying %d commands at %.0f Hz in %d-sample blocks (%.2f ms each)\n",
+                  static_cast<int>(recording->entries.size()), settings.sampleRate, o.block, budgetMs);
+    std::cout << text;
+
+    // Renders up to the given position, block by block, timing each
+    double slowestMs = 0.0;
+    int overBudget = 0;
+    auto render_to = [&](juce::int64 position) {
+        slowestMs = 0.0;
+        overBudget = 0;
+        while (engine.position() < position)
+        {
+            const int n = static_cast<int>(juce::jmin<juce::int64>(o.block, position - engine.position()));
+            const auto t0 = clock::now();
+            engine.render(audio, 0, n);
+            const double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+            slowestMs = juce::jmax(slowestMs, ms);
+            overBudget += ms > budgetMs * n / o.block;
+            if (track && !writeFailed)
+                writeFailed = !track->append(audio, n);
+        }
+    };
+
+    int skipped = 0;
+    for (std::size_t i = 0; i < recording->entries.size(); ++i)
+    {
+        const auto& e = recording->entries[i];
+        render_to(static_cast<juce::int64>(e.position));
+        if (i > 0)
+        {
+            std::snprintf(text, sizeof(text), "      then slowest block %.3f ms, %d over budget\n", slowestMs, overBudget);
+            std::cout << text;
+        }
+
+        const bool replayed = classify(e.line) == Kind::renders;
+        const auto t0 = clock::now();
+        if (replayed)
+            session.apply(e.line);
+        else
+            ++skipped;
+        const double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+        std::snprintf(text, sizeof(text), "%10.3f s  %-40.40s %s\n", static_cast<double>(e.position) / settings.sampleRate,
+                      e.line.c_str(), replayed ? "" : "(skipped)");
+        std::cout << text;
+        if (replayed)
+        {
+            std::snprintf(text, sizeof(text), "      command %.3f ms\n", ms);
+            std::cout << text;
+        }
+    }
+    render_to(end);
+    std::snprintf(text, sizeof(text), "      then slowest block %.3f ms, %d over budget\n", slowestMs, overBudget);
+    std::cout << text;
+    if (skipped > 0)
+        std::cout << skipped << " commands don't change the offline render and were skipped\n";
+
+    if (track)
+    {
+        if (!track->finish() || writeFailed)
+        {
+            std::cerr << "Cannot write '" << o.out << "'\n";
+            return 1;
+        }
+        std::cout << "Wrote " << end << " samples to '" << o.out << "'\n";
+    }
+    return 0;
+}
+
+} // namespace replay
+
+#endif
@@ -0,0 +1,401 @@
+#ifndef LAZY_GATES_H
+#define LAZY_GATES_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+#include "realtime_setup.h"
+
+/* Lazy activation of gated subtrees.
+
+   An oscillator inside a pulser's parentheses can only sound while that
+   pulser's note is on, and an effect fed only by such oscillators only then
+   and for its tail after. In a score like "b (x (af) v (sf))" most of those
+   nodes sit behind a closed gate most of the time, yet every one of them
+   would be prepared at PLAY and hold its buffers (two seconds of delay line
+   per channel for a delay) for as long as the score plays.
+
+   Each pulser publishes its schedule (GateSchedule): how many samples until
+   its next note-on by its own clock, with which velocity, and the gate above
+   it. That gives a lower bound on when any node behind it can next be asked
+   to make sound. A node the parser found gated (a LazyNode with wakers) is
+   asleep while that bound is further away than the wake horizon: the graph's
+   rebuild leaves it unprepared, and the audio thread hands its output on
+   silent without calling it. The lazy-gates thread prepares it once the
+   bound comes within the horizon, and releases it again (retires it) after
+   it has been silent for the retire time with no gate about to open.
+
+   The audio thread and the lazy-gates thread hand a node over with one
+   compare-and-swap on its state, so neither ever sees it half prepared. A
+   note-on (or, for an effect, signal) reaching an asleep node means the
+   look-ahead was late: the block stays silent, the node is woken at the
+   lazy-gates thread's next pass and the miss is counted in LAZY and STATS.
+
+   The thread polls every 20 ms while any node is registered and sleeps
+   without waking while none is, so a paused engine stays idle.
+
+   Only the live graph is lazy (Parser::lazy_gates); offline renders run
+   faster than real time and keep every node prepared. */
+
+// A pulser's gate timing, written by the pulser on the audio thread once per
+// block (and when prepared) and read by the lazy-gates thread
+class GateSchedule
+{
+public:
+    static constexpr long long never = std::numeric_limits<long long>::max();
+
+    // untilNextOn: samples from the end of the block to the next note-on by
+    // this pulser's own clock; openVelocity: the velocity of the note now on, 0 if off
+    void publish(long long untilNextOn, int nextVelocity, int openVelocity, long long cycle, int connections) noexcept
+    {
+        const auto s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fields.untilNextOn.store(untilNextOn, std::memory_order_relaxed);
+        fields.nextVelocity.store(nextVelocity, std::memory_order_relaxed);
+        fields.openVelocity.store(openVelocity, std::memory_order_relaxed);
+        fields.cycle.store(cycle, std::memory_order_relaxed);
+        fields.connections.store(connections, std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Set by the parser when this pulser sits inside another's parentheses;
+    // velocity 0 opens on any of the parent's notes
+    void set_parent(const GateSchedule* parent_in, int velocity) noexcept
+    {
+        // Gated from two places: only the pulser's own clock is a safe bound
+        if (parentSet && (parent_in != parent || velocity != parentVelocity))
+            parent_in = nullptr;
+        parent = parent_in;
+        parentVelocity = velocity;
+        parentSet = true;
+    }
+
+    // Lower bound in samples on when this gate next opens for a listener on
+    // the given velocity (0 = any): 0 if it's open now. A nested gate can't
+    // open before the one above it does.
+    long long until_open(int velocity) const noexcept
+    {
+        long long untilNextOn;
+        int nextVelocity, openVelocity, connections;
+        long long cycle;
+        for (;;)
+        {
+            const auto s = seq.load(std::memory_order_acquire);
+            if (s == 0)
+                return 0; // pulser not prepared yet: could open any time
+            untilNextOn = fields.untilNextOn.load(std::memory_order_relaxed);
+            nextVelocity = fields.nextVelocity.load(std::memory_order_relaxed);
+            openVelocity = fields.openVelocity.load(std::memory_order_relaxed);
+            cycle = fields.cycle.load(std::memory_order_relaxed);
+            connections = fields.connections.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((s & 1) == 0 && seq.load(std::memory_order_relaxed) == s)
+                break;
+        }
+
+        long long own = never;
+        if (openVelocity != 0 && (velocity == 0 || velocity == openVelocity))
+        {
+            own = 0;
+        }
+        else if (untilNextOn != never)
+        {
+            // Velocities take turns 1, 2, .., connections, one per cycle
+            const int turns = juce::jmax(1, connections);
+            int v = nextVelocity;
+            for (int k = 0; k < turns; ++k)
+            {
+                if (velocity == 0 || v == velocity)
+                {
+                    own = untilNextOn + k * cycle;
+                    break;
+                }
+                v = v % turns + 1;
+            }
+        }
+
+        if (own == never || parent == nullptr)
+            return own;
+        return std::max(own, parent->until_open(parentVelocity));
+    }
+
+private:
+    struct Fields
+    {
+        std::atomic<long long> untilNextOn { 0 };
+        std::atomic<int> nextVelocity { 1 };
+        std::atomic<int> openVelocity { 0 };
+        std::atomic<long long> cycle { 0 };
+        std::atomic<int> connections { 0 };
+    };
+
+    std::atomic<std::uint32_t> seq { 0 };
+    Fields fields;
+    const GateSchedule* parent = nullptr;
+    int parentVelocity = 0;
+    bool parentSet = false;
+};
+
+// The lazy side of a graph node. NodeInfo derives from this; the parser fills
+// in the wakers, and only nodes registered with LazyGates are ever asleep.
+struct LazyNode
+{
+    enum State { awake, processing, asleep, busy };
+
+    struct Waker
+    {
+        const GateSchedule* gate;
+        int velocity; // 0 = any note
+    };
+
+    virtual ~LazyNode() = default;
+
+    // Called with LazyGates' lock held, never while the audio thread is in the node
+    virtual void prepare_processor() = 0;
+    virtual void release_processor() = 0;
+
+    bool is_lazy() const noexcept { return lazy; }
+
+    // Lower bound in samples on when this node can next be asked to sound
+    long long until_needed() const noexcept
+    {
+        long long bound = GateSchedule::never;
+        for (const auto& w : wakers)
+            bound = std::min(bound, w.gate->until_open(w.velocity));
+        return bound;
+    }
+
+    // ---- audio thread ----
+
+    // True if the node may be processed this block; pair with leave()
+    bool enter() noexcept
+    {
+        int expected = awake;
+        return state.compare_exchange_strong(expected, processing, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    template<typename Sample>
+    void leave(const juce::AudioBuffer<Sample>& output) noexcept
+    {
+        const int n = output.getNumSamples();
+        silentFor.store(output.getMagnitude(0, n) < silenceThreshold ? silentFor.load(std::memory_order_relaxed) + n : 0,
+                        std::memory_order_relaxed);
+        state.store(awake, std::memory_order_release);
+    }
+
+    // The node is asleep (or being handed over): pass silence on. True the
+    // first time a block asks for sound, i.e. the look-ahead was late.
+    template<typename Sample>
+    bool sleep_through(juce::AudioBuffer<Sample>& buffer, const juce::MidiBuffer& midi, bool hasInput) noexcept
+    {
+        bool late = hasInput && buffer.getMagnitude(0, buffer.getNumSamples()) >= silenceThreshold;
+        for (const auto m : midi)
+        {
+            // Note-ons only; one for another velocity would be ignored anyway
+            if (m.numBytes >= 3 && (m.data[0] & 0xf0) == 0x90 && m.data[2] != 0)
+                for (const auto& w : wakers)
+                    late = late || w.velocity == 0 || w.velocity == m.data[2];
+        }
+        buffer.clear();
+        return late && !wanted.exchange(true, std::memory_order_relaxed);
+    }
+
+    static constexpr double silenceThreshold = 1.0e-8; // -160 dBFS, as SilenceSkip
+
+    std::vector<Waker> wakers;
+    bool fedUngated = false; // gets signal from something that's never asleep
+
+    bool lazy = false;
+    std::atomic<int> state { awake };
+    std::atomic<juce::int64> silentFor { 0 }; // samples of silent output in a row
+    std::atomic<bool> wanted { false };       // asked for sound while asleep
+    double rate = 0.0;
+    int blockSize = 0;
+};
+
+class LazyGates
+{
+public:
+    static LazyGates& get()
+    {
+        static LazyGates g;
+        return g;
+    }
+
+    // ---- command thread ----
+
+    // After the parser has set up the node's wakers, before the graph is rebuilt
+    void add(LazyNode& node)
+    {
+        if (node.wakers.empty() || node.fedUngated)
+            return;
+        const juce::ScopedLock sl(lock);
+        node.lazy = true;
+        node.state.store(LazyNode::asleep, std::memory_order_relaxed);
+        nodes.push_back(&node);
+        if (!worker.isThreadRunning())
+            worker.startThread();
+        else
+            worker.notify();
+    }
+
+    // Before the graph's nodes are deleted
+    void forget_all()
+    {
+        const juce::ScopedLock sl(lock);
+        nodes.clear();
+    }
+
+    // From the node's prepareToPlay: prepared now only if its gate is about to open
+    void prepare(LazyNode& node, double sampleRate, int samplesPerBlock)
+    {
+        const juce::ScopedLock sl(lock);
+        node.rate = sampleRate;
+        node.blockSize = samplesPerBlock;
+        const int s = node.state.load(std::memory_order_relaxed);
+        if (s == LazyNode::awake || node.until_needed() <= horizon_samples(node))
+        {
+            node.prepare_processor();
+            node.silentFor.store(0, std::memory_order_relaxed);
+            node.state.store(LazyNode::awake, std::memory_order_release);
+        }
+        else
+        {
+            deferred.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // From the node's releaseResources (the audio thread is out of the graph)
+    void release(LazyNode& node)
+    {
+        const juce::ScopedLock sl(lock);
+        if (node.state.load(std::memory_order_relaxed) == LazyNode::awake)
+        {
+            node.release_processor();
+            node.state.store(LazyNode::asleep, std::memory_order_release);
+        }
+    }
+
+    void set_retire_seconds(double seconds) { retireSeconds.store(juce::jmax(0.1, seconds), std::memory_order_relaxed); }
+    double get_retire_seconds() const { return retireSeconds.load(std::memory_order_relaxed); }
+
+    // ---- audio thread ----
+
+    void missed() noexcept { late.fetch_add(1, std::memory_order_relaxed); }
+
+    // ---- any thread ----
+
+    void print(std::ostream& os) const
+    {
+        int gated = 0, sleeping = 0;
+        {
+            const juce::ScopedLock sl(lock);
+            gated = static_cast<int>(nodes.size());
+            for (auto* node : nodes)
+                sleeping += node->state.load(std::memory_order_relaxed) >= LazyNode::asleep ? 1 : 0;
+        }
+        char text[256];
+        std::snprintf(text, sizeof(text),
+                      "Lazy gates:     %d gated nodes, %d asleep; %llu deferred at PLAY, %llu woken, %llu retired, "
+                      "%llu late (woken %.0f ms ahead, retired after %.1f s silent)\n",
+                      gated, sleeping,
+                      static_cast<unsigned long long>(deferred.load(std::memory_order_relaxed)),
+                      static_cast<unsigned long long>(woken.load(std::memory_order_relaxed)),
+                      static_cast<unsigned long long>(retired.load(std::memory_order_relaxed)),
+                      static_cast<unsigned long long>(late.load(std::memory_order_relaxed)),
+                      1000.0 * horizonSeconds, get_retire_seconds());
+        os << text;
+    }
+
+    juce::CriticalSection lock; // held while a node is prepared or released
+
+private:
+    // Covers the thread's poll interval, a device block and the time it
+    // takes to prepare a two-second delay line, with room to spare
+    static constexpr double horizonSeconds = 0.25;
+    static constexpr int pollMs = 20;
+
+    LazyGates() = default;
+    ~LazyGates() { worker.stopThread(1000); }
+
+    static long long horizon_samples(const LazyNode& node)
+    {
+        return static_cast<long long>(horizonSeconds * node.rate) + node.blockSize;
+    }
+
+    // ---- lazy-gates thread ----
+    bool idle() const
+    {
+        const juce::ScopedLock sl(lock);
+        return nodes.empty();
+    }
+
+    void poll()
+    {
+        const juce::ScopedLock sl(lock);
+        const double retireAfter = get_retire_seconds();
+        for (auto* node : nodes)
+        {
+            if (node->rate <= 0.0)
+                continue; // not prepared by the graph yet
+            const long long needed = node->until_needed();
+            const bool soon = needed <= horizon_samples(*node);
+
+            int expected = LazyNode::asleep;
+            if ((soon || node->wanted.load(std::memory_order_relaxed))
+                && node->state.compare_exchange_strong(expected, LazyNode::busy, std::memory_order_acquire))
+            {
+                node->prepare_processor();
+                node->silentFor.store(0, std::memory_order_relaxed);
+                node->wanted.store(false, std::memory_order_relaxed);
+                node->state.store(LazyNode::awake, std::memory_order_release);
+                woken.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            // Fails while the audio thread is in the node; the next pass tries again
+            expected = LazyNode::awake;
+            if (!soon && node->silentFor.load(std::memory_order_relaxed) >= static_cast<juce::int64>(retireAfter * node->rate)
+                && node->state.compare_exchange_strong(expected, LazyNode::busy, std::memory_order_acquire))
+            {
+                node->release_processor();
+                node->state.store(LazyNode::asleep, std::memory_order_release);
+                retired.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    struct Worker : juce::Thread
+    {
+        explicit Worker(LazyGates& g) : juce::Thread("Lazy gates"), owner(g) {}
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                RealtimeSetup::get().sync(RealtimeSetup::Role::worker);
+                owner.poll();
+                // Parked with nothing registered (PAUSE, or a score with no
+                // gates) until add() has a node for it
+                wait(owner.idle() ? -1 : pollMs);
+            }
+        }
+
+        LazyGates& owner;
+    };
+
+    std::vector<LazyNode*> nodes;
+    std::atomic<double> retireSeconds { 5.0 };
+    std::atomic<std::uint64_t> deferred { 0 }, woken { 0 }, retired { 0 }, late { 0 };
+    Worker worker { *this };
+};
+
+#endif
@@ -15,18 +15,23 @@
 #include <cctype>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "oscillators.h"
 #include "effects.h"
 #include "midi_pulse.h"
+#include "instrumented.h"
+#include "modulation.h"
 
 using Value = std::variant<int, double, std::string>;
 
-// Helper to make printing work with variants
-template<typename OStream>
-OStream& operator<<(OStream& os, const Value& v)
+// Helper to make printing work with variants. Deliberately not a template
+// over the stream type: that would outrank the standard overloads for any
+// class derived from std::ostream (string literals convert to Value).
+inline std::ostream& operator<<(std::ostream& os, const Value& v)
 {
     std::visit([&os](auto&& arg) { os << arg; }, v);
     return os;
@@ -113,12 +118,16 @@ class LetterRegistry
     struct BindingBase
     {
         virtual ~BindingBase() = default;
-        virtual std::unique_ptr<juce::AudioProcessor> create() const = 0;
+        virtual std::unique_ptr<juce::AudioProcessor> create(char letter) const = 0;
         virtual void set_params (const std::vector<Value>&) = 0;
         virtual void set_param (std::string_view, const Value&) = 0;
         virtual const std::type_info& type_info() const = 0;
         virtual std::string_view type_name() const = 0;
         virtual void print_params(std::ostream& os) const = 0;
+        virtual bool has_mod_target(std::string_view) const = 0;
+        virtual std::vector<std::string_view> param_names() const = 0;
+        virtual std::vector<double> param_values() const = 0;
+        virtual void set_param_values(const std::vector<double>&) = 0;
     };
     
     template<typename Proc>
@@ -133,9 +142,13 @@ class LetterRegistry
         explicit Binding (std::string_view name, Args&&... xs) 
             : params(std::forward<Args>(xs)...), typeName(name) {}
         
-        std::unique_ptr<juce::AudioProcessor> create() const override
+        std::unique_ptr<juce::AudioProcessor> create(char letter) const override
         {
-            return std::apply([](auto&&... xs){ return std::make_unique<Proc>(xs...); }, params);
+            auto proc = std::apply([](auto&&... xs){ return std::make_unique<Instrumented<Proc>>(xs...); }, params);
+            proc->set_identity(letter, typeName);
+            const auto values = param_values();
+            proc->live.init(values.data(), static_cast<int>(values.size()));
+            return proc;
         }
         
         void set_params (const std::vector<Value>& v) override
@@ -158,6 +171,30 @@ class LetterRegistry
         {
             print_params_impl(os, std::make_index_sequence<std::tuple_size_v<Tuple>>{});
         }
+
+        bool has_mod_target(std::string_view target) const override
+        {
+            if constexpr (std::is_base_of_v<Modulatable, Proc>)
+                return target == Proc::modulation_target;
+            else
+                return false;
+        }
+
+        std::vector<std::string_view> param_names() const override
+        {
+            return std::vector<std::string_view>(Desc::names.begin(), Desc::names.end());
+        }
+
+        std::vector<double> param_values() const override
+        {
+            return std::apply([](auto... xs) { return std::vector<double> { static_cast<double>(xs)... }; }, params);
+        }
+
+        // Integer parameters round to the nearest
+        void set_param_values(const std::vector<double>& v) override
+        {
+            set_values_impl(v, std::make_index_sequence<std::tuple_size_v<Tuple>>{});
+        }
         
     private:
         template<std::size_t... Is>
@@ -167,6 +204,21 @@ class LetterRegistry
                  << " (default: " << std::get<Is>(Desc::defaults) << ")\n"), ...);
         }
         
+        template<std::size_t... Is>
+        void set_values_impl(const std::vector<double>& v, std::index_sequence<Is...>)
+        {
+            ((Is < v.size() ? void(std::get<Is>(params) = round_to<std::tuple_element_t<Is, Tuple>>(v[Is])) : void()), ...);
+        }
+
+        template<typename T>
+        static T round_to(double x)
+        {
+            if constexpr (std::is_integral_v<T>)
+                return static_cast<T>(std::lround(x));
+            else
+                return static_cast<T>(x);
+        }
+
         template<std::size_t I>
         bool set_paramImpl (std::string_view key, const Value& val)
         {
@@ -188,13 +240,22 @@ public:
     {
         static_assert(std::is_base_of_v<juce::AudioProcessor, Proc>, "Proc must derive AudioProcessor");
         bindings[letter] = std::make_unique<Binding<Proc>>(typeName, std::forward<Args>(args)...);
+
+        // Modulators whose target the new type doesn't have go with the old one
+        if (auto m = mods.find(letter); m != mods.end())
+        {
+            auto& list = m->second;
+            list.erase(std::remove_if(list.begin(), list.end(),
+                                      [&](const ModSpec& spec) { return !bindings[letter]->has_mod_target(spec.target); }),
+                       list.end());
+        }
     }
     
     [[nodiscard]] std::unique_ptr<juce::AudioProcessor> initialize(char letter) const
     {
         auto it = bindings.find(letter);
         if (it == bindings.end()) throw std::runtime_error("initialize: unknown letter");
-        return it->second->create();
+        return it->second->create(letter);
     }
     
     template<typename... Args>
@@ -213,6 +274,63 @@ public:
         it->second->set_param(key, value);
     }
     
+    // LFO/envelope declarations, applied to every node created for the letter
+    void set_modulator(char letter, const ModSpec& spec)
+    {
+        auto it = bindings.find(letter);
+        if (it == bindings.end()) throw std::runtime_error("set_modulator: unknown letter");
+        if (!it->second->has_mod_target(spec.target))
+            throw std::runtime_error("'" + spec.target + "' can't be modulated on a " + std::string(it->second->type_name()));
+
+        auto& list = mods[letter];
+        remove_modulator(letter, spec.target, spec.kind);
+        list.push_back(spec);
+    }
+
+    void remove_modulator(char letter, std::string_view target, ModSpec::Kind kind)
+    {
+        auto& list = mods[letter];
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [&](const ModSpec& spec) { return spec.target == target && spec.kind == kind; }),
+                   list.end());
+    }
+
+    const std::vector<ModSpec>& modulators(char letter) const
+    {
+        static const std::vector<ModSpec> none;
+        auto it = mods.find(letter);
+        return it == mods.end() ? none : it->second;
+    }
+
+    std::string_view type_name(char letter) const
+    {
+        auto it = bindings.find(letter);
+        if (it == bindings.end()) throw std::runtime_error("type_name: unknown letter");
+        return it->second->type_name();
+    }
+
+    // Numeric parameters in ctor_descriptor order (scenes.h)
+    std::vector<std::string_view> param_names(char letter) const
+    {
+        auto it = bindings.find(letter);
+        if (it == bindings.end()) throw std::runtime_error("param_names: unknown letter");
+        return it->second->param_names();
+    }
+
+    std::vector<double> param_values(char letter) const
+    {
+        auto it = bindings.find(letter);
+        if (it == bindings.end()) throw std::runtime_error("param_values: unknown letter");
+        return it->second->param_values();
+    }
+
+    void set_param_values(char letter, const std::vector<double>& values)
+    {
+        auto it = bindings.find(letter);
+        if (it == bindings.end()) throw std::runtime_error("set_param_values: unknown letter");
+        it->second->set_param_values(values);
+    }
+
     const std::type_info& getType_info(char letter) const
     {
         auto it = bindings.find(letter);
@@ -221,15 +339,15 @@ public:
     }
     
     // Print all bindings
-    void printBindings() const
+    void printBindings(std::ostream& os = std::cout) const
     {
         if (bindings.empty()) {
-            std::cout << "No letters are currently bound.\n";
+            os << "No letters are currently bound.\n";
             return;
         }
         
-        std::cout << "Current letter bindings:\n";
-        std::cout << "------------------------\n";
+        os << "Current letter bindings:\n";
+        os << "------------------------\n";
         
         // Sort letters for consistent output
         std::vector<char> sortedLetters;
@@ -241,21 +359,21 @@ public:
         for (char letter : sortedLetters) {
             auto it = bindings.find(letter);
             if (it != bindings.end()) {
-                std::cout << "  '" << letter << "' -> " << it->second->type_name() << "\n";
+                os << "  '" << letter << "' -> " << it->second->type_name() << "\n";
             }
         }
-        std::cout << "------------------------\n";
+        os << "------------------------\n";
     }
     
-    void printBindingsDetailed() const
+    void printBindingsDetailed(std::ostream& os = std::cout) const
     {
         if (bindings.empty()) {
-            std::cout << "No letters are currently bound.\n";
+            os << "No letters are currently bound.\n";
             return;
         }
         
-        std::cout << "Current letter bindings with parameters:\n";
-        std::cout << "----------------------------------------\n";
+        os << "Current letter bindings with parameters:\n";
+        os << "----------------------------------------\n";
         
         // Sort letters for consistent output
         std::vector<char> sortedLetters;
@@ -267,14 +385,53 @@ public:
         for (char letter : sortedLetters) {
             auto it = bindings.find(letter);
             if (it != bindings.end()) {
-                std::cout << "Letter '" << letter << "': " << it->second->type_name() << "\n";
-                it->second->print_params(std::cout);
-                std::cout << "\n";
+                os << "Letter '" << letter << "': " << it->second->type_name() << "\n";
+                it->second->print_params(os);
+                for (auto& spec : modulators(letter)) {
+                    if (spec.kind == ModSpec::Kind::lfo)
+                        os << "    ~ lfo " << spec.target << ": " << spec.rate << " Hz " << ModSpec::shape_name(spec.shape)
+                           << ", depth " << spec.depth << "\n";
+                    else
+                        os << "    ~ env " << spec.target << ": attack " << spec.attack << " s, decay " << spec.decay
+                           << " s, depth " << spec.depth << "\n";
+                }
+                os << "\n";
             }
         }
-        std::cout << "----------------------------------------\n";
+        os << "----------------------------------------\n";
     }
     
+    // SET commands that rebuild every binding and modulator as it is now
+    // (the preamble of a journal)
+    std::vector<std::string> set_lines() const
+    {
+        std::vector<std::string> lines;
+        char number[32];
+        for (char letter : getBoundLetters()) {
+            const auto& binding = *bindings.at(letter);
+            std::string line = std::string("SET ") + letter + " " + std::string(binding.type_name());
+            const auto names = binding.param_names();
+            const auto values = binding.param_values();
+            for (std::size_t k = 0; k < names.size() && k < values.size(); ++k) {
+                std::snprintf(number, sizeof(number), "%.17g", values[k]);
+                line += " " + std::string(names[k]) + " " + number;
+            }
+            lines.push_back(std::move(line));
+
+            for (auto& spec : modulators(letter)) {
+                std::ostringstream mod;
+                mod.precision(17);
+                mod << "SET " << letter << (spec.kind == ModSpec::Kind::lfo ? " lfo " : " env ") << spec.target << ' ';
+                if (spec.kind == ModSpec::Kind::lfo)
+                    mod << spec.rate << ' ' << spec.depth << ' ' << ModSpec::shape_name(spec.shape);
+                else
+                    mod << spec.attack << ' ' << spec.decay << ' ' << spec.depth;
+                lines.push_back(mod.str());
+            }
+        }
+        return lines;
+    }
+
     // Get all bound letters
     std::vector<char> getBoundLetters() const
     {
@@ -292,6 +449,7 @@ public:
     
 private:
     std::unordered_map<char, std::unique_ptr<BindingBase>> bindings;
+    std::unordered_map<char, std::vector<ModSpec>> mods;
 };
 
 template<unsigned N>
@@ -521,6 +679,43 @@ inline Value parse_token(const std::string& tok)
     return Value(tok);
 }
 
+// SET <letter> lfo <target> <rate Hz> <depth> [shape]
+// SET <letter> env <target> <attack s> <decay s> <depth>
+// SET <letter> lfo|env <target> off
+inline void execute_mod_command(LetterRegistry& reg, char letter, const std::string& kind, std::istringstream& ss)
+{
+    ModSpec spec;
+    spec.kind = kind == "lfo" ? ModSpec::Kind::lfo : ModSpec::Kind::env;
+
+    std::string first;
+    ss >> spec.target >> first;
+    if (spec.target.empty() || first.empty())
+        throw std::runtime_error("incomplete " + kind + " declaration");
+
+    if (first == "off")
+    {
+        reg.remove_modulator(letter, spec.target, spec.kind);
+        return;
+    }
+
+    if (spec.kind == ModSpec::Kind::lfo)
+    {
+        spec.rate = std::stod(first);
+        if (!(ss >> spec.depth))
+            throw std::runtime_error("lfo needs a rate and a depth");
+        std::string shape;
+        if (ss >> shape && !ModSpec::parse_shape(shape, spec.shape))
+            throw std::runtime_error("unknown lfo shape '" + shape + "'");
+    }
+    else
+    {
+        spec.attack = std::stod(first);
+        if (!(ss >> spec.decay >> spec.depth))
+            throw std::runtime_error("env needs attack, decay and depth");
+    }
+    reg.set_modulator(letter, spec);
+}
+
 inline void execute_bind_command(LetterRegistry& reg, const std::string& line)
 {
     std::istringstream ss(line);
@@ -534,6 +729,12 @@ inline void execute_bind_command(LetterRegistry& reg, const std::string& line)
     std::string firstTok; ss >> firstTok;
     if (firstTok.empty())
         throw std::runtime_error("incomplete set command");
+
+    if (firstTok == "lfo" || firstTok == "env")
+    {
+        execute_mod_command(reg, letter, firstTok, ss);
+        return;
+    }
     
     bool treatAsType = TypeTable::is_known(firstTok) || !reg.is_bound(letter);
     
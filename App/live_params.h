@@ -0,0 +1,106 @@
+#ifndef LIVE_PARAMS_H
+#define LIVE_PARAMS_H
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/* A running node's letter parameters, changed without a rebuild (MORPH,
+   scenes.h).
+
+   The command thread posts a full set of target values (in the order of the
+   letter's ctor_descriptor) with a glide time; the audio thread picks the
+   post up at the start of the node's next block and, until the glide is
+   over, hands the processor the values interpolated to the end of each
+   block. That's the whole cost: one sequence-number load per block while
+   nothing changes, a few multiplies and the processor's own setters while
+   something does. A post made during a glide starts a new one from wherever
+   the values had got to.
+
+   Posts are published like GateSchedule's: a sequence number that is odd
+   while the command thread writes, so the audio thread never reads half a
+   post; if it catches one mid-write it picks it up a block later. */
+
+struct LiveParams
+{
+    static constexpr int maxParams = 5; // the reverb's
+
+    // ---- command thread ----
+
+    // What the node was created with, before it's in the graph
+    void init(const double* values, int count) noexcept
+    {
+        n = std::min(count, maxParams);
+        std::copy(values, values + n, current.begin());
+        std::copy(values, values + n, target.begin());
+    }
+
+    void post(const double* values, double glideSeconds) noexcept
+    {
+        const auto s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < n; ++i)
+            posted[static_cast<std::size_t>(i)].store(values[i], std::memory_order_relaxed);
+        postedGlide.store(glideSeconds, std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    int size() const noexcept { return n; }
+
+    // ---- audio thread ----
+
+    // True if the processor should take new values (written to out) this block
+    bool next(int numSamples, double sampleRate, double* out) noexcept
+    {
+        const auto s = seq.load(std::memory_order_acquire);
+        if (s != seen && (s & 1) == 0)
+        {
+            std::array<double, maxParams> incoming {};
+            for (int i = 0; i < n; ++i)
+                incoming[static_cast<std::size_t>(i)] = posted[static_cast<std::size_t>(i)].load(std::memory_order_relaxed);
+            const double glide = postedGlide.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s)
+            {
+                seen = s;
+                start = current;
+                target = incoming;
+                rampTotal = std::max<std::int64_t>(1, static_cast<std::int64_t>(glide * sampleRate));
+                rampDone = 0;
+                gliding = true;
+            }
+        }
+
+        if (!gliding)
+            return false;
+
+        rampDone = std::min(rampTotal, rampDone + numSamples);
+        const double t = static_cast<double>(rampDone) / static_cast<double>(rampTotal);
+        for (int i = 0; i < n; ++i)
+        {
+            const auto k = static_cast<std::size_t>(i);
+            current[k] = start[k] + (target[k] - start[k]) * t;
+            out[i] = current[k];
+        }
+        gliding = rampDone < rampTotal;
+        return true;
+    }
+
+private:
+    int n = 0;
+
+    std::atomic<std::uint32_t> seq { 0 };
+    std::array<std::atomic<double>, maxParams> posted {};
+    std::atomic<double> postedGlide { 0.0 };
+
+    // Audio thread only, once the node is in the graph
+    std::uint32_t seen = 0;
+    std::array<double, maxParams> current {}, start {}, target {};
+    std::int64_t rampTotal = 1, rampDone = 0;
+    bool gliding = false;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef LOAD_TEST_H
+#define LOAD_TEST_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine_stats.h"
+#include "golden.h"
+#include "play_latency.h"
+
+/* --load-test: the live engine (player, EngineCallback, graph, the same
+   InputProcessor as the console) on a null audio device that calls back in
+   real time, while commands arrive the way they do in a busy session:
+
+     ConsoleAppMessageThread --load-test [--seconds 30] [--rate 48000] [--block 256]
+                                         [--plays 2] [--sets 40] [--toggles 1] [--spread] [--seed 1]
+
+   Every second brings --plays PLAYs of generated scores (the --golden
+   corpus: every oscillator type, nested pulsers, filter, reverb, delay),
+   --sets SETs to the letters those scores use, and --toggles PLAYs of the
+   current score with one word dropped or put back. By default a second's
+   commands arrive together at a random moment in it (a burst); --spread
+   spaces them out evenly instead.
+
+   The report has the callbacks that finished after their deadline (the
+   null device's xruns: a real device would have played a gap), the engine's
+   own count of callbacks over budget, rebuild times, and how long each kind
+   of command took to be handled, as percentiles. */
+
+// Calls its callback every block on a thread of its own, on a fixed
+// timeline like a sound card's clock. A callback that ends after the next
+// one was due is an xrun; the timeline then restarts from there.
+class NullAudioDevice : public juce::AudioIODevice, private juce::Thread
+{
+public:
+    NullAudioDevice(double rate_in, int block_in)
+        : juce::AudioIODevice("Null", "Null"), juce::Thread("Null device"), rate(rate_in), block(block_in)
+    {
+        buffer.setSize(2, block);
+    }
+
+    ~NullAudioDevice() override { close(); }
+
+    juce::StringArray getOutputChannelNames() override { juce::StringArray names; names.add("Left"); names.add("Right"); return names; }
+    juce::StringArray getInputChannelNames() override { return {}; }
+    juce::Array<double> getAvailableSampleRates() override { return { rate }; }
+    juce::Array<int> getAvailableBufferSizes() override { return { block }; }
+    int getDefaultBufferSize() override { return block; }
+
+    juce::String open(const juce::BigInteger&, const juce::BigInteger&, double, int) override
+    {
+        opened = true;
+        return {};
+    }
+
+    void close() override
+    {
+        stop();
+        opened = false;
+    }
+
+    bool isOpen() override { return opened; }
+
+    void start(juce::AudioIODeviceCallback* callback_in) override
+    {
+        if (callback_in == nullptr || isThreadRunning())
+            return;
+        callback = callback_in;
+        callback->audioDeviceAboutToStart(this);
+        startThread();
+    }
+
+    void stop() override
+    {
+        if (!isThreadRunning())
+            return;
+        stopThread(2000);
+        callback->audioDeviceStopped();
+        callback = nullptr;
+    }
+
+    bool isPlaying() override { return isThreadRunning(); }
+    juce::String getLastError() override { return {}; }
+    int getCurrentBufferSizeSamples() override { return block; }
+    double getCurrentSampleRate() override { return rate; }
+    int getCurrentBitDepth() override { return 32; }
+    juce::BigInteger getActiveOutputChannels() const override { juce::BigInteger b; b.setRange(0, 2, true); return b; }
+    juce::BigInteger getActiveInputChannels() const override { return {}; }
+    int getOutputLatencyInSamples() override { return 0; }
+    int getInputLatencyInSamples() override { return 0; }
+    int getXRunCount() const noexcept override { return static_cast<int>(xruns.load(std::memory_order_relaxed)); }
+
+    std::uint64_t callbacks() const { return count.load(std::memory_order_relaxed); }
+    double worst_late_ms() const { return worstLateMs.load(std::memory_order_relaxed); }
+
+private:
+    void run() override
+    {
+        using clock = std::chrono::steady_clock;
+        const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(block / rate));
+        auto due = clock::now();
+        juce::AudioIODeviceCallbackContext context;
+
+        while (!threadShouldExit())
+        {
+            callback->audioDeviceIOCallbackWithContext(nullptr, 0, buffer.getArrayOfWritePointers(), 2, block, context);
+            count.fetch_add(1, std::memory_order_relaxed);
+
+            due += period;
+            const auto now = clock::now();
+            if (now > due)
+            {
+                xruns.fetch_add(1, std::memory_order_relaxed);
+                const double late = std::chrono::duration<double, std::milli>(now - due).count();
+                if (late > worstLateMs.load(std::memory_order_relaxed))
+                    worstLateMs.store(late, std::memory_order_relaxed);
+                due = now;
+            }
+            else
+            {
+                std::this_thread::sleep_until(due);
+            }
+        }
+    }
+
+    const double rate;
+    const int block;
+    bool opened = false;
+    juce::AudioIODeviceCallback* callback = nullptr;
+    juce::AudioBuffer<float> buffer;
+    std::atomic<std::uint64_t> count { 0 }, xruns { 0 };
+    std::atomic<double> worstLateMs { 0.0 };
+};
+
+namespace load_test
+{
+
+struct Options
+{
+    double seconds = 30.0;
+    double rate = 48000.0;
+    int block = 256;
+    int plays = 2;    // per second
+    int sets = 40;
+    int toggles = 1;
+    bool spread = false;
+    int seed = 1;
+};
+
+inline std::optional<Options> parse_options(int argc, char* argv[])
+{
+    Options o;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "-1"; };
+        if (arg == "--seconds")       o.seconds = std::atof(next());
+        else if (arg == "--rate")     o.rate = std::atof(next());
+        else if (arg == "--block")    o.block = std::atoi(next());
+        else if (arg == "--plays")    o.plays = std::atoi(next());
+        else if (arg == "--sets")     o.sets = std::atoi(next());
+        else if (arg == "--toggles")  o.toggles = std::atoi(next());
+        else if (arg == "--spread")   o.spread = true;
+        else if (arg == "--seed")     o.seed = std::atoi(next());
+        else                          return std::nullopt;
+    }
+    if (o.seconds <= 0.0 || o.rate < 8000.0 || o.block <= 0 || o.plays < 0 || o.sets < 0 || o.toggles < 0)
+        return std::nullopt;
+    return o;
+}
+
+struct Command
+{
+    std::string kind; // what the latency is reported under
+    std::string line;
+};
+
+// The commands of each second, generated from a seed so runs compare
+class Traffic
+{
+public:
+    explicit Traffic(const Options& o_in) : o(o_in), rng(o_in.seed) {}
+
+    std::vector<Command> next_second()
+    {
+        std::vector<Command> commands;
+        for (int i = 0; i < o.plays; ++i)
+        {
+            const auto score = golden::generate_score(rng.nextInt(64));
+            for (auto& line : score.lines)
+            {
+                if (line.starts_with("\""))
+                    set_words(line);
+                commands.push_back({ line.starts_with("SET") ? "SET" : line.starts_with("PLAY") ? "PLAY" : "score", line });
+            }
+        }
+        for (int i = 0; i < o.sets; ++i)
+            commands.push_back({ "SET", random_set() });
+        for (int i = 0; i < o.toggles && !words.empty(); ++i)
+        {
+            const auto w = static_cast<std::size_t>(rng.nextInt(static_cast<int>(words.size())));
+            muted[w] = !muted[w];
+            commands.push_back({ "score", score_line() });
+            commands.push_back({ "PLAY (toggle)", "PLAY" });
+        }
+
+        // A PLAY storm ends on a PLAY even with no toggles, so the SETs count
+        if (o.plays == 0 && o.toggles == 0 && o.sets > 0)
+            commands.push_back({ "PLAY", "PLAY" });
+        return commands;
+    }
+
+    juce::Random& random() { return rng; }
+
+private:
+    void set_words(const std::string& line)
+    {
+        words.clear();
+        const auto text = line.substr(1, line.find('"', 1) - 1);
+        std::size_t start = 0;
+        while (start < text.size())
+        {
+            const auto end = text.find(' ', start);
+            words.push_back(text.substr(start, end - start));
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+        muted.assign(words.size(), false);
+    }
+
+    std::string score_line() const
+    {
+        std::string text;
+        for (std::size_t w = 0; w < words.size(); ++w)
+            if (!muted[w])
+                text += (text.empty() ? "" : " ") + words[w];
+        return "\"" + text + "\"";
+    }
+
+    // The corpus scores' letters, with new values
+    std::string random_set()
+    {
+        static const char* oscTypes[] = { "sin", "square", "saw", "triangle" };
+        switch (rng.nextInt(3))
+        {
+            case 0:
+                return std::string("SET ") + "abcde"[rng.nextInt(5)] + " " + oscTypes[rng.nextInt(4)]
+                     + " note " + std::to_string(36 + rng.nextInt(48));
+            case 1:
+                return std::string("SET ") + "mnp"[rng.nextInt(3)] + " midi bpm " + std::to_string(60 + rng.nextInt(240))
+                     + " on " + std::to_string(1 + rng.nextInt(4)) + " off " + std::to_string(rng.nextInt(4));
+            default:
+                return "SET f filter cutoff " + std::to_string(300 + rng.nextInt(5000));
+        }
+    }
+
+    const Options& o;
+    juce::Random rng;
+    std::vector<std::string> words;
+    std::vector<bool> muted;
+};
+
+inline double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    const auto i = static_cast<std::size_t>(p / 100.0 * static_cast<double>(values.size() - 1) + 0.5);
+    return values[std::min(i, values.size() - 1)];
+}
+
+struct Results
+{
+    std::map<std::string, std::vector<double>> latencyMs; // by command kind
+    std::vector<double> rebuildMs;
+
+    void print(std::ostream& os, const Options& o, const NullAudioDevice& device,
+               std::uint64_t engineMisses, double peakLoad) const
+    {
+        char text[200];
+        std::snprintf(text, sizeof(text), "Load test: %.0f s at %.0f Hz, %d-sample blocks (%.2f ms), %s commands\n",
+                      o.seconds, o.rate, o.block, 1000.0 * o.block / o.rate, o.spread ? "spread-out" : "burst");
+        os << text;
+        std::snprintf(text, sizeof(text), "  callbacks %llu, xruns %d (worst %.2f ms late), over budget %llu, peak load %.2f\n",
+                      static_cast<unsigned long long>(device.callbacks()), device.getXRunCount(), device.worst_late_ms(),
+                      static_cast<unsigned long long>(engineMisses), peakLoad);
+        os << text;
+
+        auto row = [&](const std::string& name, const std::vector<double>& v) {
+            std::snprintf(text, sizeof(text), "  %-14s %6d  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n",
+                          name.c_str(), static_cast<int>(v.size()), percentile(v, 50), percentile(v, 90),
+                          percentile(v, 99), v.empty() ? 0.0 : *std::max_element(v.begin(), v.end()));
+            os << text;
+        };
+        os << "  command latency (received to handled):\n";
+        for (const auto& [kind, v] : latencyMs)
+            row(kind, v);
+        os << "  graph rebuilds:\n";
+        row("rebuild", rebuildMs);
+    }
+};
+
+} // namespace load_test
+
+#endif
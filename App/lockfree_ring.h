@@ -0,0 +1,113 @@
+#ifndef LOCKFREE_RING_H
+#define LOCKFREE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/* Bounded lock-free queue of fixed capacity (Dmitry Vyukov's sequence-number
+   ring). Any number of threads may push and pop; all storage is allocated in
+   the constructor, so try_push/try_pop never allocate, lock, or block and are
+   safe to call from the audio thread. A full ring makes try_push return false:
+   callers are expected to drop the item and count it rather than wait. */
+
+template<typename T, std::size_t Capacity>
+class LockFreeRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "LockFreeRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "LockFreeRing items are copied by value and must be trivially copyable");
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+public:
+    LockFreeRing() : slots(new Slot[Capacity])
+    {
+        for (std::size_t i = 0; i < Capacity; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool try_push(const T& item) noexcept
+    {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[pos & mask];
+            const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.value = item;
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& out) noexcept
+    {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[pos & mask];
+            const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    out = slot.value;
+                    slot.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only a hint when other threads are pushing or popping concurrently.
+    std::size_t size_approx() const noexcept
+    {
+        const auto t = tail.load(std::memory_order_relaxed);
+        const auto h = head.load(std::memory_order_relaxed);
+        return t >= h ? t - h : 0;
+    }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+private:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<std::size_t> head { 0 };
+    alignas(64) std::atomic<std::size_t> tail { 0 };
+};
+
+#endif
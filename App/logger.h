@@ -0,0 +1,279 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include "lockfree_ring.h"
+#include "trace.h"
+#include "realtime_setup.h"
+
+/* Asynchronous console logger. Producers copy preformatted text into a
+   preallocated lock-free ring and return; a background thread does the actual
+   writes to stdout/stderr (and, with LOG <file>, a JSON-lines copy). A blocked
+   terminal therefore stalls only the writer, never the thread mutating the
+   graph. When the ring is full a record is dropped, counted and reported
+   later rather than waited for.
+
+   Two ways in:
+     log_out() / log_err()   thread-local std::ostreams for ordinary code; each
+                             line (or flush) becomes one record
+     Log::get().printf(...)  fixed-buffer formatting, no allocation: the one
+                             to use from the audio thread */
+
+class Log
+{
+public:
+    enum class Level : std::uint8_t { info, warning, error };
+
+    struct Record
+    {
+        static constexpr std::size_t maxText = 240;
+
+        std::int64_t timeUs;
+        const char* thread; // Tracer thread name, a literal or nullptr
+        Level level;
+        std::uint8_t length;
+        char text[maxText];
+    };
+
+    static Log& get()
+    {
+        static Log l;
+        return l;
+    }
+
+    // Never blocks; text longer than a record is split over several
+    void write(Level level, const char* text, std::size_t length, bool wake = true) noexcept
+    {
+        do
+        {
+            const auto chunk = std::min(length, Record::maxText);
+            Record r;
+            r.timeUs = Tracer::nowUs();
+            r.thread = Tracer::threadName();
+            r.level = level;
+            r.length = static_cast<std::uint8_t>(chunk);
+            std::memcpy(r.text, text, chunk);
+
+            if (!ring.try_push(r))
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            text += chunk;
+            length -= chunk;
+        } while (length > 0);
+
+        // Waking the writer takes a lock, so real-time callers leave it to the poll
+        if (wake)
+            writer.notify();
+    }
+
+    // Safe on the audio thread: formats into the record itself and doesn't wake the writer
+#if defined(__GNUC__)
+    [[gnu::format(printf, 3, 4)]]
+#endif
+    void printf(Level level, const char* format, ...) noexcept
+    {
+        char text[Record::maxText];
+        va_list args;
+        va_start(args, format);
+        const int n = std::vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        if (n > 0)
+            write(level, text, std::min(static_cast<std::size_t>(n), sizeof(text) - 1), false);
+    }
+
+    // Everything accepted so far is written out before this returns
+    void flush()
+    {
+        const juce::ScopedLock sl(drainLock);
+        drain();
+    }
+
+    bool open_file(const std::string& path)
+    {
+        const juce::ScopedLock sl(drainLock);
+        file.close();
+        file.open(path, std::ios::out | std::ios::app);
+        return file.is_open();
+    }
+
+    void close_file()
+    {
+        const juce::ScopedLock sl(drainLock);
+        file.close();
+    }
+
+    std::uint64_t getDroppedCount() const noexcept { return totalDropped.load(std::memory_order_relaxed); }
+
+    // While the engine is idle nothing real-time is logging, so the writer only
+    // wakes for command-thread output (which notifies it) and a slow poll
+    void set_idle(bool idle) noexcept
+    {
+        pollMs.store(idle ? idlePollMs : busyPollMs, std::memory_order_relaxed);
+    }
+
+private:
+    static const char* level_name(Level level)
+    {
+        switch (level)
+        {
+            case Level::info:    return "info";
+            case Level::warning: return "warning";
+            case Level::error:   return "error";
+        }
+        return "?";
+    }
+
+    void drain()
+    {
+        bool wroteOut = false, wroteErr = false;
+        Record r;
+        while (ring.try_pop(r))
+        {
+            auto* stream = r.level == Level::info ? stdout : stderr;
+            std::fwrite(r.text, 1, r.length, stream);
+            (r.level == Level::info ? wroteOut : wroteErr) = true;
+
+            if (file.is_open())
+                write_json(r);
+        }
+
+        if (auto n = dropped.exchange(0, std::memory_order_relaxed))
+        {
+            totalDropped.fetch_add(n, std::memory_order_relaxed);
+            std::fprintf(stderr, "[log] %llu messages dropped (output could not keep up)\n",
+                         static_cast<unsigned long long>(n));
+            wroteErr = true;
+        }
+
+        if (wroteOut) std::fflush(stdout);
+        if (wroteErr) std::fflush(stderr);
+        if (file.is_open()) file.flush();
+    }
+
+    void write_json(const Record& r)
+    {
+        file << "{\"ts_us\":" << r.timeUs << ",\"level\":\"" << level_name(r.level) << "\",\"thread\":\""
+             << (r.thread != nullptr ? r.thread : "") << "\",\"msg\":\"";
+        for (std::size_t i = 0; i < r.length; ++i)
+        {
+            const char c = r.text[i];
+            if (c == '"' || c == '\\')
+                file << '\\' << c;
+            else if (c == '\n')
+                file << "\\n";
+            else if (static_cast<unsigned char>(c) >= 0x20)
+                file << c;
+        }
+        file << "\"}\n";
+    }
+
+    struct Writer : juce::Thread
+    {
+        explicit Writer(Log& l) : juce::Thread("Log writer"), owner(l) {}
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                RealtimeSetup::get().sync(RealtimeSetup::Role::worker);
+                owner.flush();
+                wait(owner.pollMs.load(std::memory_order_relaxed));
+            }
+        }
+
+        Log& owner;
+    };
+
+    Log() { writer.startThread(); }
+
+    ~Log()
+    {
+        writer.stopThread(1000);
+        flush();
+    }
+
+    static constexpr int busyPollMs = 10;
+    static constexpr int idlePollMs = 500;
+
+    LockFreeRing<Record, 2048> ring;
+    std::atomic<int> pollMs { busyPollMs };
+    std::atomic<std::uint64_t> dropped { 0 };
+    std::atomic<std::uint64_t> totalDropped { 0 };
+    juce::CriticalSection drainLock;
+    std::ofstream file;
+    Writer writer { *this };
+};
+
+// std::ostream front end: buffers a line, hands it to the Log on '\n' or flush
+class LogStream : public std::ostream
+{
+public:
+    explicit LogStream(Log::Level level) : std::ostream(nullptr), buffer(level) { rdbuf(&buffer); }
+    ~LogStream() override { buffer.pubsync(); }
+
+private:
+    class LineBuffer : public std::streambuf
+    {
+    public:
+        explicit LineBuffer(Log::Level level_in) : level(level_in) {}
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (traits_type::eq_int_type(c, traits_type::eof()))
+                return traits_type::not_eof(c);
+            pending.push_back(traits_type::to_char_type(c));
+            if (c == '\n')
+                sync();
+            return c;
+        }
+
+        std::streamsize xsputn(const char* s, std::streamsize n) override
+        {
+            for (std::streamsize i = 0; i < n; ++i)
+                overflow(traits_type::to_int_type(s[i]));
+            return n;
+        }
+
+        int sync() override
+        {
+            if (!pending.empty())
+            {
+                Log::get().write(level, pending.data(), pending.size());
+                pending.clear();
+            }
+            return 0;
+        }
+
+    private:
+        Log::Level level;
+        std::string pending;
+    };
+
+    LineBuffer buffer;
+};
+
+// Per-thread streams, so lines from different threads never interleave mid-line
+inline LogStream& log_out()
+{
+    thread_local LogStream s(Log::Level::info);
+    return s;
+}
+
+inline LogStream& log_err()
+{
+    thread_local LogStream s(Log::Level::error);
+    return s;
+}
+
+#endif
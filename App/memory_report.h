@@ -0,0 +1,129 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "instrumented.h"
+
+/* MEM command: where the graph's memory goes, per letter, per type and per
+   score word.
+
+   Processor figures come from each processor's getHeapBytes(). The graph's own
+   overhead is estimated, since AudioProcessorGraph doesn't expose its render
+   buffers: one block-sized buffer per output channel of every node, plus a
+   preallocated MidiBuffer for every node that handles MIDI. */
+
+struct MemoryUsage
+{
+    std::size_t processor = 0;
+    std::size_t graph = 0;
+    int nodes = 0;
+
+    std::size_t total() const { return processor + graph; }
+
+    MemoryUsage& operator+=(const MemoryUsage& other)
+    {
+        processor += other.processor;
+        graph += other.graph;
+        nodes += other.nodes;
+        return *this;
+    }
+};
+
+// JUCE grows MIDI buffers on demand; this is what a busy pulser settles at
+static constexpr std::size_t estimatedMidiBufferBytes = 2048;
+
+static MemoryUsage graph_overhead(juce::AudioProcessor& proc)
+{
+    MemoryUsage usage;
+    const auto sampleBytes = proc.isUsingDoublePrecision() ? sizeof(double) : sizeof(float);
+    usage.graph = static_cast<std::size_t>(juce::jmax(0, proc.getTotalNumOutputChannels()))
+                * static_cast<std::size_t>(juce::jmax(0, proc.getBlockSize())) * sampleBytes;
+    if (proc.acceptsMidi() || proc.producesMidi())
+        usage.graph += estimatedMidiBufferBytes;
+    return usage;
+}
+
+static std::string format_bytes(std::size_t bytes)
+{
+    char text[32];
+    if (bytes >= 1024 * 1024)
+        std::snprintf(text, sizeof(text), "%.2f MiB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    else if (bytes >= 1024)
+        std::snprintf(text, sizeof(text), "%.1f KiB", static_cast<double>(bytes) / 1024.0);
+    else
+        std::snprintf(text, sizeof(text), "%zu B", bytes);
+    return text;
+}
+
+static void print_memory_report(std::shared_ptr<juce::AudioProcessorGraph> graph,
+                                std::vector<std::string> const &words,
+                                std::ostream& os)
+{
+    std::map<char, MemoryUsage> per_letter;
+    std::map<std::string, MemoryUsage> per_type;
+    std::map<int, MemoryUsage> per_word;
+    MemoryUsage other; // the output node and anything not created from a letter
+    MemoryUsage total;
+
+    for (auto* node : graph->getNodes())
+    {
+        auto* proc = node->getProcessor();
+        auto usage = graph_overhead(*proc);
+        usage.nodes = 1;
+
+        if (auto* info = node_info(proc))
+        {
+            usage.processor = info->heap_bytes();
+            per_letter[info->letter] += usage;
+            per_type[info->typeName] += usage;
+            per_word[info->word] += usage;
+        }
+        else
+        {
+            other += usage;
+        }
+        total += usage;
+    }
+
+    auto row = [&os](std::string const &label, MemoryUsage const &u) {
+        char text[160];
+        std::snprintf(text, sizeof(text), "  %-28s %3d node%s  %12s  (processors %s, graph buffers %s)\n",
+                      label.c_str(), u.nodes, u.nodes == 1 ? " " : "s",
+                      format_bytes(u.total()).c_str(),
+                      format_bytes(u.processor).c_str(),
+                      format_bytes(u.graph).c_str());
+        os << text;
+    };
+
+    os << "=== Memory by letter ===\n";
+    for (auto const &[letter, usage] : per_letter)
+        row(std::string("'") + letter + "'", usage);
+
+    os << "=== Memory by type ===\n";
+    for (auto const &[type, usage] : per_type)
+        row(type, usage);
+
+    os << "=== Memory by word ===\n";
+    for (auto const &[word, usage] : per_word)
+    {
+        std::string label = word >= 0 && static_cast<std::size_t>(word) < words.size()
+                              ? "#" + std::to_string(word) + " " + words[static_cast<std::size_t>(word)]
+                              : "(unknown)";
+        row(label, usage);
+    }
+
+    os << "=== Totals ===\n";
+    if (other.nodes > 0)
+        row("graph I/O nodes", other);
+    row("all nodes", total);
+    os << "  (graph buffer figures are estimates)\n";
+}
+
+#endif
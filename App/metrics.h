@@ -0,0 +1,182 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <juce_core/juce_core.h>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__) || defined(__APPLE__)
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+ #define TEXTGRAPH_HAS_UNIX_SOCKETS 1
+#else
+ #define TEXTGRAPH_HAS_UNIX_SOCKETS 0
+#endif
+
+#include "engine_stats.h"
+#include "play_latency.h"
+#include "quality.h"
+#include "realtime_setup.h"
+
+/* Publishes EngineStats in Prometheus text format from its own thread, so the
+   audio thread never sees any of this I/O. Two targets:
+
+     file   - rewritten every interval (write to <path>.tmp, then rename), which
+              is what node_exporter's textfile collector expects
+     socket - a Unix domain socket; every client that connects is sent the
+              latest snapshot and disconnected */
+
+class MetricsExporter : private juce::Thread
+{
+public:
+    enum class Target { file, socket };
+
+    MetricsExporter() : juce::Thread("Metrics exporter") {}
+    ~MetricsExporter() override { stop(); }
+
+    bool start(Target target_in, const std::string& path_in, double interval_seconds)
+    {
+        stop();
+        target = target_in;
+        path = path_in;
+        intervalMs = juce::jmax(100, static_cast<int>(interval_seconds * 1000.0));
+
+        if (target == Target::socket && !open_socket())
+            return false;
+
+        return startThread();
+    }
+
+    void stop()
+    {
+        if (isThreadRunning())
+            stopThread(2000);
+        close_socket();
+    }
+
+    bool isRunning() const { return isThreadRunning(); }
+
+private:
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            RealtimeSetup::get().sync(RealtimeSetup::Role::worker);
+            std::ostringstream text;
+            EngineStats::get().write_prometheus(text);
+            PlayLatency::get().write_prometheus(text);
+            QualityWatchdog::get().write_prometheus(text);
+
+            if (target == Target::file)
+            {
+                write_file(text.str());
+                wait(intervalMs);
+            }
+            else
+            {
+                serve_clients(text.str());
+            }
+        }
+    }
+
+    void write_file(const std::string& text)
+    {
+        const std::string tmp = path + ".tmp";
+        if (FILE* f = std::fopen(tmp.c_str(), "w"))
+        {
+            std::fwrite(text.data(), 1, text.size(), f);
+            std::fclose(f);
+            std::rename(tmp.c_str(), path.c_str());
+        }
+    }
+
+#if TEXTGRAPH_HAS_UNIX_SOCKETS
+    bool open_socket()
+    {
+        sockaddr_un addr {};
+        if (path.size() >= sizeof(addr.sun_path))
+            return false;
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+
+        addr.sun_family = AF_UNIX;
+        std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+        ::unlink(path.c_str());
+
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || ::listen(listenFd, 4) != 0)
+        {
+            close_socket();
+            return false;
+        }
+        return true;
+    }
+
+    void close_socket()
+    {
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+            ::unlink(path.c_str());
+            listenFd = -1;
+        }
+    }
+
+    // Answers every client that connects within one interval, then returns so
+    // the caller can take a fresh snapshot.
+    void serve_clients(const std::string& text)
+    {
+        const auto deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32>(intervalMs);
+
+        while (!threadShouldExit())
+        {
+            const auto now = juce::Time::getMillisecondCounter();
+            if (now >= deadline)
+                return;
+
+            pollfd pfd { listenFd, POLLIN, 0 };
+            // Short poll slices keep stopThread() responsive
+            if (::poll(&pfd, 1, juce::jmin(100, static_cast<int>(deadline - now))) <= 0)
+                continue;
+
+            const int client = ::accept(listenFd, nullptr, nullptr);
+            if (client < 0)
+                continue;
+
+            // A client that hung up must not SIGPIPE the whole engine
+#if defined(__APPLE__)
+            const int one = 1;
+            ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+            constexpr int sendFlags = 0;
+#else
+            constexpr int sendFlags = MSG_NOSIGNAL;
+#endif
+            std::size_t sent = 0;
+            while (sent < text.size())
+            {
+                const auto n = ::send(client, text.data() + sent, text.size() - sent, sendFlags);
+                if (n <= 0)
+                    break;
+                sent += static_cast<std::size_t>(n);
+            }
+            ::close(client);
+        }
+    }
+#else
+    bool open_socket() { return false; }
+    void close_socket() {}
+    void serve_clients(const std::string&) { wait(intervalMs); }
+#endif
+
+    Target target = Target::file;
+    std::string path;
+    int intervalMs = 5000;
+    int listenFd = -1;
+};
+
+#endif
@@ -8,6 +8,8 @@
 #include <juce_dsp/juce_dsp.h>
 #include <juce_audio_utils/juce_audio_utils.h>
 
+#include "lazy_gates.h"
+
 /* This class enables rhythms, melody patterns, and everything to do with
    parenthesis notation in my CL audio processor.
 
@@ -93,6 +95,11 @@ public:
         loopCount = 0;
         isInitialCycle = true;
         externalGatingNoteActive = false;
+
+        // Room for a busy block's worth of events, so building the output
+        // never allocates on the audio thread
+        processedMidi.ensureSize(midiBufferBytes);
+        publish_schedule();
     }
 
     void processBlock (juce::AudioSampleBuffer& audio, 
@@ -106,7 +113,7 @@ public:
             return;
         }
 
-        juce::MidiBuffer processedMidi; // To build the output MIDI buffer
+        processedMidi.clear(); // Keeps its storage; swapped with the graph's buffer below
         auto incomingMidiIter = midiMessages.cbegin();
         const auto incomingMidiEnd = midiMessages.cend();
 
@@ -187,6 +194,15 @@ public:
 
         midiMessages.swapWith(processedMidi); 
         globalSampleCount += blockSize;
+        publish_schedule();
+    }
+
+    using juce::AudioProcessor::processBlock;
+
+    // OfflineEngine::seek: the clock and the notes are all there is to move on
+    void seek_block (juce::AudioSampleBuffer& audio, juce::MidiBuffer& midiMessages)
+    {
+        processBlock(audio, midiMessages);
     }
 
     const juce::String getName() const override { return "Midi Pulse"; }
@@ -203,7 +219,53 @@ public:
 
     unsigned long long getLoopCount() const { return loopCount; }
 
+    // MORPH, on the audio thread: bpm, beats on, beats off. The current state
+    // runs to its end; the new lengths count from the next change.
+    void set_live_params(const double* values)
+    {
+        bpm = juce::jmax(1.0, values[0]);
+        beatsOn = juce::jmax(0, static_cast<int>(std::lround(values[1])));
+        beatsOff = juce::jmax(0, static_cast<int>(std::lround(values[2])));
+        samplesPerBeat = static_cast<long long>((sampleRate * 60.0) / bpm);
+        samplesForOnDuration = beatsOn * samplesPerBeat;
+        samplesForOffDuration = beatsOff * samplesPerBeat;
+        if (nextStateChangeGlobalSample < globalSampleCount)
+            nextStateChangeGlobalSample = globalSampleCount; // was stopped (no rhythm): restart now
+    }
+
+    // When this pulser's gate opens next, for LazyGates
+    const GateSchedule& gate_schedule() const { return schedule; }
+
+    // This pulser sits in another's parentheses (velocity 0: opens on any of its notes)
+    void set_parent_gate(const MidiBeatPulseProcessor& parent, int listenVelocity)
+    {
+        schedule.set_parent(&parent.schedule, listenVelocity);
+    }
+
+    // Only the output MIDI buffer lives on the heap
+    std::size_t getHeapBytes() const { return midiBufferBytes; }
+
 private:
+    // Same arithmetic as processBlock: the next note-on comes at the next
+    // AWAITING_NOTE_ON -> NOTE_IS_ON change, one loop further on
+    void publish_schedule() noexcept
+    {
+        const int connections = num_connections;
+        const long long cycle = samplesForOnDuration + samplesForOffDuration;
+        if (beatsOn == 0 || cycle == 0)
+        {
+            schedule.publish(GateSchedule::never, 1, 0, cycle, connections);
+            return;
+        }
+
+        long long untilNextOn = nextStateChangeGlobalSample - globalSampleCount;
+        unsigned long long nextLoop = isInitialCycle ? loopCount : loopCount + 1;
+        if (currentCycleState == CycleState::NOTE_IS_ON)
+            untilNextOn += samplesForOffDuration;
+        const int nextVelocity = connections > 0 ? static_cast<int>(nextLoop % static_cast<unsigned long long>(connections)) + 1 : 1;
+        schedule.publish(juce::jmax(0LL, untilNextOn), nextVelocity, ourGeneratedNoteIsOn ? velocity : 0, cycle, connections);
+    }
+
     // Settings
     double bpm;
     int    noteNumber; 
@@ -235,6 +297,10 @@ private:
     bool is_listening_velocity = false;
     juce::uint8 listening_velocity = 1;
 
+    static constexpr std::size_t midiBufferBytes = 2048;
+    juce::MidiBuffer processedMidi; // Built each block, then swapped into the graph's buffer
+    GateSchedule schedule;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiBeatPulseProcessor)
 };
 
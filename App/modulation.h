@@ -0,0 +1,259 @@
+#ifndef MODULATION_H
+#define MODULATION_H
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lazy_gates.h"
+
+/* Control-rate modulation: LFOs and envelopes declared with SET that move a
+   bound parameter without new letters or a rebuild.
+
+     SET f lfo cutoff 0.25 1.5 triangle   rate (Hz), depth, shape (sin, triangle, saw, square)
+     SET f env cutoff 0.01 0.8 3          attack (s), decay (s), depth
+     SET f lfo cutoff off
+
+   Depth is in the target's own unit: octaves for a filter's cutoff, semitones
+   for an oscillator's detune, plain amounts for a delay's wet level and a
+   reverb's size. A parameter takes at most one LFO and one envelope, summed.
+
+   An envelope starts with the graph and restarts on every note: a voice's on
+   its own note-on, an effect's whenever a gate of a pulser feeding it opens
+   (the same gates the parser hands the lazy gates, ModInput::gates). An
+   effect fed only by ungated voices runs its envelope once.
+
+   All modulators of the running graph live in one ModulationEngine, stored as
+   parallel arrays (phase, rate, depth, envelope level, ...). The engine ticks
+   once per sub-block (the internal quantum, see quantum.h) before the graph
+   runs, evaluating every modulator in a single pass over those arrays.
+   Processors read their slot's value and ramp to it across the sub-block, so
+   even a graph full of modulation costs a few hundred arithmetic operations
+   per sub-block rather than per sample. */
+
+struct ModSpec
+{
+    enum class Kind : std::uint8_t { lfo, env };
+    enum class Shape : std::uint8_t { sin, triangle, saw, square };
+
+    std::string target;
+    Kind kind = Kind::lfo;
+    Shape shape = Shape::sin;
+    double rate = 1.0;    // lfo: cycles per second
+    double attack = 0.01; // env: seconds from 0 to 1
+    double decay = 0.5;   // env: seconds from 1 back to 0
+    double depth = 0.0;
+
+    static bool parse_shape(std::string_view name, Shape& shape)
+    {
+        if (name == "sin")           shape = Shape::sin;
+        else if (name == "triangle") shape = Shape::triangle;
+        else if (name == "saw")      shape = Shape::saw;
+        else if (name == "square")   shape = Shape::square;
+        else                         return false;
+        return true;
+    }
+
+    static const char* shape_name(Shape shape)
+    {
+        switch (shape)
+        {
+            case Shape::sin:      return "sin";
+            case Shape::triangle: return "triangle";
+            case Shape::saw:      return "saw";
+            case Shape::square:   return "square";
+        }
+        return "?";
+    }
+};
+
+class ModulationEngine
+{
+public:
+    static constexpr int maxSlots = 256;
+
+    static ModulationEngine& get()
+    {
+        static ModulationEngine e;
+        return e;
+    }
+
+    // ---- message thread (while building a graph) ----
+    void clear()
+    {
+        const juce::SpinLock::ScopedLockType lock(configLock);
+        count = 0;
+    }
+
+    // Returns the new modulator's slot, or -1 once every slot is taken
+    int add(const ModSpec& spec)
+    {
+        const juce::SpinLock::ScopedLockType lock(configLock);
+        if (count == maxSlots)
+            return -1;
+
+        const auto i = static_cast<std::size_t>(count);
+        kind[i] = static_cast<std::uint8_t>(spec.kind);
+        shape[i] = static_cast<std::uint8_t>(spec.shape);
+        rate[i] = spec.rate;
+        depth[i] = spec.depth;
+        attackRate[i] = 1.0 / juce::jmax(1.0e-4, spec.attack);
+        decayRate[i] = 1.0 / juce::jmax(1.0e-4, spec.decay);
+        phase[i] = 0.0;
+        level[i] = 0.0;
+        stage[i] = attacking; // envelopes start with the graph
+        retrigger[i] = 0;
+        values[i] = 0.0;
+        return count++;
+    }
+
+    int size() const { return count; }
+
+    // ---- audio thread ----
+    // Advances every modulator by one sub-block. Skipped (values hold) in the
+    // rare block where a PLAY is rewriting the table.
+    void tick(int numSamples, double sampleRate) noexcept
+    {
+        const juce::SpinLock::ScopedTryLockType lock(configLock);
+        if (!lock.isLocked() || sampleRate <= 0.0)
+            return;
+
+        constexpr double twoPi = juce::MathConstants<double>::twoPi;
+        const double dt = numSamples / sampleRate;
+        for (int n = 0; n < count; ++n)
+        {
+            const auto i = static_cast<std::size_t>(n);
+
+            double p = phase[i] + rate[i] * dt;
+            p -= std::floor(p);
+            phase[i] = p;
+
+            double wave = 0.0;
+            switch (shape[i])
+            {
+                case static_cast<std::uint8_t>(ModSpec::Shape::sin):      wave = std::sin(twoPi * p); break;
+                case static_cast<std::uint8_t>(ModSpec::Shape::triangle): // starts at 0, rising
+                    wave = 1.0 - 4.0 * std::abs(p + (p < 0.75 ? 0.25 : -0.75) - 0.5); break;
+                case static_cast<std::uint8_t>(ModSpec::Shape::saw):      wave = 2.0 * p - 1.0; break;
+                default:                                                  wave = p < 0.5 ? 1.0 : -1.0; break;
+            }
+
+            if (retrigger[i] != 0)
+            {
+                retrigger[i] = 0;
+                stage[i] = attacking;
+            }
+            if (stage[i] == attacking)
+            {
+                level[i] += attackRate[i] * dt;
+                if (level[i] >= 1.0) { level[i] = 1.0; stage[i] = decaying; }
+            }
+            else if (stage[i] == decaying)
+            {
+                level[i] -= decayRate[i] * dt;
+                if (level[i] <= 0.0) { level[i] = 0.0; stage[i] = idle; }
+            }
+
+            values[i] = depth[i] * (kind[i] == static_cast<std::uint8_t>(ModSpec::Kind::lfo) ? wave : level[i]);
+        }
+    }
+
+    double value(int slot) const noexcept { return values[static_cast<std::size_t>(slot)]; }
+
+    // Restarts an envelope from its current level (a voice's note-on)
+    void trigger(int slot) noexcept { retrigger[static_cast<std::size_t>(slot)] = 1; }
+
+private:
+    enum Stage : std::uint8_t { idle, attacking, decaying };
+
+    ModulationEngine() = default;
+
+    juce::SpinLock configLock;
+    int count = 0;
+
+    std::array<double, maxSlots> phase {};      // lfo, in cycles
+    std::array<double, maxSlots> rate {};
+    std::array<double, maxSlots> level {};      // env, 0..1
+    std::array<double, maxSlots> attackRate {};
+    std::array<double, maxSlots> decayRate {};
+    std::array<double, maxSlots> depth {};
+    std::array<double, maxSlots> values {};
+    std::array<std::uint8_t, maxSlots> kind {};
+    std::array<std::uint8_t, maxSlots> shape {};
+    std::array<std::uint8_t, maxSlots> stage {};
+    std::array<std::uint8_t, maxSlots> retrigger {};
+};
+
+// One modulated parameter of a processor: up to one LFO and one envelope
+struct ModInput
+{
+    std::array<int, 2> slots { -1, -1 };
+    double previous = 0.0;
+    double range = 0.0; // furthest the modulators can move the parameter either way
+
+    void attach(const ModSpec& spec, int slot)
+    {
+        slots[spec.kind == ModSpec::Kind::lfo ? 0 : 1] = slot;
+        range += std::abs(spec.depth);
+    }
+
+    bool active() const noexcept { return slots[0] >= 0 || slots[1] >= 0; }
+
+    double current() const noexcept
+    {
+        auto& engine = ModulationEngine::get();
+        return (slots[0] >= 0 ? engine.value(slots[0]) : 0.0) + (slots[1] >= 0 ? engine.value(slots[1]) : 0.0);
+    }
+
+    // This sub-block ramps from the last value to the one just computed
+    struct Ramp { double start, end; };
+    Ramp next_ramp() noexcept
+    {
+        const Ramp r { previous, current() };
+        previous = r.end;
+        return r;
+    }
+
+    void trigger_envelope() noexcept
+    {
+        if (slots[1] >= 0)
+            ModulationEngine::get().trigger(slots[1]);
+    }
+
+    // Effects, once per sub-block: restarts the envelope when one of the
+    // gates feeding the processor has opened since the last sub-block
+    void follow_gates() noexcept
+    {
+        bool opened = false;
+        for (auto& g : gates)
+        {
+            const bool open = g.waker.gate->until_open(g.waker.velocity) == 0;
+            opened = opened || (open && !g.open);
+            g.open = open;
+        }
+        if (opened)
+            trigger_envelope();
+    }
+
+    struct Gate
+    {
+        LazyNode::Waker waker;
+        bool open = false;
+    };
+    std::vector<Gate> gates; // set by the parser for an effect's envelope
+};
+
+// Implemented by processors with parameters LFOs and envelopes can move
+struct Modulatable
+{
+    virtual ~Modulatable() = default;
+
+    // nullptr if there is no such target
+    virtual ModInput* modulation_input(std::string_view target) = 0;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef OFFLINE_RENDER_H
+#define OFFLINE_RENDER_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "instrumented.h"
+#include "letter_binds.h"
+#include "modulation.h"
+#include "parse_line.h"
+#include "quantum.h"
+#include "user_input.h"
+#include "word_bus.h"
+
+/* Drives a private registry + graph without an audio device, as fast as the
+   CPU allows. Understands the commands that change the sound (SET, "score",
+   PLAY, PAUSE) exactly like the live app, so a command file renders the same
+   offline as it plays live. Everything runs on the calling thread, which must
+   be the message thread (graph rebuilds only happen synchronously there). */
+
+struct RenderSettings
+{
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    juce::int64 seed = 1;        // NoiseOsc seed for each PLAY; 0 keeps random noise
+    bool randomBindings = true;  // start from the compile-time random bindings, like the live app
+    bool wordBuses = false;      // give every word its own WordBus so it can be captured
+    int quantum = 0;             // run the graph in pieces of this many samples (0 = whole blocks)
+    bool modulation = true;      // tick the process-wide ModulationEngine (off for engines rendering side by side)
+};
+
+class OfflineEngine
+{
+public:
+    explicit OfflineEngine(RenderSettings settings_in)
+        : settings(settings_in),
+          graph(std::make_shared<juce::AudioProcessorGraph>()),
+          parse(graph, reg)
+    {
+        if (settings.randomBindings)
+            bind_all_letters_and_params_random(reg);
+
+        parse.use_word_buses = settings.wordBuses;
+
+        graph->setProcessingPrecision(juce::AudioProcessor::doublePrecision);
+        graph->setPlayConfigDetails(0, 2, settings.sampleRate, settings.blockSize);
+        graph->prepareToPlay(settings.sampleRate, settings.blockSize);
+        block.setSize(2, settings.blockSize);
+    }
+
+    ~OfflineEngine()
+    {
+        graph->releaseResources();
+    }
+
+    void command(std::string line)
+    {
+        bool set_command = line.starts_with("SET");
+        bool play_command = line.starts_with("PLAY");
+        bool pause_command = line.starts_with("PAUSE");
+
+        std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (set_command) {
+            execute_bind_command(reg, line);
+        } else if (play_command) {
+            NoiseOsc::set_deterministic_seed(settings.seed);
+            parse.clear_graph();
+            parse.parse_and_initialize(saved_graph);
+            NoiseOsc::set_deterministic_seed(0);
+        } else if (pause_command) {
+            parse.clear_graph();
+        } else {
+            RegexFunctor<"\"([^\"]*)\""> graph_str_match(line);
+            if (auto m = graph_str_match()) {
+                saved_graph = (*m)[1].str();
+            }
+        }
+    }
+
+    // Renders the next numSamples of the current graph into dest at destStart.
+    void render(juce::AudioBuffer<double>& dest, int destStart, int numSamples)
+    {
+        run(numSamples, [&](const juce::AudioBuffer<double>& view, int done) {
+            for (int ch = 0; ch < juce::jmin(2, dest.getNumChannels()); ++ch)
+                dest.copyFrom(ch, destStart + done, view, ch, 0, view.getNumSamples());
+        });
+    }
+
+    // Moves the current graph on by numSamples, block by block as render()
+    // would, without working out what it sounds like: pulsers keep time and
+    // voices keep their phase, gain ramps and noise sequence; everything else
+    // is skipped and starts again from silence. Render a little after a seek
+    // before using the audio, so filters have something to ring with.
+    void seek(juce::int64 numSamples)
+    {
+        set_seeking(true);
+        while (numSamples > 0)
+        {
+            const int n = static_cast<int>(juce::jmin<juce::int64>(numSamples, 1 << 20));
+            run(n, [](const juce::AudioBuffer<double>&, int) {});
+            numSamples -= n;
+        }
+        set_seeking(false);
+    }
+
+    // Points every WordBus of the current graph at its own buffer of
+    // numSamples. Needs wordBuses, and is undone by the next PLAY.
+    void capture_words(std::vector<juce::AudioBuffer<double>>& dest, int numSamples)
+    {
+        dest.resize(parse.words.size());
+        for (auto& buffer : dest)
+        {
+            buffer.setSize(2, numSamples);
+            buffer.clear();
+        }
+
+        for (auto* node : graph->getNodes())
+        {
+            if (auto* bus = dynamic_cast<WordBus*>(node->getProcessor()))
+            {
+                if (juce::isPositiveAndBelow(bus->get_word(), static_cast<int>(dest.size())))
+                    bus->capture_into(&dest[static_cast<std::size_t>(bus->get_word())]);
+            }
+        }
+    }
+
+    juce::int64 position() const { return samplesRendered; }
+
+    const std::vector<std::string>& words() const { return parse.words; }
+
+    RenderSettings settings;
+    LetterRegistry reg;
+    std::shared_ptr<juce::AudioProcessorGraph> graph;
+    Parser parse;
+
+private:
+    template<typename Deliver>
+    void run(int numSamples, Deliver&& deliver)
+    {
+        juce::MidiBuffer midi;
+        for (int done = 0; done < numSamples;)
+        {
+            const int n = juce::jmin(settings.blockSize, numSamples - done);
+            for_each_quantum(n, settings.quantum, [&](int offset, int length) {
+                if (settings.modulation)
+                    ModulationEngine::get().tick(length, settings.sampleRate);
+                juce::AudioBuffer<double> piece(block.getArrayOfWritePointers(), 2, offset, length);
+                piece.clear();
+                midi.clear();
+                graph->processBlock(piece, midi);
+            });
+            deliver(juce::AudioBuffer<double>(block.getArrayOfWritePointers(), 2, n), done);
+
+            done += n;
+            samplesRendered += n;
+        }
+    }
+
+    void set_seeking(bool on)
+    {
+        for (auto* node : graph->getNodes())
+            if (auto* info = node_info(node->getProcessor()))
+                info->seeking = on;
+    }
+
+    std::string saved_graph;
+    juce::AudioBuffer<double> block;
+    juce::int64 samplesRendered = 0;
+};
+
+#endif
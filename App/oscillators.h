@@ -6,15 +6,27 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <span>
+#include <string_view>
 #include <stdio.h>
 
+#include "modulation.h"
+#include "quality.h"
+#include "upsampler.h"
+#include "realtime_setup.h"
+#include "q31.h"
+
 using WaveformFunction = std::function<double(double)>;
 
-class OscillatorBase : public juce::AudioProcessor
+class OscillatorBase : public juce::AudioProcessor, public Modulatable
 {
 public:
+    static constexpr std::string_view modulation_target = "detune"; // semitones
+
     OscillatorBase(WaveformFunction waveformGenerator)
         : AudioProcessor (BusesProperties()
                              .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
@@ -70,6 +82,17 @@ public:
             oscillator.setFrequency(fixedFrequency, true); 
     }
 
+    // MORPH, on the audio thread: a fractional note glides the pitch. The
+    // note is always the scene's; the render rate was chosen for the highest
+    // note any scene gives the letter (setMorphCeilingNote).
+    void set_live_params(const double* values)
+    {
+        const double note = juce::jlimit(0.0, 127.0, values[0]);
+        fixedMidiNote = static_cast<int>(std::lround(note));
+        fixedFrequency = 440.0 * std::exp2((note - 69.0) / 12.0);
+        oscillator.setFrequency(fixedFrequency);
+    }
+
     void set_velocity(int new_velocity) {
         velocity = static_cast<juce::uint8>(new_velocity);
     }
@@ -88,15 +111,86 @@ public:
         return fixedFrequency;
     }
 
+    // The oscillator's lookup table and frequency ramp buffer, the oscillator
+    // and gain with their smoothing state, plus the low-rate buffer and upsampler
+    // when rendering below the device rate, or the delay lining it up when not
+    std::size_t getHeapBytes() const
+    {
+        return (lookupTableSize + 2) * sizeof(TableSample)
+             + rampSamples * sizeof(TableSample) + sizeof(oscillator) + sizeof(gain)
+             + static_cast<std::size_t>(lowRate.getNumChannels() * lowRate.getNumSamples()) * sizeof(double)
+             + upsampler.getHeapBytes()
+             + static_cast<std::size_t>(alignBuffer.getNumChannels() * alignBuffer.getNumSamples()) * sizeof(double);
+    }
+
+    /* Multi-rate rendering. A voice whose content stays well below the device
+       Nyquist renders at 1/2 or 1/4 of the rate, in mono, and is brought back
+       up by a polyphase interpolator. The factor is picked in prepareToPlay from
+       the pitch, the waveform's significant harmonics and, via setContentLimitHz,
+       whatever the parser knows the signal goes through next (a low-pass).
+
+       The interpolator delays what it upsamples, so with multi-rate on every
+       voice comes out as late as a 1/4-rate one: the others go through a short
+       delay line making up the difference (alignedLatency), and the voice
+       keeps in step with its gate and with every other voice. */
+
+    // Upper bound on useful content set by what follows the voice (e.g. a low-pass)
+    void setContentLimitHz(double hz) { contentLimitHz = hz; }
+
+    // Highest note a MORPH between the saved scenes can take the voice to
+    void setMorphCeilingNote(double note) { morphCeilingHz = 440.0 * std::exp2((note - 69.0) / 12.0); }
+
+    int getDecimation() const { return decimation; }
+
+    // Output delay every voice shares, in samples
+    static int alignedLatency() { return is_multirate_enabled() ? PolyphaseUpsampler::latency_for(4) : 0; }
+
+    static void set_multirate_enabled(bool enabled) { multiRateEnabled().store(enabled); }
+    static bool is_multirate_enabled() { return multiRateEnabled().load(); }
+
+    // Attached by the parser before the graph is prepared, so the detune's
+    // range is known when the decimation factor is chosen
+    ModInput* modulation_input(std::string_view target) override
+    {
+        return target == modulation_target ? &detuneMod : nullptr;
+    }
+
     void prepareToPlay (double newSampleRate, int samplesPerBlock) override
     {
         sampleRate = newSampleRate;
+        decimation = choose_decimation();
+
+        // A decimated voice renders one channel and copies it; the waveform is
+        // the same on every channel anyway
+        juce::dsp::ProcessSpec spec { sampleRate / decimation,
+                                      static_cast<juce::uint32> (samplesPerBlock / decimation + 1),
+                                      static_cast<juce::uint32> (decimation > 1 ? 1 : getTotalNumOutputChannels()) };
+        if (decimation > 1)
+        {
+            lowRate.setSize(1, samplesPerBlock / decimation + 1);
+            upsampled.setSize(1, (samplesPerBlock / decimation + 1) * decimation);
+            upsampler.prepare(decimation);
+            pendingCount = 0;
+            prefault::touch(lowRate);
+            prefault::touch(upsampled);
+        }
+        else
+        {
+            lowRate.setSize(0, 0);
+            upsampled.setSize(0, 0);
+        }
 
-        juce::dsp::ProcessSpec spec { sampleRate,
-                                      static_cast<juce::uint32> (samplesPerBlock),
-                                      static_cast<juce::uint32> (getTotalNumOutputChannels()) };
+        // Voices that don't go through the 1/4-rate interpolator wait out the difference
+        alignDelay = alignedLatency() - (decimation > 1 ? upsampler.getLatency() : 0);
+        alignBuffer.setSize(getTotalNumOutputChannels(), alignDelay > 0 ? juce::jmax(1, samplesPerBlock) + alignDelay : 0);
+        alignBuffer.clear();
+        prefault::touch(alignBuffer);
+        setLatencySamples(alignedLatency());
 
         oscillator.prepare (spec);
+#if !TEXTGRAPH_FIXED_POINT
+        rampSamples = spec.maximumBlockSize; // juce::dsp::Oscillator's per-block frequency ramp
+#endif
         gain.prepare(spec);
         gain.setRampDurationSeconds(0.005); 
 
@@ -113,6 +207,7 @@ public:
         }
         oscillator.reset(); 
         gain.reset();
+        detuneMod.previous = 0.0;
     }
 
     void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages) override
@@ -123,8 +218,24 @@ public:
             return;
         }
 
+        // The oscillator glides to the new frequency on its own
+        if (detuneMod.active()) {
+            oscillator.setFrequency(fixedFrequency * std::exp2(detuneMod.next_ramp().end / 12.0));
+        }
+
+        if (decimation > 1) {
+            processDecimated(buffer, midiMessages);
+            align(buffer);
+            return;
+        }
+
+        // Every channel carries the same waveform; under CPU pressure work it
+        // out once and copy it (noise loses its stereo spread)
+        const bool mono = QualityWatchdog::tier() >= QualityWatchdog::monoEffects && buffer.getNumChannels() > 1;
+
         const int numSamples = buffer.getNumSamples();
-        juce::dsp::AudioBlock<double> processingBlock (buffer);
+        auto processingBlock = juce::dsp::AudioBlock<double> (buffer)
+                                   .getSubsetChannelBlock (0, mono ? 1 : static_cast<size_t> (buffer.getNumChannels()));
         
         int currentSample = 0; 
         for (const auto meta : midiMessages)
@@ -142,6 +253,21 @@ public:
         if (currentSample < numSamples) {
             render (processingBlock, currentSample, numSamples);
         }
+
+        if (mono)
+            quality::copy_first_channel(buffer);
+        align(buffer);
+    }
+
+    // OfflineEngine::seek: the same block, MIDI and all, but the oscillator and
+    // gain ramp only move on (the phase in one step per run of samples) and the
+    // output stays silent
+    void seek_block (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+    {
+        seeking = true;
+        processBlock(buffer, midiMessages);
+        seeking = false;
+        buffer.clear();
     }
 
     // JUCE boilerplate AudioProcessor methods
@@ -164,6 +290,10 @@ public:
     void releaseResources() override                             {}
 
 protected:
+    // Harmonics that have to survive for the waveform to sound right; 0 means
+    // broadband (never decimated)
+    virtual double significantHarmonics() const { return 0.0; }
+
     // Converts a MIDI note number to frequency in Hz.
     static double midiNoteToHz (int midiNote) {
         return 440.0 * std::pow (2.0, (static_cast<double>(midiNote) - 69.0) / 12.0);
@@ -178,6 +308,7 @@ protected:
         if (m.isNoteOn()) {
             gain.setGainLinear (gain_val); 
             isPlaying = true; 
+            detuneMod.trigger_envelope();
         } else if (m.isNoteOff()) {
             gain.setGainLinear (0.0); 
             isPlaying = false; 
@@ -202,15 +333,28 @@ protected:
         }
 
         if (shouldProcessAudio) {
+            ctx.isBypassed = seeking;
+#if TEXTGRAPH_FIXED_POINT
+            oscillator.process (ctx, gain); // stays Q31 from table to gain
+#else
             oscillator.process (ctx); 
             gain.process (ctx); 
+#endif
         } else {
             subBlock.clear(); 
         }
     }
 
+#if TEXTGRAPH_FIXED_POINT
+    q31::Oscillator              oscillator; // same interface, integer arithmetic
+    q31::Gain                    gain;
+    using TableSample = q31::sample;
+#else
     juce::dsp::Oscillator<double> oscillator;
     juce::dsp::Gain<double>       gain;
+    using TableSample = double;
+#endif
+    std::size_t                  rampSamples = 0;
     
     double                       sampleRate = 0.0; 
     bool                         isPlaying  = false; 
@@ -219,14 +363,131 @@ protected:
     int                          fixedMidiNote = 69; // Default MIDI note (A4)
     double                       fixedFrequency;
     double                       gain_val = 0.5;
+    bool                         seeking = false; // inside seek_block
 
     juce::uint8 velocity = 1;
     bool open_on_all_channels = false;
 
+    ModInput detuneMod;
+
+    static constexpr std::size_t lookupTableSize = 128;
+
 private:
+    static std::atomic<bool>& multiRateEnabled()
+    {
+        static std::atomic<bool> enabled { true };
+        return enabled;
+    }
+
+    // Largest factor whose interpolator passband (0.4 x the low rate) still
+    // covers the content; the gain ramp and MIDI timing get coarser by the same
+    // factor, which at 1/4 of 48 kHz is still under 0.1 ms
+    int choose_decimation() const
+    {
+        const double harmonics = significantHarmonics();
+        if (!is_multirate_enabled() || harmonics <= 0.0 || sampleRate <= 0.0)
+            return 1;
+
+        const double highest = juce::jmax(fixedFrequency, morphCeilingHz) * std::exp2(detuneMod.range / 12.0);
+        const double content = juce::jmin(highest * harmonics, contentLimitHz);
+        for (int factor : { 4, 2 })
+            if (content <= 0.4 * sampleRate / factor)
+                return factor;
+        return 1;
+    }
+
+    // Delays the block by alignDelay: the samples held back from the last block
+    // come first, and the end of this one is held back for the next
+    void align (juce::AudioBuffer<double>& buffer)
+    {
+        if (alignDelay <= 0)
+            return;
+        const int room = alignBuffer.getNumSamples() - alignDelay;
+        if (room <= 0)
+            return;
+        const int channels = juce::jmin(buffer.getNumChannels(), alignBuffer.getNumChannels());
+        for (int start = 0; start < buffer.getNumSamples(); start += room)
+        {
+            const int n = juce::jmin(room, buffer.getNumSamples() - start);
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                double* held = alignBuffer.getWritePointer(ch);
+                double* out = buffer.getWritePointer(ch, start);
+                std::copy(out, out + n, held + alignDelay);
+                std::copy(held, held + n, out);
+                std::copy(held + n, held + n + alignDelay, held);
+            }
+        }
+    }
+
+    void processDecimated (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+    {
+        const int numSamples = buffer.getNumSamples();
+        double* out = buffer.getWritePointer(0);
+
+        // Samples the last block upsampled beyond its end come first
+        const int carried = juce::jmin(numSamples, pendingCount);
+        for (int i = 0; i < carried; ++i)
+            out[i] = pending[i];
+        for (int i = carried; i < pendingCount; ++i)
+            pending[i - carried] = pending[i];
+        pendingCount -= carried;
+
+        const int remaining = numSamples - carried;
+        const int lowCount = (remaining + decimation - 1) / decimation;
+        if (lowCount > 0)
+        {
+            juce::dsp::AudioBlock<double> low (lowRate);
+            low = low.getSubBlock(0, static_cast<size_t>(lowCount));
+
+            int current = 0;
+            for (const auto meta : midiMessages)
+            {
+                const int at = juce::jlimit(0, lowCount, (meta.samplePosition - carried) / decimation);
+                if (at > current)
+                    render(low, current, at);
+                handleMidi(meta.getMessage());
+                current = juce::jmax(current, at);
+            }
+            if (current < lowCount)
+                render(low, current, lowCount);
+
+            // A seek keeps the low-rate grid where it was; the interpolator's
+            // history is left to the audio that follows
+            pendingCount = lowCount * decimation - remaining;
+            if (seeking)
+            {
+                std::fill(pending, pending + pendingCount, 0.0);
+            }
+            else
+            {
+                double* up = upsampled.getWritePointer(0);
+                upsampler.process(lowRate.getReadPointer(0), lowCount, up);
+                for (int i = 0; i < remaining; ++i)
+                    out[carried + i] = up[i];
+                for (int i = 0; i < pendingCount; ++i)
+                    pending[i] = up[remaining + i];
+            }
+        }
+
+        for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+            buffer.copyFrom(ch, 0, buffer, 0, 0, numSamples);
+    }
+
+    double contentLimitHz = std::numeric_limits<double>::infinity();
+    double morphCeilingHz = 0.0;
+    int decimation = 1;
+    juce::AudioBuffer<double> lowRate;   // one block at the decimated rate
+    juce::AudioBuffer<double> upsampled; // the same block back at the device rate
+    PolyphaseUpsampler upsampler;
+    double pending[4] {};                // upsampled past the end of the last block
+    int pendingCount = 0;
+    int alignDelay = 0;                  // samples this voice waits to line up with 1/4-rate ones
+    juce::AudioBuffer<double> alignBuffer; // the samples held back, then room for a block
+
     void commonInitialization(WaveformFunction waveformGenerator)
     {
-        this->oscillator.initialise (waveformGenerator, 128);
+        this->oscillator.initialise (waveformGenerator, lookupTableSize);
     }
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OscillatorBase)
 };
@@ -243,6 +504,10 @@ public:
     {}
 
     const juce::String getName() const override { return "Sine Oscillator"; }
+
+protected:
+    // The 128-point table adds a little distortion; keep the 2nd harmonic's worth
+    double significantHarmonics() const override { return 2.0; }
 };
 
 class SquareOsc : public OscillatorBase
@@ -258,6 +523,10 @@ public:
 
     const juce::String getName() const override { return "Square Oscillator"; }
 
+protected:
+    // Odd harmonics fall at 6 dB/octave: the 63rd is 36 dB down
+    double significantHarmonics() const override { return 63.0; }
+
 };
 
 class SawOsc : public OscillatorBase
@@ -273,6 +542,9 @@ public:
 
 
     const juce::String getName() const override { return "Sawtooth Oscillator"; }
+
+protected:
+    double significantHarmonics() const override { return 63.0; }
 };
 
 // Band-limited triangle
@@ -315,6 +587,10 @@ public:
     {}
 
     const juce::String getName() const override { return "Triangle Oscillator"; }
+
+protected:
+    // Harmonics fall at 12 dB/octave: the 31st is 30 dB down
+    double significantHarmonics() const override { return 31.0; }
 };
 
 class NoiseOsc : public OscillatorBase
@@ -322,11 +598,19 @@ class NoiseOsc : public OscillatorBase
 public:
     NoiseOsc()
         : OscillatorBase([](double) { return 0.0; }) 
-    {gain_val = 0.02;}
+    {gain_val = 0.02; seed();}
 
     NoiseOsc(int initialMidiNote)
         : OscillatorBase([](double) { return 0.0; }, initialMidiNote)
-    {gain_val = 0.02;}
+    {gain_val = 0.02; seed();}
+
+    // Offline renders need repeatable noise: once a base seed is set, every new
+    // NoiseOsc takes the next seed in sequence. 0 (the default) keeps the
+    // random seeding used for live play.
+    static void set_deterministic_seed(juce::int64 base)
+    {
+        nextSeed() = base;
+    }
 
 
     const juce::String getName() const override { return "Noise Oscillator"; }
@@ -354,9 +638,15 @@ protected:
             {
                 for (size_t i = 0; i < subBlock.getNumSamples(); ++i)
                 {
+#if TEXTGRAPH_FIXED_POINT
+                    subBlock.setSample(static_cast<int>(channel), static_cast<int>(i), q31::to_double(random.nextInt()));
+#else
                     subBlock.setSample(static_cast<int>(channel), static_cast<int>(i), random.nextDouble() * 2.0 - 1.0);
+#endif
                 }
             }
+            // A seek still draws every number, so the sequence carries on in step
+            gainContext.isBypassed = seeking;
             gain.process (gainContext); 
         }
         else
@@ -366,6 +656,18 @@ protected:
     }
 
 private:
+    static juce::int64& nextSeed()
+    {
+        static juce::int64 s = 0;
+        return s;
+    }
+
+    void seed()
+    {
+        if (auto& s = nextSeed(); s != 0)
+            random.setSeed(s++);
+    }
+
     juce::Random random;
 };
 
@@ -0,0 +1,277 @@
+#ifndef PARALLEL_RENDER_H
+#define PARALLEL_RENDER_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "golden.h"
+#include "instrumented.h"
+#include "modulation.h"
+#include "offline_render.h"
+
+/* --parallel-render: renders one long score in time chunks on several
+   threads, stitches them and checks the result against the plain serial
+   render of the same score.
+
+     ConsoleAppMessageThread --parallel-render [score file] [--seconds 60] [--chunks n]
+                                               [--preroll 0.25] [--exact] [--max-abs x] [--max-lsd dB]
+
+   Each chunk gets its own OfflineEngine with the same score. Before it
+   renders, it is put where the serial render would be at the chunk's start
+   without working through the audio in between: OfflineEngine::seek runs
+   only the clocks (pulsers, and through their MIDI the gates of every voice,
+   the oscillator phases, gain ramps and noise sequences, each advanced a run
+   of samples at a time). Filters can't be seeked like that, so the last
+   --preroll seconds before the chunk are rendered for real and thrown away,
+   which lets them ring in. Chunks start on block boundaries, so every engine
+   sees the blocks the serial one does.
+
+   That only works when nothing remembers further back than the pre-roll: a
+   score with a delay or reverb (feedback), or with modulators (one
+   ModulationEngine for every graph in the process), is rendered serially
+   and reported as such. The chunk engines never tick the ModulationEngine
+   (RenderSettings::modulation), so its shared state is only touched by the
+   serial render.
+
+   With the Q31 build the phases are integers and a seeked chunk matches the
+   serial render bit for bit up to the filters; with doubles a phase advanced
+   in one step differs from the serial one in the last bits, so the check
+   runs in tolerance mode like --golden: the stitch is checked against
+   --max-abs and --max-lsd, not sample for sample, unless --exact is given.
+   The output names the mode and the first sample that differs. Exit code 0
+   when the stitched render matches. */
+
+namespace parallel_render
+{
+
+struct Options
+{
+    std::string file;
+    double seconds = 60.0;
+    int chunks = 0;         // 0: one per CPU
+    double preroll = 0.25;  // seconds rendered and discarded before each chunk
+    bool exact = false;
+    double maxAbs = 1.0e-4;
+    double maxLsdDb = 0.5;
+};
+
+// Nested gates, every oscillator type and a filter: all of it seekable
+inline std::vector<std::string> default_score()
+{
+    return { "SET a saw note 48", "SET b square note 55", "SET c triangle note 64", "SET d sin note 71",
+             "SET e noise", "SET f filter cutoff 900", "SET m midi bpm 120 on 1 off 1",
+             "SET n midi bpm 95 on 3 off 1", "SET p midi bpm 240 on 1 off 2",
+             "\"m(ab)f n(cp(d)) p(e)f d\"", "PLAY" };
+}
+
+// Why the score can't be split in time, or empty if it can
+inline std::string not_splittable(OfflineEngine& engine)
+{
+    if (ModulationEngine::get().size() > 0)
+        return "it uses modulators";
+    for (auto* node : engine.graph->getNodes())
+        if (auto* info = node_info(node->getProcessor()); info != nullptr
+            && (info->typeName == "delay" || info->typeName == "reverb"))
+            return std::string("'") + info->letter + "' is a " + info->typeName + " (feedback)";
+    return {};
+}
+
+struct Chunk
+{
+    juce::int64 start = 0;
+    int length = 0;
+    int preroll = 0;
+    std::unique_ptr<OfflineEngine> engine;
+    juce::AudioBuffer<double> audio;
+    double seekSeconds = 0.0, renderSeconds = 0.0;
+};
+
+// Engines are built on the message thread; only the rendering runs here
+struct ChunkThread : juce::Thread
+{
+    explicit ChunkThread(Chunk& c) : juce::Thread("Parallel render"), chunk(c) {}
+
+    void run() override
+    {
+        using clock = std::chrono::steady_clock;
+        const auto t0 = clock::now();
+        jassert(ModulationEngine::get().size() == 0); // not_splittable() rules modulators out
+        chunk.engine->seek(chunk.start - chunk.preroll);
+        if (chunk.preroll > 0)
+        {
+            juce::AudioBuffer<double> discard(2, chunk.preroll);
+            chunk.engine->render(discard, 0, chunk.preroll);
+        }
+        const auto t1 = clock::now();
+        chunk.engine->render(chunk.audio, 0, chunk.length);
+        chunk.seekSeconds = std::chrono::duration<double>(t1 - t0).count();
+        chunk.renderSeconds = std::chrono::duration<double>(clock::now() - t1).count();
+    }
+
+    Chunk& chunk;
+};
+
+inline RenderSettings settings_for_scores()
+{
+    RenderSettings settings;
+    settings.randomBindings = false; // like --golden: scores bind what they use
+    return settings;
+}
+
+inline int run(int argc, char* argv[])
+{
+    Options o;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if (arg == "--seconds")       o.seconds = std::atof(next());
+        else if (arg == "--chunks")   o.chunks = std::atoi(next());
+        else if (arg == "--preroll")  o.preroll = std::atof(next());
+        else if (arg == "--exact")    o.exact = true;
+        else if (arg == "--max-abs")  o.maxAbs = std::atof(next());
+        else if (arg == "--max-lsd")  o.maxLsdDb = std::atof(next());
+        else                          o.file = arg;
+    }
+    if (o.seconds <= 0.0 || o.chunks < 0 || o.preroll < 0.0)
+    {
+        std::cerr << "usage: --parallel-render [score file] [--seconds <s>] [--chunks <n>] [--preroll <s>]"
+                     " [--exact] [--max-abs <x>] [--max-lsd <dB>]\n"
+                     "  the stitch is checked in tolerance mode (--max-abs 1e-4, --max-lsd 0.5 dB);"
+                     " --exact requires it to be sample-exact\n";
+        return 2;
+    }
+
+    std::vector<std::string> lines = default_score();
+    if (!o.file.empty())
+    {
+        auto score = golden::load_score(o.file);
+        if (!score)
+        {
+            std::cerr << "Cannot open score file '" << o.file << "'\n";
+            return 2;
+        }
+        lines = score->lines;
+    }
+
+    const auto settings = settings_for_scores();
+    const int total = static_cast<int>(o.seconds * settings.sampleRate);
+    const int chunks = juce::jlimit(1, juce::jmax(1, total / settings.blockSize),
+                                    o.chunks > 0 ? o.chunks : juce::SystemStats::getNumCpus());
+    using clock = std::chrono::steady_clock;
+
+    // The reference
+    OfflineEngine serialEngine(settings);
+    for (auto& line : lines)
+        serialEngine.command(line);
+    const std::string reason = not_splittable(serialEngine);
+
+    juce::AudioBuffer<double> serial(2, total);
+    auto t0 = clock::now();
+    serialEngine.render(serial, 0, total);
+    const double serialSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+    char text[200];
+    std::snprintf(text, sizeof(text), "Serial:   %.2f s for %.1f s of audio (%.1fx realtime)\n",
+                  serialSeconds, o.seconds, o.seconds / serialSeconds);
+    std::cout << text;
+    if (!reason.empty())
+    {
+        std::cout << "Not split in time: " << reason << "; the serial render is the result.\n";
+        return 0;
+    }
+
+    // Chunks of whole blocks, the last one taking what's left
+    const int blocksPerChunk = (total / settings.blockSize + chunks - 1) / chunks;
+    const int chunkLength = blocksPerChunk * settings.blockSize;
+    const int preroll = static_cast<int>(o.preroll * settings.sampleRate) / settings.blockSize * settings.blockSize;
+
+    t0 = clock::now();
+    std::vector<Chunk> parts;
+    for (juce::int64 start = 0; start < total; start += chunkLength)
+    {
+        Chunk c;
+        c.start = start;
+        c.length = static_cast<int>(juce::jmin<juce::int64>(chunkLength, total - start));
+        c.preroll = static_cast<int>(juce::jmin<juce::int64>(preroll, start));
+        auto chunkSettings = settings;
+        chunkSettings.modulation = false;
+        c.engine = std::make_unique<OfflineEngine>(chunkSettings);
+        for (auto& line : lines)
+            c.engine->command(line);
+        c.audio.setSize(2, c.length);
+        parts.push_back(std::move(c));
+    }
+
+    std::vector<std::unique_ptr<ChunkThread>> threads;
+    for (auto& c : parts)
+    {
+        threads.push_back(std::make_unique<ChunkThread>(c));
+        threads.back()->startThread();
+    }
+    for (auto& t : threads)
+        t->waitForThreadToExit(-1);
+
+    juce::AudioBuffer<double> stitched(2, total);
+    for (auto& c : parts)
+        for (int ch = 0; ch < 2; ++ch)
+            stitched.copyFrom(ch, static_cast<int>(c.start), c.audio, ch, 0, c.length);
+    const double parallelSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+    std::snprintf(text, sizeof(text), "Parallel: %.2f s in %d chunks of %.2f s (%.1fx realtime, %.2fx the serial speed)\n",
+                  parallelSeconds, static_cast<int>(parts.size()), chunkLength / settings.sampleRate,
+                  o.seconds / parallelSeconds, serialSeconds / parallelSeconds);
+    std::cout << text;
+    for (std::size_t k = 0; k < parts.size(); ++k)
+    {
+        std::snprintf(text, sizeof(text), "  chunk %2d at %7.2f s: seek + pre-roll %.3f s, render %.3f s\n",
+                      static_cast<int>(k), static_cast<double>(parts[k].start) / settings.sampleRate,
+                      parts[k].seekSeconds, parts[k].renderSeconds);
+        std::cout << text;
+    }
+
+    // Where the stitched render first parts from the serial one, to the sample
+    juce::int64 firstDiff = -1;
+    for (int i = 0; i < total && firstDiff < 0; ++i)
+        for (int ch = 0; ch < 2; ++ch)
+            if (std::memcmp(serial.getReadPointer(ch) + i, stitched.getReadPointer(ch) + i, sizeof(double)) != 0)
+                firstDiff = i;
+
+    juce::AudioBuffer<float> reference;
+    reference.makeCopyOf(serial);
+    const auto d = golden::compare(reference, stitched);
+    const bool pass = o.exact ? firstDiff < 0 : d.maxAbs <= o.maxAbs && d.lsdDb <= o.maxLsdDb;
+
+    if (o.exact)
+        std::cout << "Check: exact (every sample must match the serial render)\n";
+    else
+    {
+        std::snprintf(text, sizeof(text), "Check: tolerance (max %.3g, LSD %.3f dB; --exact to require every sample)\n",
+                      o.maxAbs, o.maxLsdDb);
+        std::cout << text;
+    }
+
+    if (firstDiff < 0)
+        std::cout << "Stitched render is sample-exact.\n";
+    else
+    {
+        std::snprintf(text, sizeof(text), "Stitched render differs from sample %lld (%.3f s, chunk %d): max %.3g, LSD %.3f dB\n",
+                      static_cast<long long>(firstDiff), static_cast<double>(firstDiff) / settings.sampleRate,
+                      static_cast<int>(firstDiff / chunkLength), d.maxAbs, d.lsdDb);
+        std::cout << text;
+    }
+    std::cout << (pass ? "PASS" : "FAIL") << (o.exact ? " (exact)" : " (tolerance)") << "\n";
+    return pass ? 0 : 1;
+}
+
+} // namespace parallel_render
+
+#endif
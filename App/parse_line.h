@@ -14,6 +14,12 @@
 #include "oscillators.h"
 #include "effects.h"
 #include "midi_pulse.h"
+#include "trace.h"
+#include "instrumented.h"
+#include "word_bus.h"
+#include "play_latency.h"
+#include "modulation.h"
+#include "logger.h"
 
 static auto is_effect(juce::AudioProcessorGraph::Node::Ptr node) {
     return dynamic_cast<EffectsBase*>(node->getProcessor()) != nullptr;
@@ -36,32 +42,39 @@ public:
     }
 
     void clear_graph() {
+        TraceScope scope("graph", "clear");
+        if (lazy_gates)
+            LazyGates::get().forget_all(); // before the nodes go
+        words.clear();
         graph->clear();
         graph->rebuild();
+        ModulationEngine::get().clear(); // the nodes reading the slots are gone
         audioOut = graph->addNode (std::make_unique<juce::AudioProcessorGraph::AudioGraphIOProcessor>
                                 (juce::AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode));
     }
 
     void connect(juce::AudioProcessorGraph::Node::Ptr n1, juce::AudioProcessorGraph::Node::Ptr n2) {
-        graph->addConnection ({ {n1->nodeID, 0}, {n2->nodeID, 0} }); // left
-        graph->addConnection ({ {n1->nodeID, 1}, {n2->nodeID, 1} }); // right
+        graph->addConnection ({ {n1->nodeID, 0}, {n2->nodeID, 0} }, deferred); // left
+        graph->addConnection ({ {n1->nodeID, 1}, {n2->nodeID, 1} }, deferred); // right
     }
     void connect_midi_direct(juce::AudioProcessorGraph::Node::Ptr n1, juce::AudioProcessorGraph::Node::Ptr n2) {
         graph->addConnection({ {n1->nodeID, juce::AudioProcessorGraph::midiChannelIndex},
-                               {n2->nodeID, juce::AudioProcessorGraph::midiChannelIndex} });
+                               {n2->nodeID, juce::AudioProcessorGraph::midiChannelIndex} }, deferred);
         if (auto* osc = is_osc(n2)) {
             osc->setMidiTriggered(true);
             osc->set_open_on_all_channels(true);
+            gate(n1, n2, 0);
         }
         else if (auto* midi = is_midi(n2)) {
             midi->setMidiInputGatingEnabled(true);
             midi->set_is_listening_velocity(false);
+            midi->set_parent_gate(*is_midi(n1), 0);
         }
     }
 
     void connect_midi(juce::AudioProcessorGraph::Node::Ptr n1, juce::AudioProcessorGraph::Node::Ptr n2, bool need_to_inc) {
         graph->addConnection({ {n1->nodeID, juce::AudioProcessorGraph::midiChannelIndex},
-                               {n2->nodeID, juce::AudioProcessorGraph::midiChannelIndex} });
+                               {n2->nodeID, juce::AudioProcessorGraph::midiChannelIndex} }, deferred);
         if (auto* osc = is_osc(n2)) {
             osc->setMidiTriggered(true);
             auto *m = is_midi(n1);
@@ -70,6 +83,7 @@ public:
             auto connection = m->get_connections();
             osc->set_open_on_all_channels(false);
             osc->set_velocity(connection);
+            gate(n1, n2, connection);
         }
         else if (auto* midi = is_midi(n2)) {
             midi->setMidiInputGatingEnabled(true);
@@ -79,10 +93,83 @@ public:
             auto connection = m->get_connections();
             midi->set_listening_velocity(connection);
             midi->set_is_listening_velocity(true);
+            midi->set_parent_gate(*m, connection);
         }
 
     }
 
+    // The gates a node sounds behind, for lazy activation (lazy_gates.h) and
+    // effect envelopes: the oscillator can only sound once the pulser opens on
+    // this velocity (0 = any)
+    void gate(juce::AudioProcessorGraph::Node::Ptr pulser, juce::AudioProcessorGraph::Node::Ptr node, int velocity) {
+        auto* info = node_info(node->getProcessor());
+        if (info == nullptr)
+            return;
+        info->wakers.push_back({ &is_midi(pulser)->gate_schedule(), velocity });
+    }
+
+    // ...and an effect once any of the nodes feeding it can
+    void gate_through(juce::AudioProcessorGraph::Node::Ptr from, juce::AudioProcessorGraph::Node::Ptr to) {
+        auto* source = node_info(from->getProcessor());
+        auto* info = node_info(to->getProcessor());
+        if (info == nullptr)
+            return;
+        if (source == nullptr || source->wakers.empty() || source->fedUngated)
+            info->fedUngated = true;
+        else
+            info->wakers.insert(info->wakers.end(), source->wakers.begin(), source->wakers.end());
+    }
+
+    // An effect's envelopes restart when a gate feeding it opens; a voice
+    // restarts its own on note-on
+    void gate_envelopes(juce::AudioProcessorGraph::Node* node) {
+        auto* info = node_info(node->getProcessor());
+        auto* target = dynamic_cast<Modulatable*>(node->getProcessor());
+        if (info == nullptr || target == nullptr || is_osc(node) != nullptr)
+            return;
+        for (auto& spec : reg.modulators(info->letter)) {
+            auto* input = spec.kind == ModSpec::Kind::env ? target->modulation_input(spec.target) : nullptr;
+            if (input == nullptr)
+                continue;
+            input->gates.clear();
+            for (const auto& waker : info->wakers)
+                input->gates.push_back({ waker, false });
+        }
+    }
+
+    // Gives the node a slot in the ModulationEngine for each of its letter's modulators
+    void attach_modulators(char letter, juce::AudioProcessor* processor) {
+        auto* target = dynamic_cast<Modulatable*>(processor);
+        if (target == nullptr)
+            return;
+
+        for (auto& spec : reg.modulators(letter)) {
+            auto* input = target->modulation_input(spec.target);
+            if (input == nullptr)
+                continue;
+            const int slot = ModulationEngine::get().add(spec);
+            if (slot < 0) {
+                log_err() << "Modulation: all " << ModulationEngine::maxSlots << " slots in use, '"
+                          << letter << "' " << spec.target << " stays still\n";
+                continue;
+            }
+            input->attach(spec, slot);
+        }
+    }
+
+    // Render rates are chosen in prepareToPlay and can't change under a
+    // MORPH, so voices and filters are sized for the highest note and cutoff
+    // any saved scene gives their letter
+    void apply_morph_ceiling(char letter, juce::AudioProcessor* processor) {
+        auto highest = morph_highest.find(letter);
+        if (highest == morph_highest.end() || highest->second.empty())
+            return;
+        if (auto* osc = dynamic_cast<OscillatorBase*>(processor))
+            osc->setMorphCeilingNote(highest->second[0]);
+        else if (auto* filter = dynamic_cast<FilterProcessor*>(processor))
+            filter->setMorphCeilingHz(highest->second[0]);
+    }
+
     void initialize_word(std::string const &s) {
 
         bool need_to_inc = true;
@@ -91,6 +178,7 @@ public:
 
         juce::AudioProcessorGraph::Node::Ptr current_node;
         juce::AudioProcessorGraph::Node::Ptr effects_tail = nullptr;
+        std::vector<OscillatorBase*> chain_sources; // oscillators feeding this word's effects chain
 
         bool prev_was_midi = false;
 
@@ -110,7 +198,13 @@ public:
                 continue;
             }
 
-            current_node = graph->addNode (reg.initialize(*it));
+            current_node = graph->addNode (reg.initialize(*it), std::nullopt, deferred);
+            if (auto* info = node_info(current_node->getProcessor())) {
+                info->word = current_word;
+                info->offset = static_cast<int>(it - s.begin());
+            }
+            attach_modulators(*it, current_node->getProcessor());
+            apply_morph_ceiling(*it, current_node->getProcessor());
 
             if (prev_was_midi) {
                 connect_midi_direct(midi_pulsers.back(), current_node);
@@ -128,11 +222,20 @@ public:
             else if (is_effect(current_node)) {
                 for (auto orphan : orphans) {
                     connect(orphan, current_node);
+                    gate_through(orphan, current_node);
+                    chain_sources.push_back(is_osc(orphan));
                     prev_was_midi = false;
                 }
+                // Nothing later in the chain adds high frequencies back, so a
+                // low-pass here bounds what every voice upstream needs to render
+                if (auto* filter = dynamic_cast<FilterProcessor*>(current_node->getProcessor())) {
+                    for (auto* osc : chain_sources)
+                        osc->setContentLimitHz(filterContentMultiple * filter->getHighestCutoffFrequency());
+                }
                 orphans.clear();
                 if (effects_tail) {
                     connect(effects_tail, current_node);
+                    gate_through(effects_tail, current_node);
                 }
                 effects_tail = current_node;
             }
@@ -141,20 +244,50 @@ public:
                 midi_pulsers.push_back(current_node);
             }
         }
+        auto word_out = audioOut;
+        if (use_word_buses) {
+            word_out = graph->addNode(std::make_unique<WordBus>(current_word), std::nullopt, deferred);
+            connect(word_out, audioOut);
+        }
+
         if (effects_tail)
-            connect(effects_tail, audioOut);
+            connect(effects_tail, word_out);
         for (auto orphan : orphans) {
-            connect(orphan, audioOut);
+            connect(orphan, word_out);
         }
     }
 
     void parse_and_initialize(const std::string& line) {
+        TraceScope scope("graph", "rebuild");
         std::istringstream stream(line);
         std::string word;
 
+        words.clear();
         while (stream >> word) {
-            initialize_word(word);
+            words.push_back(word);
+        }
+        PlayLatency::get().mark(PlayLatency::parsed);
+
+        // Nodes and connections go in without touching the running graph; the
+        // single rebuild below prepares every node and swaps the result in
+        for (std::size_t w = 0; w < words.size(); ++w) {
+            current_word = static_cast<int>(w);
+            initialize_word(words[w]);
+        }
+        PlayLatency::get().mark(PlayLatency::built);
+
+        for (auto* node : graph->getNodes())
+            gate_envelopes(node);
+
+        // Gated nodes whose gate isn't about to open are left unprepared
+        if (lazy_gates) {
+            for (auto* node : graph->getNodes())
+                if (auto* info = node_info(node->getProcessor()))
+                    LazyGates::get().add(*info);
         }
+
+        graph->rebuild();
+        PlayLatency::get().mark(PlayLatency::prepared);
     }
 
     std::shared_ptr<juce::AudioProcessorGraph> graph;
@@ -162,6 +295,17 @@ public:
     juce::AudioProcessorGraph::Node::Ptr audioOut;
     std::vector<juce::AudioProcessorGraph::Node::Ptr> midi_pulsers;
     size_t paren_depth = 0;
+    std::vector<std::string> words; // words of the score currently in the graph
+    bool use_word_buses = false;    // route each word through its own WordBus node
+    bool lazy_gates = false;        // let LazyGates keep nodes behind closed gates unprepared (live graph only)
+    std::map<char, std::vector<double>> morph_highest; // per letter, the highest of each parameter in any scene
+
+private:
+    // Graph edits made while building a score; parse_and_initialize rebuilds once at the end
+    static constexpr auto deferred = juce::AudioProcessorGraph::UpdateKind::none;
+    // Three octaves above a 12 dB/octave low-pass's cutoff, content is 36 dB down and need not be rendered
+    static constexpr double filterContentMultiple = 8.0;
+    int current_word = -1;
 };
 
 
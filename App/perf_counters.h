@@ -0,0 +1,127 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+ #define TEXTGRAPH_HAS_PERF_EVENTS 1
+#else
+ #define TEXTGRAPH_HAS_PERF_EVENTS 0
+#endif
+
+/* Hardware counters for the calling thread via perf_event_open (Linux).
+   Each counter is opened on its own so one the CPU or VM doesn't offer (or a
+   perf_event_paranoid setting refuses) just reads as unavailable; results are
+   scaled for multiplexing. Elsewhere every counter is unavailable. */
+
+class PerfCounters
+{
+public:
+    enum Counter { cycles, instructions, cacheReferences, cacheMisses, l1dReadMisses, taskClockNs, numCounters };
+
+    static constexpr const char* names[numCounters] = {
+        "cycles", "instructions", "cache refs", "cache misses", "L1D read misses", "task clock ns"
+    };
+
+    struct Reading
+    {
+        std::array<double, numCounters> value {};
+        std::array<bool, numCounters> available {};
+    };
+
+    PerfCounters()
+    {
+#if TEXTGRAPH_HAS_PERF_EVENTS
+        open(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(cacheReferences, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+        open(cacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open(l1dReadMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                                                 | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                                 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open(taskClockNs, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#if TEXTGRAPH_HAS_PERF_EVENTS
+        for (int fd : fds)
+            if (fd >= 0)
+                ::close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool any_hardware() const
+    {
+        return fds[cycles] >= 0 || fds[cacheMisses] >= 0 || fds[l1dReadMisses] >= 0;
+    }
+
+    void start()
+    {
+#if TEXTGRAPH_HAS_PERF_EVENTS
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+            {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    Reading stop()
+    {
+        Reading r;
+#if TEXTGRAPH_HAS_PERF_EVENTS
+        for (int c = 0; c < numCounters; ++c)
+        {
+            if (fds[static_cast<std::size_t>(c)] < 0)
+                continue;
+            const int fd = fds[static_cast<std::size_t>(c)];
+            ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            std::uint64_t data[3] {}; // value, time enabled, time running
+            if (::read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+                continue;
+            r.value[static_cast<std::size_t>(c)] = static_cast<double>(data[0])
+                                                   * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+            r.available[static_cast<std::size_t>(c)] = true;
+        }
+#endif
+        return r;
+    }
+
+private:
+#if TEXTGRAPH_HAS_PERF_EVENTS
+    void open(Counter c, std::uint32_t type, std::uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[static_cast<std::size_t>(c)] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    std::array<int, numCounters> fds { -1, -1, -1, -1, -1, -1 };
+};
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef PLAY_LATENCY_H
+#define PLAY_LATENCY_H
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "lockfree_ring.h"
+#include "logger.h"
+#include "trace.h"
+
+/* How long after PLAY is typed the new score can be heard, split into stages:
+
+     received  the command line arrives
+     parsed    old graph cleared, score split into words
+     built     nodes created and connected (no graph rebuild yet)
+     prepared  graph rebuilt: every node's prepareToPlay done, render sequence ready
+     swapped   the audio thread runs the first block of the new graph
+     audible   the first block with output above the silence threshold leaves
+               the callback for the device
+
+   The command thread marks the first four and returns; the audio thread
+   marks the last two, and whichever thread sees the PLAY complete logs its
+   line (Log::printf, so the audio thread never blocks) and queues it for the
+   history. A PLAY still unheard after the timeout, or replaced by the next
+   PLAY, is recorded as not audible. The device's own output latency comes on
+   top of "audible" and is reported alongside. */
+
+class PlayLatency
+{
+public:
+    enum Stage { received, parsed, built, prepared, swapped, audible, numStages };
+
+    static constexpr const char* stageNames[numStages] = { "received", "parse", "build", "prepare", "swap", "first sound" };
+
+    static constexpr std::int64_t timeoutUs = 1000000;
+
+    struct Sample
+    {
+        std::int64_t us[numStages] {}; // 0 = never reached
+        double deviceLatencyMs = 0.0;
+
+        double stage_ms(int s) const
+        {
+            return us[s] > 0 && us[s - 1] > 0 ? static_cast<double>(us[s] - us[s - 1]) / 1000.0 : -1.0;
+        }
+
+        double total_ms() const
+        {
+            return us[audible] > 0 ? static_cast<double>(us[audible] - us[received]) / 1000.0 : -1.0;
+        }
+    };
+
+    static PlayLatency& get()
+    {
+        static PlayLatency p;
+        return p;
+    }
+
+    // ---- command thread ----
+    void begin(std::int64_t receivedUs) noexcept
+    {
+        settle(true);
+        {
+            std::lock_guard<std::mutex> lock(historyLock);
+            drain_completed();
+        }
+        current = Sample {};
+        current.us[received] = receivedUs;
+        active = true;
+    }
+
+    // No-op outside a measured PLAY (e.g. offline renders share the parser)
+    void mark(Stage s) noexcept
+    {
+        if (!active)
+            return;
+        current.us[s] = Tracer::nowUs();
+        if (s == built)
+        {
+            // Nodes only run once the rebuild has swapped them in, so listening
+            // from here on can't see the old graph
+            swappedUs.store(0, std::memory_order_relaxed);
+            audibleUs.store(0, std::memory_order_relaxed);
+            listening.store(true, std::memory_order_release);
+        }
+    }
+
+    // Hands the PLAY over to the audio thread; doesn't wait for it to be heard
+    void finish() noexcept
+    {
+        active = false;
+        state.store(pending, std::memory_order_release);
+        if (audibleUs.load(std::memory_order_acquire) != 0)
+            complete(); // heard before the rebuild even returned
+    }
+
+    // ---- audio thread ----
+    // Any node processing while listening belongs to the new graph
+    void node_processed() noexcept
+    {
+        if (!listening.load(std::memory_order_relaxed) || swappedUs.load(std::memory_order_relaxed) != 0)
+            return;
+        swappedUs.store(Tracer::nowUs(), std::memory_order_release);
+    }
+
+    void output_block(const float* const* out, int numChannels, int numSamples) noexcept
+    {
+        if (!listening.load(std::memory_order_acquire) || swappedUs.load(std::memory_order_relaxed) == 0
+            || audibleUs.load(std::memory_order_relaxed) != 0)
+            return;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (out[ch] == nullptr)
+                continue;
+            for (int i = 0; i < numSamples; ++i)
+            {
+                if (std::abs(out[ch][i]) > silenceThreshold)
+                {
+                    audibleUs.store(Tracer::nowUs(), std::memory_order_release);
+                    if (state.load(std::memory_order_acquire) == pending)
+                        complete();
+                    return;
+                }
+            }
+        }
+    }
+
+    // Set when the device starts: its reported output latency plus one buffer
+    void set_device_latency_ms(double ms) noexcept { deviceLatencyMs.store(ms, std::memory_order_relaxed); }
+
+    // ---- reporting ----
+    void set_slo_ms(double ms)
+    {
+        std::lock_guard<std::mutex> lock(historyLock);
+        drain_completed();
+        sloMs = ms;
+        overSlo = 0;
+        for (auto& s : history)
+            if (s.total_ms() < 0.0 || s.total_ms() > sloMs)
+                ++overSlo;
+    }
+
+    // One line, formatted without allocating (the audio thread logs it)
+    static void format_sample(const Sample& s, char* text, std::size_t size) noexcept
+    {
+        std::size_t used = 0;
+        auto append = [&](const char* format, auto... args) {
+            if (used < size)
+                used += static_cast<std::size_t>(juce::jmax(0, std::snprintf(text + used, size - used, format, args...)));
+        };
+        append("PLAY latency:");
+        for (int st = parsed; st < numStages; ++st)
+        {
+            const double ms = s.stage_ms(st);
+            if (ms < 0.0)
+                append(" %s -%s", stageNames[st], st + 1 < numStages ? "," : "");
+            else
+                append(" %s %.2f ms%s", stageNames[st], ms, st + 1 < numStages ? "," : "");
+        }
+        if (s.total_ms() >= 0.0)
+            append(" = %.2f ms (+%.1f ms device output)\n", s.total_ms(), s.deviceLatencyMs);
+        else
+            append(" = not audible within the timeout\n");
+    }
+
+    void print(std::ostream& os)
+    {
+        settle(false);
+        std::lock_guard<std::mutex> lock(historyLock);
+        drain_completed();
+        char text[160];
+        std::snprintf(text, sizeof(text), "PLAY latency:   %llu plays, %llu over the %.0f ms SLO (last %zu shown)\n",
+                      static_cast<unsigned long long>(plays), static_cast<unsigned long long>(overSlo),
+                      sloMs, history.size());
+        os << text;
+        if (history.empty())
+            return;
+
+        for (int st = parsed; st <= numStages; ++st)
+        {
+            auto values = collect(st);
+            if (values.empty())
+                continue;
+            std::snprintf(text, sizeof(text), "  %-12s p50 %7.2f ms  p95 %7.2f ms  max %7.2f ms\n",
+                          st == numStages ? "total" : stageNames[st],
+                          quantile(values, 0.5), quantile(values, 0.95), values.back());
+            os << text;
+        }
+    }
+
+    void write_prometheus(std::ostream& os)
+    {
+        settle(false);
+        std::lock_guard<std::mutex> lock(historyLock);
+        drain_completed();
+        os << "# HELP textgraph_play_latency_seconds Time from PLAY to the first audible block, by stage (recent plays).\n"
+           << "# TYPE textgraph_play_latency_seconds summary\n";
+        for (int st = parsed; st <= numStages; ++st)
+        {
+            auto values = collect(st);
+            const char* stage = st == numStages ? "total" : stageNames[st];
+            for (double q : { 0.5, 0.95 })
+                os << "textgraph_play_latency_seconds{stage=\"" << stage << "\",quantile=\"" << q << "\"} "
+                   << (values.empty() ? 0.0 : quantile(values, q) / 1000.0) << '\n';
+        }
+        os << "# HELP textgraph_play_over_slo_total PLAYs that took longer than the SLO or never became audible.\n"
+           << "# TYPE textgraph_play_over_slo_total counter\n"
+           << "textgraph_play_over_slo_total " << overSlo << '\n';
+    }
+
+private:
+    enum State { idle, pending, completing };
+
+    // The one thread that wins the pending -> completing swap records the
+    // PLAY; the command thread may only reuse `current` once it is idle again
+    void complete() noexcept
+    {
+        int expected = pending;
+        if (!state.compare_exchange_strong(expected, completing, std::memory_order_acq_rel))
+            return;
+
+        listening.store(false, std::memory_order_relaxed);
+        Sample done = current;
+        done.us[swapped] = swappedUs.load(std::memory_order_acquire);
+        done.us[audible] = audibleUs.load(std::memory_order_acquire);
+        done.deviceLatencyMs = deviceLatencyMs.load(std::memory_order_relaxed);
+
+        char text[Log::Record::maxText];
+        format_sample(done, text, sizeof(text));
+        Log::get().printf(Log::Level::info, "%s", text);
+        completed.try_push(done); // drained at every PLAY, so never full
+        state.store(idle, std::memory_order_release);
+    }
+
+    // Command thread: gives up on a PLAY that wasn't heard in time (or, when
+    // the next PLAY replaces it, at once) and waits out one being recorded
+    void settle(bool replace) noexcept
+    {
+        if (state.load(std::memory_order_acquire) == pending
+            && (replace || Tracer::nowUs() - current.us[received] > timeoutUs))
+            complete();
+        while (state.load(std::memory_order_acquire) == completing)
+            std::this_thread::yield();
+    }
+
+    // Moves what the audio thread recorded into the history (historyLock held)
+    void drain_completed()
+    {
+        Sample s;
+        while (completed.try_pop(s))
+        {
+            if (history.size() == maxHistory)
+                history.erase(history.begin());
+            history.push_back(s);
+            ++plays;
+            if (s.total_ms() < 0.0 || s.total_ms() > sloMs)
+                ++overSlo;
+        }
+    }
+
+    static constexpr std::size_t maxHistory = 256;
+    static constexpr float silenceThreshold = 1.0e-4f; // -80 dBFS
+
+    // Sorted milliseconds for one stage (numStages = total) over the history
+    std::vector<double> collect(int stage) const
+    {
+        std::vector<double> values;
+        for (auto& s : history)
+        {
+            const double ms = stage == numStages ? s.total_ms() : s.stage_ms(stage);
+            if (ms >= 0.0)
+                values.push_back(ms);
+        }
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+
+    static double quantile(const std::vector<double>& sorted, double q)
+    {
+        const auto index = static_cast<std::size_t>(std::ceil(q * static_cast<double>(sorted.size()))) - 1;
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    // Command thread only
+    Sample current;
+    bool active = false;
+
+    std::atomic<int> state { idle };
+    std::atomic<bool> listening { false };
+    std::atomic<std::int64_t> swappedUs { 0 };
+    std::atomic<std::int64_t> audibleUs { 0 };
+    std::atomic<double> deviceLatencyMs { 0.0 };
+
+    LockFreeRing<Sample, 64> completed;
+    std::mutex historyLock;
+    std::vector<Sample> history;
+    std::uint64_t plays = 0;
+    std::uint64_t overSlo = 0;
+    double sloMs = 50.0;
+};
+
+#endif
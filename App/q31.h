@@ -0,0 +1,462 @@
+#ifndef Q31_H
+#define Q31_H
+
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+/* Fixed-point DSP for boards without fast double arithmetic. Samples are Q31
+   (int32, full scale = 1.0) and every operation saturates instead of
+   wrapping. Built with -DFixedPointEngine=ON (TEXTGRAPH_FIXED_POINT), the
+   oscillators, their gain, the filter and the delay do their arithmetic with
+   the classes below instead of juce::dsp's. Each class takes the subset of the
+   juce::dsp interface the processors use, so the processors only pick a type.
+
+   The graph between nodes is still JUCE's and carries doubles, so a node
+   converts its input once and its output once per sample, and nothing in
+   between: an oscillator and its gain run as one Q31 pass (Oscillator::
+   process with a Gain) and write doubles only at the end; the filter and the
+   delay are the only stage in their nodes. Everything in between (phase
+   accumulation, table interpolation, gain ramps, the biquad, delay feedback)
+   is integer. That double <-> Q31 step at every node is the cost this build
+   still pays per sample, until the graph itself carries Q31. The noise voice
+   converts twice (into the block, then through Gain::process). Pulse
+   sequencing is integer sample counting in both builds.
+
+   --q31-check (q31_check.h) runs each of them next to its juce::dsp
+   counterpart and holds the difference to a stated bound. */
+
+namespace q31
+{
+
+using sample = std::int32_t;
+
+constexpr double fullScale = 2147483648.0; // 2^31
+
+inline sample saturate(std::int64_t x) noexcept
+{
+    return static_cast<sample>(juce::jlimit<std::int64_t>(std::numeric_limits<sample>::min(),
+                                                          std::numeric_limits<sample>::max(), x));
+}
+
+inline sample add(sample a, sample b) noexcept { return saturate(static_cast<std::int64_t>(a) + b); }
+
+// Q31 x Q31, rounded to nearest; -1 x -1 saturates to just under 1
+inline sample mul(sample a, sample b) noexcept
+{
+    return saturate((static_cast<std::int64_t>(a) * b + (std::int64_t { 1 } << 30)) >> 31);
+}
+
+// a + frac x (b - a), with the difference kept in 64 bits so a full-scale jump can't clip
+inline sample lerp(sample a, sample b, sample frac) noexcept
+{
+    return saturate(a + ((static_cast<std::int64_t>(frac) * (static_cast<std::int64_t>(b) - a)) >> 31));
+}
+
+// The only conversions, used at process() boundaries and for control values
+inline sample from_double(double x) noexcept
+{
+    const double scaled = std::round(x * fullScale);
+    if (scaled >= fullScale) return std::numeric_limits<sample>::max();
+    if (scaled < -fullScale) return std::numeric_limits<sample>::min();
+    return static_cast<sample>(scaled);
+}
+
+inline double to_double(sample x) noexcept { return x / fullScale; }
+
+// dst += src, saturating: what summing two connections into one input does
+inline void mix(sample* dst, const sample* src, int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = add(dst[i], src[i]);
+}
+
+// Wavetable oscillator with a 32-bit phase accumulator, standing in for
+// juce::dsp::Oscillator<double>: the same table points (numPoints over
+// [-pi, pi], linearly interpolated), the same 50 ms linear frequency glide
+class Oscillator
+{
+public:
+    void initialise(const std::function<double(double)>& function, std::size_t numPoints = 0)
+    {
+        points = juce::jmax<std::size_t>(2, numPoints);
+        table.resize(points + 1);
+        const double pi = juce::MathConstants<double>::pi;
+        for (std::size_t i = 0; i < points; ++i)
+            table[i] = from_double(function(-pi + 2.0 * pi * static_cast<double>(i) / static_cast<double>(points - 1)));
+        table[points] = table[points - 1];
+    }
+
+    void setFrequency(double hz, bool force = false) noexcept
+    {
+        if (!force && hz == targetHz)
+            return; // a glide already under way carries on
+        target = increment_for(hz);
+        targetHz = hz;
+        if (force || rampLength == 0)
+        {
+            current = target;
+            rampLeft = 0;
+        }
+        else
+        {
+            step = (target - current) / rampLength;
+            rampLeft = rampLength;
+        }
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        rampLength = static_cast<std::int64_t>(0.05 * sampleRate);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        phase = 0;
+        current = target = increment_for(targetHz);
+        rampLeft = 0;
+    }
+
+    // Same waveform on every channel, like the JUCE oscillator in a replacing context
+    template<typename Context>
+    void process(const Context& context) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numSamples = block.getNumSamples();
+        if (context.isBypassed)
+        {
+            skip(numSamples);
+            block.clear();
+            return;
+        }
+        double* first = block.getChannelPointer(0);
+        for (std::size_t i = 0; i < numSamples; ++i)
+            first[i] = to_double(next());
+        for (std::size_t ch = 1; ch < block.getNumChannels(); ++ch)
+            std::copy(first, first + numSamples, block.getChannelPointer(ch));
+    }
+
+    // The waveform through a gain ramp without leaving Q31: the same samples
+    // as process() then gain.process(), converted to double once
+    template<typename Context, typename GainType>
+    void process(const Context& context, GainType& gain) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numSamples = block.getNumSamples();
+        if (context.isBypassed)
+        {
+            skip(numSamples);
+            gain.skip(static_cast<std::int64_t>(numSamples));
+            block.clear();
+            return;
+        }
+        double* first = block.getChannelPointer(0);
+        for (std::size_t i = 0; i < numSamples; ++i)
+        {
+            const sample g = gain.next();
+            first[i] = to_double(mul(next(), g));
+        }
+        for (std::size_t ch = 1; ch < block.getNumChannels(); ++ch)
+            std::copy(first, first + numSamples, block.getChannelPointer(ch));
+    }
+
+    sample next() noexcept
+    {
+        // phase 0 is -pi; scaled by the number of intervals, the top bits are
+        // the table index and the rest the position between two points
+        const std::uint64_t position = static_cast<std::uint64_t>(phase) * (points - 1);
+        const auto index = static_cast<std::size_t>(position >> 32);
+        const auto frac = static_cast<sample>((position & 0xffffffffu) >> 1);
+        const sample a = table[index], b = table[index + 1];
+        const sample out = lerp(a, b, frac);
+
+        if (rampLeft > 0)
+        {
+            current += step;
+            if (--rampLeft == 0)
+                current = target;
+        }
+        phase += static_cast<std::uint32_t>(current >> 16);
+        return out;
+    }
+
+    // Where next() would leave the phase after n samples; integer adds wrap
+    // the same way in one multiply as in n steps
+    void skip(std::size_t n) noexcept
+    {
+        for (; n > 0 && rampLeft > 0; --n)
+        {
+            current += step;
+            if (--rampLeft == 0)
+                current = target;
+            phase += static_cast<std::uint32_t>(current >> 16);
+        }
+        phase += static_cast<std::uint32_t>(static_cast<std::uint64_t>(current >> 16) * n);
+    }
+
+private:
+    // Cycles per sample, in 16.48 fixed point so a glide's step doesn't round to nothing
+    std::int64_t increment_for(double hz) const noexcept
+    {
+        return sampleRate > 0.0 ? static_cast<std::int64_t>(std::llround(hz / sampleRate * 281474976710656.0)) : 0;
+    }
+
+    std::vector<sample> table;
+    std::size_t points = 2;
+    double sampleRate = 0.0;
+    double targetHz = 0.0;
+    std::uint32_t phase = 0;
+    std::int64_t current = 0, target = 0, step = 0;
+    std::int64_t rampLength = 0, rampLeft = 0;
+};
+
+// Linear gain ramp, standing in for juce::dsp::Gain<double>
+class Gain
+{
+public:
+    void setGainLinear(double g) noexcept
+    {
+        const auto newTarget = static_cast<std::int64_t>(from_double(juce::jlimit(-1.0, 1.0, g))) * 65536;
+        if (newTarget == target)
+            return;
+        target = newTarget;
+        if (rampLength <= 0)
+        {
+            current = target;
+            rampLeft = 0;
+            return;
+        }
+        step = (target - current) / rampLength;
+        rampLeft = step != 0 ? rampLength : 0;
+        if (rampLeft == 0)
+            current = target;
+    }
+
+    void setRampDurationSeconds(double seconds) noexcept
+    {
+        if (seconds == rampSeconds)
+            return;
+        rampSeconds = seconds;
+        reset();
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec) noexcept
+    {
+        sampleRate = spec.sampleRate;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        rampLength = static_cast<std::int64_t>(std::floor(rampSeconds * sampleRate));
+        current = target;
+        rampLeft = 0;
+    }
+
+    bool isSmoothing() const noexcept { return rampLeft > 0; }
+
+    template<typename Context>
+    void process(const Context& context) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numChannels = block.getNumChannels();
+        if (context.isBypassed)
+        {
+            // Like juce::dsp::Gain: the ramp moves on, the samples stay as they are
+            skip(static_cast<std::int64_t>(block.getNumSamples()));
+            return;
+        }
+        for (std::size_t i = 0; i < block.getNumSamples(); ++i)
+        {
+            const sample g = next();
+            for (std::size_t ch = 0; ch < numChannels; ++ch)
+            {
+                double& s = block.getChannelPointer(ch)[i];
+                s = to_double(mul(from_double(s), g));
+            }
+        }
+    }
+
+    // The gain for the next sample, moving the ramp on by one
+    sample next() noexcept
+    {
+        if (rampLeft > 0)
+        {
+            current += step;
+            if (--rampLeft == 0)
+                current = target;
+        }
+        return static_cast<sample>(current >> 16);
+    }
+
+    void skip(std::int64_t n) noexcept
+    {
+        if (rampLeft > 0)
+        {
+            const auto steps = std::min(n, rampLeft);
+            current += step * steps;
+            rampLeft -= steps;
+            if (rampLeft == 0)
+                current = target;
+        }
+    }
+
+private:
+    double sampleRate = 0.0;
+    double rampSeconds = 0.0;
+    std::int64_t current = 0, target = 0, step = 0; // Q31 with 16 extra fraction bits
+    std::int64_t rampLength = 0, rampLeft = 0;
+};
+
+/* Biquad per channel, standing in for a ProcessorDuplicator of
+   juce::dsp::IIR::Filter<double>. Direct form I with Q2.29 coefficients (so
+   |a1| up to 4 fits) and a 64-bit accumulator; the part of each result that
+   rounding drops is fed into the next sample (first-order error feedback),
+   which keeps the noise of a low cutoff near the Q31 floor instead of
+   amplifying it by the filter's DC gain. */
+class Biquad
+{
+public:
+    // {b0, b1, b2, a0, a1, a2}, as juce::dsp::IIR::ArrayCoefficients makes them
+    void set_coefficients(const std::array<double, 6>& c) noexcept
+    {
+        const double a0 = c[3];
+        const auto q = [a0](double v) { return static_cast<std::int32_t>(std::llround(v / a0 * coefficientScale)); };
+        b0 = q(c[0]); b1 = q(c[1]); b2 = q(c[2]); a1 = q(c[4]); a2 = q(c[5]);
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        state.assign(spec.numChannels, State {});
+    }
+
+    void reset() noexcept
+    {
+        std::fill(state.begin(), state.end(), State {});
+    }
+
+    void reset_channel(int channel) noexcept
+    {
+        if (static_cast<std::size_t>(channel) < state.size())
+            state[static_cast<std::size_t>(channel)] = State {};
+    }
+
+    template<typename Context>
+    void process(const Context& context) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numChannels = juce::jmin(block.getNumChannels(), state.size());
+        for (std::size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto& s = state[ch];
+            double* data = block.getChannelPointer(ch);
+            for (std::size_t i = 0; i < block.getNumSamples(); ++i)
+            {
+                const sample x = from_double(data[i]);
+                const std::int64_t acc = static_cast<std::int64_t>(b0) * x + static_cast<std::int64_t>(b1) * s.x1
+                                       + static_cast<std::int64_t>(b2) * s.x2 - static_cast<std::int64_t>(a1) * s.y1
+                                       - static_cast<std::int64_t>(a2) * s.y2 + s.error;
+                const sample y = saturate(acc >> coefficientBits);
+                s.error = acc - (static_cast<std::int64_t>(y) << coefficientBits);
+                s.x2 = s.x1; s.x1 = x;
+                s.y2 = s.y1; s.y1 = y;
+                data[i] = to_double(y);
+            }
+        }
+    }
+
+private:
+    static constexpr int coefficientBits = 29;
+    static constexpr double coefficientScale = 536870912.0; // 2^29
+
+    struct State
+    {
+        sample x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        std::int64_t error = 0;
+    };
+
+    std::int32_t b0 = 0, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    std::vector<State> state;
+};
+
+// Linearly interpolating delay line, standing in for juce::dsp::DelayLine<double,
+// Linear> with the same read/write conventions; holds Q31 samples
+class DelayLine
+{
+public:
+    using SampleType = sample;
+
+    DelayLine() : DelayLine(0) {}
+    explicit DelayLine(int maximumDelayInSamples) { setMaximumDelayInSamples(maximumDelayInSamples); }
+
+    void setMaximumDelayInSamples(int maxDelay)
+    {
+        maximumDelay = juce::jmax(0, maxDelay);
+        totalSize = juce::jmax(4, maximumDelay + 2);
+        buffer.assign(static_cast<std::size_t>(totalSize) * juce::jmax<std::size_t>(1, channels), 0);
+    }
+
+    int getMaximumDelayInSamples() const noexcept { return maximumDelay; }
+
+    void setDelay(double newDelay) noexcept
+    {
+        const double d = juce::jlimit(0.0, static_cast<double>(maximumDelay), newDelay);
+        delayInt = static_cast<int>(std::floor(d));
+        delayFrac = from_double(d - delayInt);
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        channels = spec.numChannels;
+        buffer.assign(static_cast<std::size_t>(totalSize) * channels, 0);
+        positions.assign(channels, Position {});
+    }
+
+    void reset() noexcept
+    {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        std::fill(positions.begin(), positions.end(), Position {});
+    }
+
+    void pushSample(int channel, sample s) noexcept
+    {
+        auto& p = positions[static_cast<std::size_t>(channel)];
+        line(channel)[p.write] = s;
+        p.write = (p.write + totalSize - 1) % totalSize;
+    }
+
+    sample popSample(int channel) noexcept
+    {
+        auto& p = positions[static_cast<std::size_t>(channel)];
+        const sample* data = line(channel);
+        const int index1 = (p.read + delayInt) % totalSize;
+        const int index2 = (index1 + 1) % totalSize;
+        const sample a = data[index1], b = data[index2];
+        p.read = (p.read + totalSize - 1) % totalSize;
+        return lerp(a, b, delayFrac);
+    }
+
+private:
+    struct Position { int write = 0, read = 0; };
+
+    sample* line(int channel) noexcept { return buffer.data() + static_cast<std::size_t>(channel) * static_cast<std::size_t>(totalSize); }
+
+    std::vector<sample> buffer;
+    std::vector<Position> positions;
+    std::size_t channels = 1;
+    int maximumDelay = 0, totalSize = 4;
+    int delayInt = 0;
+    sample delayFrac = 0;
+};
+
+} // namespace q31
+
+#endif
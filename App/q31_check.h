@@ -0,0 +1,230 @@
+#ifndef Q31_CHECK_H
+#define Q31_CHECK_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "oscillators.h"
+#include "q31.h"
+
+/* --q31-check: runs each Q31 class from q31.h next to the juce::dsp processor
+   it replaces, on the same input and the same parameter changes, and fails if
+   the largest sample difference goes over the bound stated for it. Both sets
+   are compiled into every build, so this runs on any x86 Linux box whether or
+   not FixedPointEngine is on.
+
+   The bounds are the documented accuracy of the fixed-point engine, relative
+   to full scale (1.0):
+
+     oscillator + gain   1e-4    (5e-3 for square, whose jump lands between
+                                  table points at a slightly different phase)
+     low-pass filter     1e-5    (2e-4 at a 20 Hz cutoff, where the poles sit
+                                  close enough to 1 to feel coefficient rounding)
+     delay + feedback    1e-8
+     saturating mix      1e-9    (against the double sum clipped to +-1)
+
+   Inputs stay below full scale; anything above it clips in the Q31 build.
+
+   Exit code: 0 all within bounds, 1 otherwise. */
+
+namespace q31_check
+{
+
+constexpr double sampleRate = 48000.0;
+constexpr int blockSize = 256;
+constexpr int numSamples = 2 * 48000;
+
+struct Result
+{
+    const char* name;
+    double maxError;
+    double bound;
+};
+
+// Runs fn(offset, n) over numSamples in blocks
+template<typename Fn>
+void for_each_block(Fn&& fn)
+{
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+        fn(offset, juce::jmin(blockSize, numSamples - offset));
+}
+
+inline double max_difference(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double e = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        e = juce::jmax(e, std::abs(a[i] - b[i]));
+    return e;
+}
+
+// Noise plus a slow sine, peaking around 0.8
+inline std::vector<double> test_input(juce::int64 seed)
+{
+    juce::Random random(seed);
+    std::vector<double> x(static_cast<std::size_t>(numSamples));
+    for (int i = 0; i < numSamples; ++i)
+        x[static_cast<std::size_t>(i)] = 0.5 * (random.nextDouble() * 2.0 - 1.0) + 0.3 * std::sin(i * 0.001);
+    return x;
+}
+
+// An oscillator into a gain, as OscillatorBase uses them: a glide from 440 to
+// 660 Hz halfway through and two gain changes
+template<typename Osc, typename Gain>
+std::vector<double> render_voice(const std::function<double(double)>& waveform)
+{
+    Osc osc;
+    Gain gain;
+    osc.initialise(waveform, 128);
+    const juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(blockSize), 1 };
+    osc.prepare(spec);
+    gain.prepare(spec);
+    gain.setRampDurationSeconds(0.005);
+    osc.setFrequency(440.0, true);
+    gain.setGainLinear(0.8);
+
+    std::vector<double> out(static_cast<std::size_t>(numSamples));
+    for_each_block([&](int offset, int n) {
+        if (offset == numSamples / 2)
+            osc.setFrequency(660.0);
+        if (offset == numSamples / 4)
+            gain.setGainLinear(0.3);
+        if (offset == 3 * numSamples / 4)
+            gain.setGainLinear(1.0);
+
+        double* channels[] = { out.data() + offset };
+        juce::dsp::AudioBlock<double> block(channels, 1, static_cast<std::size_t>(n));
+        juce::dsp::ProcessContextReplacing<double> context(block);
+        osc.process(context);
+        gain.process(context);
+    });
+    return out;
+}
+
+inline Result check_voice(const char* name, const std::function<double(double)>& waveform, double bound)
+{
+    const auto reference = render_voice<juce::dsp::Oscillator<double>, juce::dsp::Gain<double>>(waveform);
+    const auto fixed = render_voice<q31::Oscillator, q31::Gain>(waveform);
+    return { name, max_difference(reference, fixed), bound };
+}
+
+// FilterProcessor's low-pass at a fixed cutoff
+inline Result check_filter(const char* name, double cutoff, double bound)
+{
+    const auto input = test_input(1);
+    const auto coefficients = juce::dsp::IIR::ArrayCoefficients<double>::makeLowPass(sampleRate, cutoff);
+    const juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(blockSize), 1 };
+
+    juce::dsp::IIR::Filter<double> reference;
+    *reference.coefficients = coefficients;
+    reference.prepare(spec);
+    q31::Biquad fixed;
+    fixed.set_coefficients(coefficients);
+    fixed.prepare(spec);
+
+    auto a = input, b = input;
+    for_each_block([&](int offset, int n) {
+        double* pa[] = { a.data() + offset };
+        double* pb[] = { b.data() + offset };
+        juce::dsp::AudioBlock<double> blockA(pa, 1, static_cast<std::size_t>(n)), blockB(pb, 1, static_cast<std::size_t>(n));
+        reference.process(juce::dsp::ProcessContextReplacing<double>(blockA));
+        fixed.process(juce::dsp::ProcessContextReplacing<double>(blockB));
+    });
+    return { name, max_difference(a, b), bound };
+}
+
+// DelayProcessor's loop: fractional delay, feedback 0.5, dry 1.0, wet 0.5
+inline Result check_delay(double bound)
+{
+    const auto input = test_input(2);
+    constexpr double delay = 12000.37, feedback = 0.5, wet = 0.5, dry = 1.0;
+    const juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(blockSize), 1 };
+
+    juce::dsp::DelayLine<double, juce::dsp::DelayLineInterpolationTypes::Linear> reference(static_cast<int>(sampleRate * 2.0));
+    reference.prepare(spec);
+    reference.setDelay(delay);
+    q31::DelayLine fixed(static_cast<int>(sampleRate * 2.0));
+    fixed.prepare(spec);
+    fixed.setDelay(delay);
+
+    const q31::sample dryQ = q31::from_double(dry), wetQ = q31::from_double(wet), feedbackQ = q31::from_double(feedback);
+    double e = 0.0;
+    for (double x : input)
+    {
+        const double delayed = reference.popSample(0);
+        reference.pushSample(0, x + delayed * feedback);
+        const double expected = x * dry + delayed * wet;
+
+        const q31::sample xq = q31::from_double(x);
+        const q31::sample delayedQ = fixed.popSample(0);
+        fixed.pushSample(0, q31::add(xq, q31::mul(delayedQ, feedbackQ)));
+        const double actual = q31::to_double(q31::add(q31::mul(xq, dryQ), q31::mul(delayedQ, wetQ)));
+
+        e = juce::jmax(e, std::abs(expected - actual));
+    }
+    return { "delay + feedback", e, bound };
+}
+
+// Two loud signals summed: the double sum clipped to full scale is what the
+// saturating add has to produce
+inline Result check_mix(double bound)
+{
+    const auto a = test_input(3), b = test_input(4);
+    std::vector<q31::sample> dst(a.size()), src(b.size());
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        dst[i] = q31::from_double(a[i]);
+        src[i] = q31::from_double(b[i]);
+    }
+    q31::mix(dst.data(), src.data(), static_cast<int>(dst.size()));
+
+    double e = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        e = juce::jmax(e, std::abs(juce::jlimit(-1.0, 1.0, a[i] + b[i]) - q31::to_double(dst[i])));
+    return { "saturating mix", e, bound };
+}
+
+inline int run_check()
+{
+    constexpr double pi = juce::MathConstants<double>::pi;
+    const std::vector<Result> results {
+        check_voice("sin + gain", [](double p) { return std::sin(p); }, 1e-4),
+        check_voice("saw + gain", [](double p) { return p / pi; }, 1e-4),
+        check_voice("triangle + gain", [](double p) { return triangleBL(p); }, 1e-4),
+        check_voice("square + gain", [](double p) { return p < 0 ? 1.0 : -1.0; }, 5e-3),
+        check_filter("low-pass 20 Hz", 20.0, 2e-4),
+        check_filter("low-pass 100 Hz", 100.0, 1e-5),
+        check_filter("low-pass 1 kHz", 1000.0, 1e-5),
+        check_filter("low-pass 8 kHz", 8000.0, 1e-5),
+        check_delay(1e-8),
+        check_mix(1e-9),
+    };
+
+    std::cout << "Q31 against juce::dsp, " << numSamples / sampleRate << " s at " << sampleRate << " Hz"
+#if TEXTGRAPH_FIXED_POINT
+              << " (this build plays the Q31 engine)"
+#endif
+              << '\n';
+
+    bool ok = true;
+    for (const auto& r : results)
+    {
+        const bool pass = r.maxError <= r.bound;
+        ok = ok && pass;
+        char text[128];
+        std::snprintf(text, sizeof(text), "  %-18s max error %9.3g   bound %7.0e   %s\n",
+                      r.name, r.maxError, r.bound, pass ? "ok" : "FAIL");
+        std::cout << text;
+    }
+    std::cout << (ok ? "All within bounds\n" : "Out of bounds\n");
+    return ok ? 0 : 1;
+}
+
+} // namespace q31_check
+
+#endif
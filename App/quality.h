@@ -0,0 +1,215 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#include "logger.h"
+
+/* Adaptive quality under CPU pressure. After every device callback the
+   watchdog compares the time it took against the buffer's duration and, when
+   the load gets close to the deadline, steps the engine down a tier; once the
+   load has stayed low for a while it steps back up. Losing a little fidelity
+   is better than a dropout.
+
+     0 full          everything as written
+     1 mono reverb   reverbs run one tank on the summed input instead of two
+     2 mono effects  filters and delays process one channel and copy it;
+                     voices render once for both channels
+     3 reverb off    reverbs fade to their dry signal and stop processing
+
+   Degrading is quick (one tier per 200 ms while overloaded, at once on a
+   callback over 95%); recovering needs the smoothed load under 50% for 3 s,
+   and that wait doubles (up to a minute) each time a recovery is followed by
+   another overload within 5 s, so the engine doesn't flap between two tiers.
+   Every transition goes to the log. Processors read the tier once per block. */
+
+class QualityWatchdog
+{
+public:
+    enum Tier { full, monoReverb, monoEffects, reverbOff, numTiers };
+
+    static constexpr const char* tierNames[numTiers] = { "full", "mono reverb", "mono effects", "reverb off" };
+
+    static QualityWatchdog& get()
+    {
+        static QualityWatchdog w;
+        return w;
+    }
+
+    // What processors consult
+    static int tier() noexcept { return get().current.load(std::memory_order_relaxed); }
+
+    // ---- audio thread, once per callback ----
+    void observe(double seconds, int numSamples, double sampleRate) noexcept
+    {
+        if (numSamples <= 0 || sampleRate <= 0.0)
+            return;
+
+        const double duration = numSamples / sampleRate;
+        const double load = seconds / duration;
+        const int t = current.load(std::memory_order_relaxed);
+        samplesInTier[static_cast<std::size_t>(t)].fetch_add(static_cast<std::uint64_t>(numSamples),
+                                                              std::memory_order_relaxed);
+
+        smoothed += 0.3 * (load - smoothed);
+        now += duration;
+        if (pinned.load(std::memory_order_relaxed) >= 0)
+            return;
+
+        if ((load > panicLoad || smoothed > degradeLoad) && now - lastChange >= degradeHold && t + 1 < numTiers)
+        {
+            // Overloaded again right after recovering: wait longer next time
+            if (now - lastRecovery < flapWindow)
+                recoverDwell = juce::jmin(maxRecoverDwell, 2.0 * recoverDwell);
+            change(t + 1, load, "overload");
+            calmFor = 0.0;
+        }
+        else if (smoothed < recoverLoad && t > 0)
+        {
+            calmFor += duration;
+            if (calmFor >= recoverDwell)
+            {
+                change(t - 1, load, "recovered");
+                lastRecovery = now;
+                calmFor = 0.0;
+            }
+        }
+        else
+        {
+            calmFor = 0.0;
+        }
+
+        if (now - lastChange > stableReset)
+            recoverDwell = baseRecoverDwell;
+    }
+
+    // ---- command thread ----
+    // QUALITY AUTO lets the watchdog choose again; QUALITY <tier> holds a tier
+    void set_automatic()
+    {
+        pinned.store(-1, std::memory_order_relaxed);
+    }
+
+    void pin(int t)
+    {
+        t = juce::jlimit(0, numTiers - 1, t);
+        pinned.store(t, std::memory_order_relaxed);
+        if (current.exchange(t, std::memory_order_relaxed) != t)
+        {
+            transitions.fetch_add(1, std::memory_order_relaxed);
+            Log::get().printf(Log::Level::warning, "[quality] tier %d (%s), set by hand\n", t, tierNames[t]);
+        }
+    }
+
+    bool is_automatic() const { return pinned.load(std::memory_order_relaxed) < 0; }
+
+    void print(std::ostream& os) const
+    {
+        const int t = current.load(std::memory_order_relaxed);
+        std::uint64_t total = 0;
+        for (auto& s : samplesInTier)
+            total += s.load(std::memory_order_relaxed);
+
+        char text[160];
+        std::snprintf(text, sizeof(text), "Quality:        tier %d (%s, %s), %llu transitions\n", t, tierNames[t],
+                      is_automatic() ? "automatic" : "held", static_cast<unsigned long long>(transitions.load()));
+        os << text;
+        if (total == 0)
+            return;
+        os << "                ";
+        for (int i = 0; i < numTiers; ++i)
+        {
+            std::snprintf(text, sizeof(text), "%s %.1f%%%s", tierNames[i],
+                          100.0 * static_cast<double>(samplesInTier[static_cast<std::size_t>(i)].load()) / static_cast<double>(total),
+                          i + 1 < numTiers ? ", " : " of the time\n");
+            os << text;
+        }
+    }
+
+    void write_prometheus(std::ostream& os) const
+    {
+        os << "# HELP textgraph_quality_tier Current degradation tier (0 = full quality).\n"
+           << "# TYPE textgraph_quality_tier gauge\n"
+           << "textgraph_quality_tier " << current.load(std::memory_order_relaxed) << '\n'
+           << "# HELP textgraph_quality_transitions_total Tier changes since start.\n"
+           << "# TYPE textgraph_quality_transitions_total counter\n"
+           << "textgraph_quality_transitions_total " << transitions.load(std::memory_order_relaxed) << '\n';
+    }
+
+private:
+    static constexpr double panicLoad = 0.95;
+    static constexpr double degradeLoad = 0.8;
+    static constexpr double recoverLoad = 0.5;
+    static constexpr double degradeHold = 0.2;       // seconds between downward steps
+    static constexpr double baseRecoverDwell = 3.0;  // seconds of calm before stepping up
+    static constexpr double maxRecoverDwell = 60.0;
+    static constexpr double flapWindow = 5.0;
+    static constexpr double stableReset = 60.0;      // calm this long forgets past flapping
+
+    QualityWatchdog() = default;
+
+    void change(int to, double load, const char* why) noexcept
+    {
+        const int from = current.exchange(to, std::memory_order_relaxed);
+        lastChange = now;
+        transitions.fetch_add(1, std::memory_order_relaxed);
+        Log::get().printf(Log::Level::warning,
+                          "[quality] %s: tier %d (%s) -> %d (%s), load %.0f%% now, %.0f%% smoothed\n",
+                          why, from, tierNames[from], to, tierNames[to], 100.0 * load, 100.0 * smoothed);
+    }
+
+    std::atomic<int> current { full };
+    std::atomic<int> pinned { -1 };
+    std::atomic<std::uint64_t> transitions { 0 };
+    std::array<std::atomic<std::uint64_t>, numTiers> samplesInTier {};
+
+    // Audio thread only
+    double smoothed = 0.0;
+    double now = 0.0;          // seconds of audio seen
+    double lastChange = -1.0e9;
+    double lastRecovery = -1.0e9;
+    double calmFor = 0.0;
+    double recoverDwell = baseRecoverDwell;
+};
+
+// Helpers for the mono tiers: fold every channel into the first, and back out
+namespace quality
+{
+inline void sum_to_first_channel(juce::AudioBuffer<double>& buffer) noexcept
+{
+    const int numChannels = buffer.getNumChannels();
+    if (numChannels < 2)
+        return;
+    for (int ch = 1; ch < numChannels; ++ch)
+        buffer.addFrom(0, 0, buffer, ch, 0, buffer.getNumSamples());
+    buffer.applyGain(0, 0, buffer.getNumSamples(), 1.0 / numChannels);
+}
+
+inline void copy_first_channel(juce::AudioBuffer<double>& buffer) noexcept
+{
+    for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+        buffer.copyFrom(ch, 0, buffer, 0, 0, buffer.getNumSamples());
+}
+
+// The first block after a mono tier: the other channels go from the copy of
+// the first (what was heard) to their own output across the block
+inline void fade_from_first_channel(juce::AudioBuffer<double>& buffer) noexcept
+{
+    const int n = buffer.getNumSamples();
+    const double* first = buffer.getReadPointer(0);
+    for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+    {
+        double* own = buffer.getWritePointer(ch);
+        for (int i = 0; i < n; ++i)
+            own[i] = first[i] + (own[i] - first[i]) * (i + 1) / n;
+    }
+}
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef QUANTUM_H
+#define QUANTUM_H
+
+#include <algorithm>
+
+/* Fixed internal processing quantum. Splitting a big device block into short
+   runs of the whole graph keeps every node's intermediate buffers small enough
+   to stay in L1/L2 between one node and the next; at 2048 samples a stereo
+   double buffer alone is 32 KiB, the size of a typical L1D.
+
+   0 means "no quantum": process the block as delivered. */
+
+static constexpr int defaultQuantum = 64;
+
+// Calls fn(offset, length) over [0, numSamples) in pieces of at most quantum
+template<typename Fn>
+inline void for_each_quantum(int numSamples, int quantum, Fn&& fn)
+{
+    if (quantum <= 0 || quantum >= numSamples)
+    {
+        fn(0, numSamples);
+        return;
+    }
+
+    for (int offset = 0; offset < numSamples; offset += quantum)
+        fn(offset, std::min(quantum, numSamples - offset));
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef QUANTUM_BENCH_H
+#define QUANTUM_BENCH_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "offline_render.h"
+#include "perf_counters.h"
+#include "quantum.h"
+#include "golden.h"
+#include "isa_dispatch.h"
+
+/* --quantum-bench: renders the same score offline with whole device-sized
+   blocks and with a fixed internal quantum, and compares throughput and cache
+   behaviour (hardware counters via perf_event_open where available).
+
+     ConsoleAppMessageThread --quantum-bench [score file] [--block 2048] [--quantum 64] [--seconds 20] */
+
+namespace quantum_bench
+{
+
+struct Options
+{
+    std::string file;
+    int block = 2048;
+    int quantum = defaultQuantum;
+    double seconds = 20.0;
+};
+
+// Dense enough that the per-node buffers of one block spill out of L1
+inline std::vector<std::string> default_score()
+{
+    return { "SET a saw note 48", "SET b square note 55", "SET c triangle note 72", "SET d sin note 79",
+             "SET e noise", "SET f filter cutoff 1200", "SET r reverb size 0.6", "SET s delay time 0.25",
+             "\"abcf dbcs eabcdfrs abcdr cdes ebf\"", "PLAY" };
+}
+
+struct Result
+{
+    double wallSeconds = 0.0;
+    PerfCounters::Reading counters;
+};
+
+inline Result render_once(const std::vector<std::string>& lines, const Options& o, int quantum)
+{
+    RenderSettings settings;
+    settings.blockSize = o.block;
+    settings.quantum = quantum;
+    settings.randomBindings = false; // like --golden: scores bind what they use
+
+    OfflineEngine engine(settings);
+    for (auto& line : lines)
+        engine.command(line);
+
+    const int total = static_cast<int>(o.seconds * settings.sampleRate);
+    juce::AudioBuffer<double> out(2, o.block);
+
+    // One block to settle allocations and first-touch page faults
+    engine.render(out, 0, o.block);
+
+    PerfCounters counters;
+    const auto start = std::chrono::steady_clock::now();
+    counters.start();
+    for (int done = 0; done < total; done += o.block)
+        engine.render(out, 0, juce::jmin(o.block, total - done));
+    Result r;
+    r.counters = counters.stop();
+    r.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return r;
+}
+
+inline void print_result(const char* label, const Result& r, const Options& o, double sampleRate)
+{
+    const double samples = o.seconds * sampleRate;
+    char text[160];
+    std::snprintf(text, sizeof(text), "%-22s %8.1fx realtime  %7.1f ns/sample\n",
+                  label, o.seconds / r.wallSeconds, 1.0e9 * r.wallSeconds / samples);
+    std::cout << text;
+
+    auto& c = r.counters;
+    for (int i = 0; i < PerfCounters::numCounters; ++i)
+    {
+        if (!c.available[static_cast<std::size_t>(i)] || i == PerfCounters::taskClockNs)
+            continue;
+        std::snprintf(text, sizeof(text), "    %-18s %14.0f  (%.2f per sample)\n", PerfCounters::names[i],
+                      c.value[static_cast<std::size_t>(i)], c.value[static_cast<std::size_t>(i)] / samples);
+        std::cout << text;
+    }
+    if (c.available[PerfCounters::cycles] && c.available[PerfCounters::instructions])
+    {
+        std::snprintf(text, sizeof(text), "    %-18s %14.2f\n", "IPC",
+                      c.value[PerfCounters::instructions] / juce::jmax(1.0, c.value[PerfCounters::cycles]));
+        std::cout << text;
+    }
+    if (c.available[PerfCounters::cacheReferences] && c.available[PerfCounters::cacheMisses])
+    {
+        std::snprintf(text, sizeof(text), "    %-18s %13.2f%%\n", "cache miss rate",
+                      100.0 * c.value[PerfCounters::cacheMisses] / juce::jmax(1.0, c.value[PerfCounters::cacheReferences]));
+        std::cout << text;
+    }
+}
+
+inline int run(int argc, char* argv[])
+{
+    Options o;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if (arg == "--block")         o.block = std::atoi(next());
+        else if (arg == "--quantum")  o.quantum = std::atoi(next());
+        else if (arg == "--seconds")  o.seconds = std::atof(next());
+        else                          o.file = arg;
+    }
+    if (o.block <= 0 || o.quantum <= 0 || o.seconds <= 0.0)
+    {
+        std::cerr << "usage: --quantum-bench [score file] [--block <n>] [--quantum <n>] [--seconds <s>]\n";
+        return 2;
+    }
+
+    std::vector<std::string> lines = default_score();
+    if (!o.file.empty())
+    {
+        auto score = golden::load_score(o.file);
+        if (!score)
+        {
+            std::cerr << "Cannot open score file '" << o.file << "'\n";
+            return 2;
+        }
+        lines = score->lines;
+    }
+
+    std::cout << "Rendering " << o.seconds << " s in " << o.block << "-sample blocks, whole vs "
+              << o.quantum << "-sample quantum\n";
+    isa::print_report(std::cout); // --isa picks another variant to compare
+
+    const auto whole = render_once(lines, o, 0);
+    const auto quantised = render_once(lines, o, o.quantum);
+
+    print_result("whole blocks:", whole, o, RenderSettings {}.sampleRate);
+    print_result(("quantum " + std::to_string(o.quantum) + ":").c_str(), quantised, o, RenderSettings {}.sampleRate);
+
+    if (!PerfCounters().any_hardware())
+        std::cout << "(hardware counters unavailable here: check /proc/sys/kernel/perf_event_paranoid, "
+                     "or the VM may not expose a PMU; timings only)\n";
+    std::cout << "Speed-up from the quantum: " << whole.wallSeconds / quantised.wallSeconds << "x\n";
+    return 0;
+}
+
+} // namespace quantum_bench
+
+#endif
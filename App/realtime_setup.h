@@ -0,0 +1,360 @@
+#ifndef REALTIME_SETUP_H
+#define REALTIME_SETUP_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+ #define TEXTGRAPH_HAS_RT_SETUP 1
+#else
+ #define TEXTGRAPH_HAS_RT_SETUP 0
+#endif
+
+/* Scheduling and memory options for running close to the deadline (Linux).
+
+     priority   the audio thread runs SCHED_FIFO at this priority, worker
+                threads (log, trace and metrics writers) 10 below it; 0 gives
+                each thread back the scheduling it had before the first change
+     cores      CPUs the audio thread may run on; workers get the remaining
+                ones unless given their own list; "all" gives each thread back
+                the CPUs it had
+     mlock      mlockall(MCL_CURRENT | MCL_FUTURE): nothing the engine has
+                touched is paged out, and later allocations arrive resident
+     prefault   processors write every page of their buffers, delay lines and
+                reverb tanks while being prepared, and the audio thread its
+                stack, instead of faulting them in on the first blocks played
+
+   Settings are made on the command thread and bump a generation number; each
+   thread compares it against the one it last applied (a relaxed load per
+   callback or poll) and only then makes the syscalls, on itself. A thread the
+   audio device creates later picks the settings up on its first callback.
+   Only what was set is changed: while priority and cores are unset a thread
+   keeps whatever scheduling the device backend gave it (a real-time audio
+   thread stays real-time when only PREFAULT is switched on), and each thread
+   saves its policy and affinity before the first change to restore on OFF.
+   Failures (no CAP_SYS_NICE or rtprio limit, RLIMIT_MEMLOCK too low) are kept
+   per role and shown by REALTIME and STATS. */
+
+class RealtimeSetup
+{
+public:
+    enum class Role { audio, worker };
+
+    static RealtimeSetup& get()
+    {
+        static RealtimeSetup s;
+        return s;
+    }
+
+    static bool prefault() noexcept { return get().prefaultOn.load(std::memory_order_relaxed); }
+
+    static constexpr bool supported() { return TEXTGRAPH_HAS_RT_SETUP != 0; }
+
+    // ---- command thread ----
+    void set_priority(int p)
+    {
+        priority.store(juce::jlimit(0, maxPriority, p), std::memory_order_relaxed);
+        changed();
+    }
+
+    // Empty lists mean "any CPU"; an empty worker list means "the rest"
+    void set_cores(std::vector<int> audio, std::vector<int> workers = {})
+    {
+        {
+            const juce::SpinLock::ScopedLockType sl(coresLock);
+            audioCores = std::move(audio);
+            workerCores = std::move(workers);
+        }
+        changed();
+    }
+
+    // Returns 0 or the errno of the failed call
+    int lock_memory(bool on)
+    {
+        int err = 0;
+#if TEXTGRAPH_HAS_RT_SETUP
+        if ((on ? ::mlockall(MCL_CURRENT | MCL_FUTURE) : ::munlockall()) != 0)
+            err = errno;
+#else
+        err = on ? ENOSYS : 0;
+#endif
+        locked.store(on && err == 0, std::memory_order_relaxed);
+        return err;
+    }
+
+    void set_prefault(bool on) noexcept
+    {
+        prefaultOn.store(on, std::memory_order_relaxed);
+        changed(); // the audio thread prefaults its stack on its next callback
+    }
+
+    // --rt-priority <n> --rt-cores <list>[:<list>] --mlock --prefault, removed
+    // from args as they are recognised; false with a message on a bad value
+    bool parse_arguments(std::vector<std::string>& args, std::ostream& err)
+    {
+        for (std::size_t i = 0; i < args.size();)
+        {
+            const auto& a = args[i];
+            const bool takesValue = a == "--rt-priority" || a == "--rt-cores";
+            if (takesValue && i + 1 >= args.size())
+            {
+                err << a << " needs a value\n";
+                return false;
+            }
+
+            if (a == "--rt-priority")
+            {
+                set_priority(std::atoi(args[i + 1].c_str()));
+            }
+            else if (a == "--rt-cores")
+            {
+                if (!set_cores_from_text(args[i + 1]))
+                {
+                    err << "--rt-cores takes CPU numbers like 2,3 or 2-3:0-1 (audio:workers)\n";
+                    return false;
+                }
+            }
+            else if (a == "--mlock")
+            {
+                if (const int e = lock_memory(true); e != 0)
+                    err << "mlockall failed: " << std::strerror(e) << " (raise RLIMIT_MEMLOCK, ulimit -l)\n";
+            }
+            else if (a == "--prefault")
+            {
+                set_prefault(true);
+            }
+            else
+            {
+                ++i;
+                continue;
+            }
+            args.erase(args.begin() + static_cast<std::ptrdiff_t>(i),
+                       args.begin() + static_cast<std::ptrdiff_t>(i + (takesValue ? 2 : 1)));
+        }
+        return true;
+    }
+
+    // "2,3" or "2-3:0-1" (audio cores, then worker cores); "all" clears both
+    bool set_cores_from_text(const std::string& text)
+    {
+        if (text == "all")
+        {
+            set_cores({}, {});
+            return true;
+        }
+        const auto colon = text.find(':');
+        std::vector<int> audio, workers;
+        if (!parse_cpu_list(text.substr(0, colon), audio)
+            || (colon != std::string::npos && !parse_cpu_list(text.substr(colon + 1), workers)))
+            return false;
+        set_cores(std::move(audio), std::move(workers));
+        return true;
+    }
+
+    // ---- any thread, at the top of its callback or loop ----
+    void sync(Role role) noexcept
+    {
+        thread_local std::uint64_t applied = 0;
+        const auto g = generation.load(std::memory_order_acquire);
+        if (g != applied && apply_to_this_thread(role))
+            applied = g;
+    }
+
+    void print(std::ostream& os) const
+    {
+        const int p = priority.load(std::memory_order_relaxed);
+        os << "Real-time:      ";
+        if (!supported())
+        {
+            os << "not supported on this platform\n";
+            return;
+        }
+        if (p > 0)
+            os << "SCHED_FIFO " << p << " audio, " << juce::jmax(1, p - workerOffset) << " workers";
+        else
+            os << "normal scheduling";
+
+        {
+            const juce::SpinLock::ScopedLockType sl(coresLock);
+            if (!audioCores.empty())
+                os << "; audio on CPUs " << cpu_list_text(audioCores)
+                   << ", workers on " << (workerCores.empty() ? std::string("the rest") : cpu_list_text(workerCores));
+        }
+        os << "; memory " << (locked.load(std::memory_order_relaxed) ? "locked" : "not locked")
+           << "; prefault " << (prefault() ? "on" : "off") << '\n';
+
+        for (int r = 0; r < 2; ++r)
+            if (const int e = lastError[r].load(std::memory_order_relaxed); e != 0)
+                os << "                " << (r == 0 ? "audio" : "worker") << " thread setup failed: " << std::strerror(e)
+                   << (e == EPERM ? " (needs CAP_SYS_NICE or an rtprio limit, see ulimit -r)" : "") << '\n';
+    }
+
+private:
+    static constexpr int maxPriority = 98; // 99 is left to the kernel's own watchdogs
+    static constexpr int workerOffset = 10;
+    static constexpr std::size_t stackPrefaultBytes = 256 * 1024;
+
+    RealtimeSetup() = default;
+
+    void changed() noexcept { generation.fetch_add(1, std::memory_order_release); }
+
+    static bool parse_cpu_list(const std::string& text, std::vector<int>& out)
+    {
+        std::istringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            const auto dash = item.find('-');
+            const int first = std::atoi(item.substr(0, dash).c_str());
+            const int last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+            if (item.empty() || !std::isdigit(static_cast<unsigned char>(item[0])) || last < first || last > 1023)
+                return false;
+            for (int c = first; c <= last; ++c)
+                out.push_back(c);
+        }
+        return !out.empty();
+    }
+
+    static std::string cpu_list_text(const std::vector<int>& cpus)
+    {
+        std::string s;
+        for (auto c : cpus)
+            s += (s.empty() ? "" : ",") + std::to_string(c);
+        return s;
+    }
+
+    // Runs on the thread being set up; the only place that makes syscalls.
+    // False if the settings were being changed, to be tried again next time.
+    bool apply_to_this_thread(Role role) noexcept
+    {
+#if TEXTGRAPH_HAS_RT_SETUP
+        const int r = role == Role::audio ? 0 : 1;
+        int err = 0;
+
+        // What the thread had before this class first changed it
+        thread_local struct Original
+        {
+            bool saved = false, scheduled = false, pinned = false;
+            int policy = SCHED_OTHER;
+            sched_param param {};
+            cpu_set_t cpus {};
+        } original;
+        if (!original.saved)
+        {
+            original.saved = pthread_getschedparam(pthread_self(), &original.policy, &original.param) == 0
+                          && pthread_getaffinity_np(pthread_self(), sizeof(original.cpus), &original.cpus) == 0;
+            if (!original.saved)
+                return true; // nothing to restore to, so leave the thread as it is
+        }
+
+        const int p = priority.load(std::memory_order_relaxed);
+        if (p > 0)
+        {
+            sched_param param {};
+            param.sched_priority = role == Role::audio ? p : juce::jmax(1, p - workerOffset);
+            if (const int e = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); e != 0)
+                err = e;
+            else
+                original.scheduled = true;
+        }
+        else if (original.scheduled)
+        {
+            if (const int e = pthread_setschedparam(pthread_self(), original.policy, &original.param); e != 0)
+                err = e;
+            else
+                original.scheduled = false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        bool any = false;
+        {
+            const juce::SpinLock::ScopedTryLockType sl(coresLock);
+            if (!sl.isLocked())
+                return false;
+            const auto& own = role == Role::audio ? audioCores : workerCores;
+            for (auto c : own)
+                if (c < CPU_SETSIZE) { CPU_SET(c, &set); any = true; }
+
+            // Workers keep off the audio cores unless told otherwise
+            if (role == Role::worker && workerCores.empty() && !audioCores.empty())
+            {
+                const int n = static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+                for (int c = 0; c < n && c < CPU_SETSIZE; ++c)
+                    if (std::find(audioCores.begin(), audioCores.end(), c) == audioCores.end()) { CPU_SET(c, &set); any = true; }
+            }
+        }
+        if (any)
+        {
+            if (const int e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); e != 0 && err == 0)
+                err = e;
+            else if (e == 0)
+                original.pinned = true;
+        }
+        else if (original.pinned)
+        {
+            if (const int e = pthread_setaffinity_np(pthread_self(), sizeof(original.cpus), &original.cpus); e != 0 && err == 0)
+                err = e;
+            else if (e == 0)
+                original.pinned = false;
+        }
+
+        if (role == Role::audio && prefault())
+            touch_stack();
+
+        lastError[r].store(err, std::memory_order_relaxed);
+#else
+        juce::ignoreUnused(role);
+#endif
+        return true;
+    }
+
+    // Fault in the stack the callback will grow into while nothing is playing yet
+    static void touch_stack() noexcept
+    {
+        volatile char block[stackPrefaultBytes];
+        for (std::size_t i = 0; i < stackPrefaultBytes; i += 4096)
+            block[i] = 0;
+        juce::ignoreUnused(block);
+    }
+
+    std::atomic<std::uint64_t> generation { 0 };
+    std::atomic<int> priority { 0 };
+    std::atomic<bool> locked { false };
+    std::atomic<bool> prefaultOn { false };
+    std::atomic<int> lastError[2] {};
+
+    mutable juce::SpinLock coresLock;
+    std::vector<int> audioCores, workerCores;
+};
+
+// Writes every page of a buffer prepareToPlay just sized, when prefaulting is on.
+// AudioBuffer::clear() skips a buffer it believes is clear, so write through the pointers.
+namespace prefault
+{
+template<typename T>
+inline void touch(juce::AudioBuffer<T>& buffer) noexcept
+{
+    if (!RealtimeSetup::prefault())
+        return;
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        juce::FloatVectorOperations::clear(buffer.getWritePointer(ch), buffer.getNumSamples());
+}
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "isa_dispatch.h"
+
+/* Arbitrary-ratio polyphase resampler, for the fixed-rate engine's output
+   (FixedRateHost): input at the engine's rate, output at the device's.
+
+   The prototype is a Kaiser-windowed sinc, taps long at the input rate (more
+   when the output is slower, so the transition band stays as narrow in Hz),
+   with its band centred just below the lower Nyquist: flat to 19 kHz between
+   44.1 and 48 kHz and about 100 dB down from the lower Nyquist on. It's tabulated at `phases` fractional
+   positions; each output applies the two rows either side of its position
+   and interpolates, so any ratio works without a common multiple of the two
+   rates. The loop is isa::kernels().resample.
+
+   The caller writes input straight into the history (input(ch), after asking
+   input_needed how much), then process() produces the output and drops what
+   no later output can reach. */
+
+class OutputResampler
+{
+public:
+    static constexpr int phases = 256;
+    static constexpr int baseTaps = 64; // a multiple of isa::body::lanes
+
+    void prepare(double inputRate, double outputRate, int numChannels, int maxOutputBlock)
+    {
+        step = inputRate / outputRate;
+        taps = baseTaps * juce::jmax(1, static_cast<int>(std::ceil(step)));
+
+        // Band centre in cycles per input sample; the window's transition
+        // band, about 0.084 / (taps / 64) wide, ends at the lower Nyquist
+        constexpr double beta = 8.6;
+        const double cutoff = 0.458 * juce::jmin(1.0, 1.0 / step);
+        const double half = 0.5 * taps;
+        const double norm = std::cyl_bessel_i(0.0, beta);
+
+        table.assign(static_cast<std::size_t>((phases + 1) * taps), 0.0);
+        for (int p = 0; p <= phases; ++p)
+        {
+            double* row = table.data() + p * taps;
+            double sum = 0.0;
+            for (int j = 0; j < taps; ++j)
+            {
+                // Distance from the output position to the input sample this tap reads
+                const double x = static_cast<double>(p) / phases + half - 1.0 - j;
+                const double arg = juce::MathConstants<double>::pi * 2.0 * cutoff * x;
+                const double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(arg) / (juce::MathConstants<double>::pi * x);
+                const double r = x / half;
+                const double window = std::cyl_bessel_i(0.0, beta * std::sqrt(juce::jmax(0.0, 1.0 - r * r))) / norm;
+                row[j] = sinc * window;
+                sum += row[j];
+            }
+            // Unity gain at DC whatever the position
+            for (int j = 0; j < taps; ++j)
+                row[j] /= sum;
+        }
+
+        maxOut = juce::jmax(1, maxOutputBlock);
+        capacity = taps + static_cast<int>(std::ceil(maxOut * step)) + 4;
+        history.assign(static_cast<std::size_t>(numChannels), std::vector<double>(static_cast<std::size_t>(capacity), 0.0));
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& h : history)
+            std::fill(h.begin(), h.end(), 0.0);
+        // The first output sits on the first input, with zeros before it
+        position = 0.5 * taps - 1.0;
+        filled = taps / 2 - 1;
+    }
+
+    // The most outputs one process() call may produce; the history is sized for it
+    int max_output_block() const noexcept { return maxOut; }
+
+    // Input samples to write at input(ch) before producing numOut outputs
+    int input_needed(int numOut) const noexcept
+    {
+        const int last = static_cast<int>(position + (numOut - 1) * step);
+        return juce::jmax(0, last + taps / 2 + 1 - filled);
+    }
+
+    double* input(int channel) noexcept { return history[static_cast<std::size_t>(channel)].data() + filled; }
+
+    // After numIn samples were written at input(ch) on every channel
+    void process(int numIn, double* const* out, int numChannels, int numOut) noexcept
+    {
+        filled += numIn;
+        jassert(filled <= capacity);
+
+        double next = position;
+        for (int ch = 0; ch < numChannels; ++ch)
+            next = isa::kernels().resample(table.data(), phases, taps, history[static_cast<std::size_t>(ch)].data(),
+                                           position, step, out[ch], numOut);
+        position = next;
+
+        // Keep from the first input the next output reads
+        const int drop = juce::jlimit(0, filled, static_cast<int>(position) - taps / 2 + 1);
+        if (drop > 0)
+        {
+            for (auto& h : history)
+                std::memmove(h.data(), h.data() + drop, static_cast<std::size_t>(filled - drop) * sizeof(double));
+            filled -= drop;
+            position -= drop;
+        }
+    }
+
+    // The engine renders this far ahead of what is heard, in output samples
+    int getLatency() const { return static_cast<int>(std::lround(0.5 * taps / step)); }
+
+    int getTaps() const { return taps; }
+
+    std::size_t getHeapBytes() const
+    {
+        return (table.capacity() + history.size() * static_cast<std::size_t>(capacity)) * sizeof(double);
+    }
+
+private:
+    double step = 1.0; // input samples per output sample
+    int taps = baseTaps;
+    int maxOut = 1;
+    int capacity = 0;
+    std::vector<double> table;                // phases + 1 rows of taps
+    std::vector<std::vector<double>> history; // per channel, input not yet out of reach
+    double position = 0.0;                    // of the next output, in history samples
+    int filled = 0;
+};
+
+#endif
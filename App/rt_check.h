@@ -0,0 +1,371 @@
+#ifndef RT_CHECK_H
+#define RT_CHECK_H
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "lockfree_ring.h"
+
+/* Real-time safety checker. Code marked with a RealtimeScope (the device
+   callback, and each processor in the --rt-check self-check) must not
+   allocate, lock a mutex or make a blocking syscall. With the checker built in
+   (cmake -DRealtimeSafetyCheck=ON, Linux/glibc only) malloc and friends,
+   pthread_mutex_lock and a handful of blocking syscalls are interposed; a call
+   made inside a RealtimeScope captures its raw stack into a preallocated ring
+   and carries on. The Monitor thread symbolises and logs each new call site
+   once, then only counts repeats.
+
+   Without the checker RealtimeScope is an empty object and nothing is
+   interposed. */
+
+#if defined(TEXTGRAPH_RT_CHECK) && TEXTGRAPH_RT_CHECK && defined(__linux__) && defined(__GLIBC__)
+ #define TEXTGRAPH_RT_CHECK_ACTIVE 1
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <time.h>
+ #include <unistd.h>
+#else
+ #define TEXTGRAPH_RT_CHECK_ACTIVE 0
+#endif
+
+namespace rtcheck
+{
+
+enum class Kind : std::uint8_t { allocation, deallocation, mutex, syscall };
+
+inline const char* kind_name(Kind k)
+{
+    switch (k)
+    {
+        case Kind::allocation:   return "allocation";
+        case Kind::deallocation: return "deallocation";
+        case Kind::mutex:        return "mutex lock";
+        case Kind::syscall:      return "blocking syscall";
+    }
+    return "?";
+}
+
+struct Violation
+{
+    static constexpr int maxFrames = 24;
+
+    Kind kind;
+    const char* call;  // always a string literal
+    std::size_t bytes; // allocations only
+    int depth;
+    void* frames[maxFrames];
+};
+
+// Constant-initialised, so safe to read from malloc before static init runs
+inline thread_local int realtimeDepth = 0;
+inline thread_local bool insideHook = false;
+inline std::atomic<bool> armed { false };
+inline std::atomic<std::uint64_t> violationCount { 0 };
+inline std::atomic<std::uint64_t> droppedCount { 0 };
+
+inline LockFreeRing<Violation, 256>& violations()
+{
+    static LockFreeRing<Violation, 256> ring;
+    return ring;
+}
+
+constexpr bool available() { return TEXTGRAPH_RT_CHECK_ACTIVE != 0; }
+
+// Marks the calling thread as real-time until the scope ends
+struct RealtimeScope
+{
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+    RealtimeScope() noexcept  { ++realtimeDepth; }
+    ~RealtimeScope() noexcept { --realtimeDepth; }
+#else
+    ~RealtimeScope() noexcept {}
+#endif
+};
+
+// Lets known, deliberate non-real-time work (e.g. tracing setup) through
+struct AllowScope
+{
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+    AllowScope() noexcept : saved(realtimeDepth) { realtimeDepth = 0; }
+    ~AllowScope() noexcept { realtimeDepth = saved; }
+    int saved;
+#else
+    ~AllowScope() noexcept {}
+#endif
+};
+
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+
+// Called from the interposed functions; must not allocate or lock itself
+inline void report(Kind kind, const char* call, std::size_t bytes = 0) noexcept
+{
+    if (realtimeDepth <= 0 || insideHook || !armed.load(std::memory_order_relaxed))
+        return;
+
+    insideHook = true;
+    Violation v;
+    v.kind = kind;
+    v.call = call;
+    v.bytes = bytes;
+    v.depth = ::backtrace(v.frames, Violation::maxFrames);
+    violationCount.fetch_add(1, std::memory_order_relaxed);
+    if (!violations().try_push(v))
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    insideHook = false;
+}
+
+template<typename Fn>
+inline Fn next_symbol(const char* name) noexcept
+{
+    return reinterpret_cast<Fn>(::dlsym(RTLD_NEXT, name));
+}
+
+#else
+
+inline void report(Kind, const char*, std::size_t = 0) noexcept {}
+
+#endif
+
+inline std::uint64_t site_hash(const Violation& v)
+{
+    // The first two frames are report() and the interposed function
+    std::uint64_t h = 1469598103934665603ull ^ static_cast<std::uint64_t>(v.kind);
+    for (int i = 2; i < juce::jmin(v.depth, 10); ++i)
+        h = (h ^ reinterpret_cast<std::uintptr_t>(v.frames[i])) * 1099511628211ull;
+    return h;
+}
+
+/* Drains the ring off the audio thread: prints the first violation from each
+   call site with a symbolised stack, counts the rest. */
+class Monitor : private juce::Thread
+{
+public:
+    Monitor() : juce::Thread("rt-check") {}
+    ~Monitor() override { stop(); }
+
+    // Arms the interposers and starts logging. Returns false when the checker
+    // isn't built in.
+    bool start()
+    {
+        if (!available())
+            return false;
+
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+        // backtrace() loads libgcc_s (and allocates) on its first call; get that
+        // out of the way before anything real-time asks for a stack
+        void* warmup[2];
+        ::backtrace(warmup, 2);
+#endif
+        violations(); // and build the ring here rather than on the audio thread
+        armed.store(true, std::memory_order_release);
+        startThread();
+        return true;
+    }
+
+    void stop()
+    {
+        if (isThreadRunning())
+            stopThread(1000);
+        drain();
+    }
+
+    // Logs whatever is waiting in the ring now instead of at the next poll
+    void flush() { drain(); }
+
+    std::uint64_t total() const { return violationCount.load(std::memory_order_relaxed); }
+    std::size_t sites() const { return perSite.size(); }
+
+    // One line per call site, worst first
+    void print_summary(std::ostream& os)
+    {
+        drain();
+        os << "=== Real-time safety ===\n";
+        os << "  violations: " << total() << " from " << perSite.size() << " call site"
+           << (perSite.size() == 1 ? "" : "s");
+        if (auto dropped = droppedCount.load(std::memory_order_relaxed))
+            os << " (" << dropped << " not captured, ring full)";
+        os << '\n';
+
+        std::multimap<std::uint64_t, const Site*, std::greater<>> worst;
+        for (auto const &[hash, site] : perSite)
+            worst.emplace(site.count, &site);
+        for (auto const &[count, site] : worst)
+            os << "  " << count << " x " << kind_name(site->kind) << " (" << site->call << ") at "
+               << site->where << '\n';
+    }
+
+    std::ostream* log = &std::cerr;
+
+private:
+    struct Site
+    {
+        Kind kind;
+        const char* call;
+        std::uint64_t count = 0;
+        std::string where; // innermost frame outside the allocator/libc
+    };
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            drain();
+            wait(200);
+        }
+    }
+
+    void drain()
+    {
+        const juce::ScopedLock sl(drainLock);
+        Violation v;
+        while (violations().try_pop(v))
+        {
+            auto& site = perSite[site_hash(v)];
+            if (site.count++ == 0)
+            {
+                site.kind = v.kind;
+                site.call = v.call;
+                log_first(v, site);
+            }
+        }
+    }
+
+    void log_first(const Violation& v, Site& site)
+    {
+        auto& os = *log;
+        os << "[rt-check] " << kind_name(v.kind) << " on a real-time thread: " << v.call;
+        if (v.kind == Kind::allocation)
+            os << " (" << v.bytes << " bytes)";
+        os << '\n';
+
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+        char** symbols = ::backtrace_symbols(v.frames, v.depth);
+        for (int i = 2; i < v.depth; ++i)
+        {
+            const char* sym = symbols != nullptr ? symbols[i] : "?";
+            os << "    #" << (i - 2) << ' ' << sym << '\n';
+            if (site.where.empty() && std::strstr(sym, "libc.so") == nullptr
+                && std::strstr(sym, "libstdc++") == nullptr)
+                site.where = sym;
+        }
+        ::free(symbols);
+#endif
+        if (site.where.empty())
+            site.where = "(unknown)";
+    }
+
+    juce::CriticalSection drainLock;
+    std::map<std::uint64_t, Site> perSite;
+};
+
+} // namespace rtcheck
+
+#if TEXTGRAPH_RT_CHECK_ACTIVE
+
+/* The interposers. This header is only included from Main.cpp, so these are
+   defined exactly once; the executable's definitions win over libc's for every
+   caller in the process. glibc exports its allocator as __libc_*, which avoids
+   the dlsym-calls-calloc recursion. */
+
+extern "C"
+{
+void* __libc_malloc(std::size_t);
+void* __libc_calloc(std::size_t, std::size_t);
+void* __libc_realloc(void*, std::size_t);
+void* __libc_memalign(std::size_t, std::size_t);
+void  __libc_free(void*);
+
+void* malloc(std::size_t size)
+{
+    rtcheck::report(rtcheck::Kind::allocation, "malloc", size);
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+    rtcheck::report(rtcheck::Kind::allocation, "calloc", count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size)
+{
+    rtcheck::report(rtcheck::Kind::allocation, "realloc", size);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    rtcheck::report(rtcheck::Kind::allocation, "aligned_alloc", size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, std::size_t alignment, std::size_t size)
+{
+    rtcheck::report(rtcheck::Kind::allocation, "posix_memalign", size);
+    *out = __libc_memalign(alignment, size);
+    return *out != nullptr ? 0 : 12; // ENOMEM
+}
+
+void free(void* ptr)
+{
+    if (ptr != nullptr)
+        rtcheck::report(rtcheck::Kind::deallocation, "free");
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    static auto real = rtcheck::next_symbol<int (*)(pthread_mutex_t*)>("pthread_mutex_lock");
+    rtcheck::report(rtcheck::Kind::mutex, "pthread_mutex_lock");
+    return real(mutex);
+}
+
+ssize_t read(int fd, void* buf, std::size_t count)
+{
+    static auto real = rtcheck::next_symbol<ssize_t (*)(int, void*, std::size_t)>("read");
+    rtcheck::report(rtcheck::Kind::syscall, "read");
+    return real(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, std::size_t count)
+{
+    static auto real = rtcheck::next_symbol<ssize_t (*)(int, const void*, std::size_t)>("write");
+    rtcheck::report(rtcheck::Kind::syscall, "write");
+    return real(fd, buf, count);
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+    static auto real = rtcheck::next_symbol<int (*)(struct pollfd*, nfds_t, int)>("poll");
+    rtcheck::report(rtcheck::Kind::syscall, "poll");
+    return real(fds, nfds, timeout);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem)
+{
+    static auto real = rtcheck::next_symbol<int (*)(const struct timespec*, struct timespec*)>("nanosleep");
+    rtcheck::report(rtcheck::Kind::syscall, "nanosleep");
+    return real(req, rem);
+}
+
+int usleep(useconds_t usec)
+{
+    static auto real = rtcheck::next_symbol<int (*)(useconds_t)>("usleep");
+    rtcheck::report(rtcheck::Kind::syscall, "usleep");
+    return real(usec);
+}
+}
+
+#endif
+
+#endif
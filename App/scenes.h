@@ -0,0 +1,247 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "letter_binds.h"
+#include "instrumented.h"
+
+/* Scenes: named snapshots of every letter's numeric parameters, and MORPH
+   between them on the graph that's playing.
+
+     SCENE SAVE calm      snapshot the current bindings
+     SET ...              change some parameters (types stay the same)
+     SCENE SAVE busy
+     MORPH 0.5 2          halfway from calm to busy, gliding over 2 s
+
+   Scenes are kept in the order they were first saved; a morph position of 0
+   is the first, 1 the second, 1.25 a quarter of the way from the second to
+   the third. Every numeric parameter is interpolated (integers round:
+   a pulser's beats, while an oscillator's note glides in pitch).
+
+   A morph never touches the graph. The interpolated values go into the
+   registry, so the next PLAY builds with them, and are posted to every
+   running node of the letter (LiveParams), which the audio thread applies
+   at control rate. So the score and its topology stay as they are: a letter
+   bound to different types in the two scenes keeps its current type and
+   parameters, and a letter the score doesn't use only changes the registry. */
+
+class SceneBank
+{
+public:
+    struct Letter
+    {
+        std::string type;
+        std::vector<double> values;
+    };
+
+    struct Scene
+    {
+        std::string name;
+        std::map<char, Letter> letters;
+    };
+
+    // Replaces a scene of the same name in place, otherwise adds one at the end
+    void capture(const std::string& name, const LetterRegistry& reg)
+    {
+        Scene scene { name, {} };
+        for (char letter : reg.getBoundLetters())
+            scene.letters[letter] = { std::string(reg.type_name(letter)), reg.param_values(letter) };
+
+        auto it = find(name);
+        if (it != scenes.end())
+            *it = std::move(scene);
+        else
+            scenes.push_back(std::move(scene));
+    }
+
+    bool remove(const std::string& name)
+    {
+        auto it = find(name);
+        if (it == scenes.end())
+            return false;
+        scenes.erase(it);
+        current = juce::jlimit(0.0, juce::jmax(0.0, size() - 1.0), current);
+        return true;
+    }
+
+    int size() const { return static_cast<int>(scenes.size()); }
+
+    // SET and SCENE SAVE commands that save every scene again, in order (the
+    // preamble of a journal); they leave the registry bound to the last scene
+    std::vector<std::string> replay_lines() const
+    {
+        std::vector<std::string> lines;
+        for (const auto& scene : scenes)
+        {
+            LetterRegistry values;
+            for (const auto& [letter, l] : scene.letters)
+            {
+                TypeTable::bind(values, letter, l.type, {});
+                values.set_param_values(letter, l.values);
+            }
+            for (auto& line : values.set_lines())
+                lines.push_back(std::move(line));
+            lines.push_back("SCENE SAVE " + scene.name);
+        }
+        return lines;
+    }
+
+    // The highest value each parameter of each letter takes in any scene (and
+    // in the registry now, if given); the parser sizes render rates by it
+    // (Parser::morph_highest)
+    std::map<char, std::vector<double>> highest(const LetterRegistry* now = nullptr) const
+    {
+        std::map<char, std::vector<double>> top;
+        if (now != nullptr)
+            for (char letter : now->getBoundLetters())
+                top[letter] = now->param_values(letter);
+        for (const auto& scene : scenes)
+            for (const auto& [letter, l] : scene.letters)
+            {
+                auto& v = top[letter];
+                if (v.size() < l.values.size())
+                    v.resize(l.values.size(), -std::numeric_limits<double>::infinity());
+                for (std::size_t k = 0; k < l.values.size(); ++k)
+                    v[k] = juce::jmax(v[k], l.values[k]);
+            }
+        return top;
+    }
+
+    // Position of a scene by name, -1 if there's none
+    int index_of(const std::string& name) const
+    {
+        auto it = std::find_if(scenes.begin(), scenes.end(), [&](const Scene& s) { return s.name == name; });
+        return it == scenes.end() ? -1 : static_cast<int>(it - scenes.begin());
+    }
+
+    struct MorphResult
+    {
+        int letters = 0; // changed in the registry
+        int nodes = 0;   // running nodes posted to
+        std::vector<char> skipped; // bound to another type now or in one of the scenes
+    };
+
+    MorphResult morph(double position, double glideSeconds, LetterRegistry& reg, juce::AudioProcessorGraph& graph)
+    {
+        MorphResult result;
+        if (scenes.empty())
+            return result;
+
+        current = juce::jlimit(0.0, size() - 1.0, position);
+        const int i = juce::jmin(static_cast<int>(current), size() - 1);
+        const double t = current - i;
+        const Scene& a = scenes[static_cast<std::size_t>(i)];
+        const Scene& b = scenes[static_cast<std::size_t>(juce::jmin(i + 1, size() - 1))];
+
+        std::map<char, std::vector<double>> values;
+        for (const auto& [letter, from] : a.letters)
+        {
+            auto to = b.letters.find(letter);
+            if (!reg.is_bound(letter) || reg.type_name(letter) != from.type
+                || (to != b.letters.end() && to->second.type != from.type))
+            {
+                result.skipped.push_back(letter);
+                continue;
+            }
+
+            auto& v = values[letter];
+            v = from.values;
+            if (to != b.letters.end())
+                for (std::size_t k = 0; k < v.size() && k < to->second.values.size(); ++k)
+                    v[k] += (to->second.values[k] - v[k]) * t;
+            reg.set_param_values(letter, v);
+            ++result.letters;
+        }
+
+        for (auto* node : graph.getNodes())
+        {
+            auto* info = node_info(node->getProcessor());
+            if (info == nullptr)
+                continue;
+            auto it = values.find(info->letter);
+            if (it == values.end() || static_cast<int>(it->second.size()) != info->live.size())
+                continue;
+            info->live.post(it->second.data(), glideSeconds);
+            ++result.nodes;
+        }
+        return result;
+    }
+
+    void print(std::ostream& os, const LetterRegistry& reg) const
+    {
+        if (scenes.empty())
+        {
+            os << "No scenes saved (SCENE SAVE <name>).\n";
+            return;
+        }
+        os << "Scenes (MORPH position " << current << "):\n";
+        for (std::size_t s = 0; s < scenes.size(); ++s)
+        {
+            const auto& scene = scenes[s];
+            os << "  " << s << "  " << scene.name << ": " << scene.letters.size() << " letters";
+
+            // What moves between this scene and the next
+            if (s + 1 < scenes.size())
+            {
+                int differ = 0;
+                for (const auto& [letter, l] : scene.letters)
+                {
+                    auto other = scenes[s + 1].letters.find(letter);
+                    if (other != scenes[s + 1].letters.end() && other->second.type == l.type && other->second.values != l.values)
+                        ++differ;
+                }
+                os << ", " << differ << " differ from " << scenes[s + 1].name;
+            }
+            os << '\n';
+        }
+
+        // Parameters that differ anywhere, scene by scene
+        for (char letter : reg.getBoundLetters())
+        {
+            const auto names = reg.param_names(letter);
+            for (std::size_t k = 0; k < names.size(); ++k)
+            {
+                bool varies = false;
+                for (const auto& scene : scenes)
+                {
+                    auto l = scene.letters.find(letter);
+                    auto first = scenes.front().letters.find(letter);
+                    if (l == scene.letters.end() || first == scenes.front().letters.end() || k >= l->second.values.size()
+                        || k >= first->second.values.size() || l->second.values[k] != first->second.values[k])
+                        varies = true;
+                }
+                if (!varies)
+                    continue;
+                os << "    '" << letter << "' " << names[k] << ":";
+                for (const auto& scene : scenes)
+                {
+                    auto l = scene.letters.find(letter);
+                    if (l == scene.letters.end() || k >= l->second.values.size())
+                        os << " -";
+                    else
+                        os << ' ' << l->second.values[k];
+                }
+                os << '\n';
+            }
+        }
+    }
+
+private:
+    std::vector<Scene>::iterator find(const std::string& name)
+    {
+        return std::find_if(scenes.begin(), scenes.end(), [&](const Scene& s) { return s.name == name; });
+    }
+
+    std::vector<Scene> scenes;
+    double current = 0.0;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef SCORE_PROFILE_H
+#define SCORE_PROFILE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "graph_export.h"
+
+/* PROFILE command: what the running score costs, shown on the score itself.
+
+     PROFILE [seconds]       measure (1 s by default) and annotate the score
+
+   Every node remembers the word and character of the score it was created
+   from, so GRAPH's per-node measurements map straight back onto the text.
+   Under each line of the score come two rows, one mark per letter:
+
+     cpu     the letter's share of all node time, " .:-=+*#%@" from nothing
+             to the most expensive letter in the score
+     silent  tenths of its blocks that came out silent (9: 90% or more)
+
+   followed by the letters ranked by cost and each word's total. A letter
+   that costs a lot and is mostly silent is playing into a closed gate or a
+   muted chain: the first place to look when a score runs out of CPU. */
+
+namespace score_profile
+{
+
+struct Mark
+{
+    const graph_export::Node* node = nullptr;
+    int column = 0;             // in the score as words joined by spaces
+};
+
+inline std::vector<Mark> marks(const graph_export::Snapshot& s, std::vector<int>& wordStart)
+{
+    wordStart.clear();
+    int column = 0;
+    for (const auto& w : s.words)
+    {
+        wordStart.push_back(column);
+        column += static_cast<int>(w.size()) + 1;
+    }
+
+    std::vector<Mark> out;
+    for (const auto& n : s.nodes)
+        if (n.letter != 0 && n.word >= 0 && static_cast<std::size_t>(n.word) < s.words.size() && n.offset >= 0)
+            out.push_back({ &n, wordStart[static_cast<std::size_t>(n.word)] + n.offset });
+    return out;
+}
+
+inline void print(std::ostream& os, const graph_export::Snapshot& s)
+{
+    std::vector<int> wordStart;
+    auto letters = marks(s, wordStart);
+    if (letters.empty())
+    {
+        os << "Nothing to profile: PLAY a score first\n";
+        return;
+    }
+
+    std::string score;
+    for (const auto& w : s.words)
+        score += (score.empty() ? "" : " ") + w;
+
+    double busiest = 0.0;
+    for (const auto& m : letters)
+        busiest = std::max(busiest, m.node->cpuShare);
+
+    static constexpr char heat[] = " .:-=+*#%@";
+    std::string cpu(score.size(), ' '), silent(score.size(), ' ');
+    for (const auto& m : letters)
+    {
+        const auto c = static_cast<std::size_t>(m.column);
+        const int level = busiest > 0.0 ? static_cast<int>(m.node->cpuShare / busiest * 9.0 + 0.5) : 0;
+        cpu[c] = heat[std::clamp(level, m.node->cpuShare > 0.0 ? 1 : 0, 9)];
+        silent[c] = static_cast<char>('0' + std::min(9, static_cast<int>(m.node->silentRatio * 10.0)));
+    }
+
+    char text[200];
+    std::snprintf(text, sizeof(text), "=== Score profile over %.1f s (%d letters) ===\n",
+                  s.window, static_cast<int>(letters.size()));
+    os << text;
+
+    // Wrapped at a space where the score is long
+    constexpr std::size_t width = 64;
+    for (std::size_t from = 0; from < score.size();)
+    {
+        std::size_t to = std::min(score.size(), from + width);
+        if (to < score.size())
+            if (const auto space = score.rfind(' ', to); space != std::string::npos && space > from)
+                to = space + 1;
+        os << "  score   " << score.substr(from, to - from) << '\n'
+           << "  cpu     " << cpu.substr(from, to - from) << '\n'
+           << "  silent  " << silent.substr(from, to - from) << "\n\n";
+        from = to;
+    }
+
+    std::sort(letters.begin(), letters.end(),
+              [](const Mark& a, const Mark& b) { return a.node->cpuShare > b.node->cpuShare; });
+    os << "     CPU  letter       where          us/block  silent\n";
+    for (const auto& m : letters)
+    {
+        const auto& n = *m.node;
+        const std::string where = "word " + std::to_string(n.word) + " char " + std::to_string(n.offset);
+        std::snprintf(text, sizeof(text), "  %5.1f%%  %c %-10.10s %-14s %8.2f   %4.0f%%%s\n",
+                      100.0 * n.cpuShare, n.letter, n.type.c_str(), where.c_str(), n.usPerBlock,
+                      100.0 * n.silentRatio, n.cpuShare >= 0.05 && n.silentRatio >= 0.5 ? "  <- mostly silent" : "");
+        os << text;
+    }
+
+    os << "  by word:";
+    for (std::size_t w = 0; w < s.words.size(); ++w)
+    {
+        double share = 0.0;
+        for (const auto& m : letters)
+            share += m.node->word == static_cast<int>(w) ? m.node->cpuShare : 0.0;
+        std::snprintf(text, sizeof(text), "%s %s %.1f%%", w ? "," : "", s.words[w].c_str(), 100.0 * share);
+        os << text;
+    }
+    os << '\n';
+}
+
+} // namespace score_profile
+
+#endif
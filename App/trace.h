@@ -0,0 +1,230 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "lockfree_ring.h"
+#include "realtime_setup.h"
+
+/* Opt-in timeline tracing. Any thread (the audio callback, graph nodes, the
+   input thread rebuilding the graph) records complete begin/end events into a
+   preallocated lock-free ring; a background thread drains it into a Chrome
+   trace JSON file that opens directly in Perfetto or chrome://tracing.
+
+   While tracing is off, recording costs a single relaxed atomic load. */
+
+struct TraceEvent
+{
+    char         name[32];
+    const char*  category; // always a string literal
+    std::int64_t startUs;
+    std::int64_t durationUs;
+    std::uint32_t tid;
+    char         phase;    // 'X' complete event, 'M' thread name metadata
+};
+
+class Tracer
+{
+public:
+    static Tracer& get()
+    {
+        static Tracer t;
+        return t;
+    }
+
+    static std::int64_t nowUs() noexcept
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Gives the calling thread a readable name in the trace viewer. The pointer
+    // must stay valid for the life of the thread (use a literal).
+    static void nameThisThread(const char* name) noexcept
+    {
+        threadState().name = name;
+    }
+
+    // The name given to nameThisThread, or nullptr
+    static const char* threadName() noexcept
+    {
+        return threadState().name;
+    }
+
+    bool isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    bool start(const std::string& path)
+    {
+        stop();
+
+        out.open(path, std::ios::out | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        out << "{\"traceEvents\":[\n";
+        firstEvent = true;
+        dropped.store(0, std::memory_order_relaxed);
+        session.fetch_add(1, std::memory_order_relaxed);
+        enabled.store(true, std::memory_order_release);
+        writer.startThread();
+        return true;
+    }
+
+    void stop()
+    {
+        if (!out.is_open())
+            return;
+
+        enabled.store(false, std::memory_order_release);
+        writer.stopThread(2000);
+        drain();
+        out << "\n]}\n";
+        out.close();
+    }
+
+    void record(const char* category, const char* name,
+                std::int64_t startUs, std::int64_t endUs) noexcept
+    {
+        if (!isEnabled())
+            return;
+
+        auto& ts = threadState();
+        if (ts.session != session.load(std::memory_order_relaxed))
+        {
+            ts.session = session.load(std::memory_order_relaxed);
+            if (ts.name != nullptr)
+                push('M', "thread_name", ts.name, 0, 0, ts.id);
+        }
+        push('X', category, name, startUs, endUs - startUs, ts.id);
+    }
+
+    std::uint64_t getDroppedCount() const noexcept { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct ThreadState
+    {
+        std::uint32_t id;
+        std::uint32_t session = 0;
+        const char* name = nullptr;
+    };
+
+    static ThreadState& threadState() noexcept
+    {
+        static std::atomic<std::uint32_t> nextId { 1 };
+        thread_local ThreadState ts { nextId.fetch_add(1, std::memory_order_relaxed) };
+        return ts;
+    }
+
+    void push(char phase, const char* category, const char* name,
+              std::int64_t startUs, std::int64_t durationUs, std::uint32_t tid) noexcept
+    {
+        TraceEvent e;
+        std::strncpy(e.name, name, sizeof(e.name) - 1);
+        e.name[sizeof(e.name) - 1] = '\0';
+        e.category = category;
+        e.startUs = startUs;
+        e.durationUs = durationUs;
+        e.tid = tid;
+        e.phase = phase;
+
+        if (!ring.try_push(e))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void writeEscaped(std::ostream& os, const char* s)
+    {
+        for (; *s != '\0'; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+                os << '\\';
+            if (static_cast<unsigned char>(*s) >= 0x20)
+                os << *s;
+        }
+    }
+
+    void drain()
+    {
+        TraceEvent e;
+        while (ring.try_pop(e))
+        {
+            out << (firstEvent ? "" : ",\n");
+            firstEvent = false;
+
+            if (e.phase == 'M')
+            {
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << e.tid
+                    << ",\"args\":{\"name\":\"";
+                writeEscaped(out, e.name);
+                out << "\"}}";
+            }
+            else
+            {
+                out << "{\"name\":\"";
+                writeEscaped(out, e.name);
+                out << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"ts\":" << e.startUs
+                    << ",\"dur\":" << e.durationUs << ",\"pid\":1,\"tid\":" << e.tid << "}";
+            }
+        }
+        out.flush();
+    }
+
+    struct Writer : juce::Thread
+    {
+        explicit Writer(Tracer& t) : juce::Thread("Trace writer"), owner(t) {}
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                RealtimeSetup::get().sync(RealtimeSetup::Role::worker);
+                owner.drain();
+                wait(50);
+            }
+        }
+
+        Tracer& owner;
+    };
+
+    Tracer() = default;
+    ~Tracer() { stop(); }
+
+    LockFreeRing<TraceEvent, 1 << 16> ring;
+    std::atomic<bool> enabled { false };
+    std::atomic<std::uint32_t> session { 0 };
+    std::atomic<std::uint64_t> dropped { 0 };
+
+    std::ofstream out;
+    bool firstEvent = true;
+    Writer writer { *this };
+};
+
+// RAII helper for tracing a scope on a non-audio thread.
+class TraceScope
+{
+public:
+    TraceScope(const char* category_in, const char* name_in)
+        : category(category_in), name(name_in),
+          startUs(Tracer::get().isEnabled() ? Tracer::nowUs() : 0) {}
+
+    ~TraceScope()
+    {
+        if (startUs != 0)
+            Tracer::get().record(category, name, startUs, Tracer::nowUs());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* category;
+    const char* name;
+    std::int64_t startUs;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef UPSAMPLER_H
+#define UPSAMPLER_H
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "isa_dispatch.h"
+
+/* Integer-factor polyphase interpolator, used by voices that render below the
+   device rate (see OscillatorBase's multi-rate mode).
+
+   The prototype is a Kaiser-windowed sinc with its cutoff at the low rate's
+   Nyquist: flat to 0.4 x the low rate, better than 70 dB down from 0.6 x.
+   It's split into `factor` phases of tapsPerPhase coefficients, so each output
+   sample is one short dot product against the input history. The history is
+   stored twice over, so that dot product always reads contiguous memory and
+   the compiler can vectorise it; the loop itself is isa::kernels().polyphase,
+   built for each instruction set the CPU might have. */
+
+class PolyphaseUpsampler
+{
+public:
+    static constexpr int tapsPerPhase = 24; // a multiple of isa::body::lanes
+
+    void prepare(int factor_in)
+    {
+        factor = juce::jmax(1, factor_in);
+        const int numTaps = tapsPerPhase * factor;
+
+        // Kaiser window, beta for ~75 dB stopband
+        constexpr double beta = 7.5;
+        const double centre = 0.5 * (numTaps - 1);
+        const double cutoff = 0.5 / factor; // cycles per output sample
+        const double norm = std::cyl_bessel_i(0.0, beta);
+
+        phases.assign(static_cast<std::size_t>(numTaps), 0.0);
+        for (int n = 0; n < numTaps; ++n)
+        {
+            const double t = n - centre;
+            const double sinc = t == 0.0 ? 2.0 * cutoff
+                                         : std::sin(2.0 * juce::MathConstants<double>::pi * cutoff * t)
+                                               / (juce::MathConstants<double>::pi * t);
+            const double r = t / centre;
+            const double window = std::cyl_bessel_i(0.0, beta * std::sqrt(juce::jmax(0.0, 1.0 - r * r))) / norm;
+
+            // Tap n belongs to phase n % factor; the factor makes up for the
+            // zeros an upsampler would have stuffed between input samples
+            const int phase = n % factor, j = n / factor;
+            phases[static_cast<std::size_t>(phase * tapsPerPhase + j)] = factor * sinc * window;
+        }
+
+        history.assign(2 * tapsPerPhase, 0.0);
+        position = 0;
+    }
+
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), 0.0);
+        position = 0;
+    }
+
+    int getFactor() const { return factor; }
+
+    // Group delay, in output samples (the half sample left over is ignored)
+    static constexpr int latency_for(int factor) { return (tapsPerPhase * factor - 1) / 2; }
+    int getLatency() const { return latency_for(factor); }
+
+    // Writes numIn * factor samples to out
+    void process(const double* in, int numIn, double* out) noexcept
+    {
+        position = isa::kernels().polyphase(phases.data(), factor, tapsPerPhase, history.data(), position,
+                                            in, numIn, out);
+    }
+
+    std::size_t getHeapBytes() const
+    {
+        return (phases.capacity() + history.capacity()) * sizeof(double);
+    }
+
+private:
+    int factor = 1;
+    std::vector<double> phases;  // factor rows of tapsPerPhase
+    std::vector<double> history; // last tapsPerPhase inputs, twice
+    int position = 0;
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef USER_INPUT_H
+#define USER_INPUT_H
+
 #include <iostream>
 #include <string>
 #include <thread>
@@ -72,4 +75,6 @@ public:
         ++cur_;
         return m;
     }
-};
\ No newline at end of file
+};
+
+#endif
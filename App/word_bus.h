@@ -0,0 +1,70 @@
+#ifndef WORD_BUS_H
+#define WORD_BUS_H
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+/* Pass-through node that collects everything one score word sends to the
+   output. The parser only inserts these when asked (offline renders, where we
+   want to look at each word on its own); in normal playback words connect
+   straight to the audio output. While a capture buffer is attached, every
+   block that passes through is appended to it. */
+
+class WordBus : public juce::AudioProcessor
+{
+public:
+    explicit WordBus(int word_in)
+        : AudioProcessor (BusesProperties().withInput ("Input", juce::AudioChannelSet::stereo())
+                                           .withOutput ("Output", juce::AudioChannelSet::stereo())),
+          word(word_in)
+    {}
+
+    void prepareToPlay (double, int) override {}
+    void releaseResources() override {}
+
+    void processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer&) override
+    {
+        if (capture == nullptr)
+            return;
+
+        const int n = juce::jmin(buffer.getNumSamples(), capture->getNumSamples() - capturePosition);
+        for (int ch = 0; ch < juce::jmin(buffer.getNumChannels(), capture->getNumChannels()); ++ch)
+            capture->copyFrom(ch, capturePosition, buffer, ch, 0, juce::jmax(0, n));
+        capturePosition += juce::jmax(0, n);
+    }
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override {}
+
+    void capture_into(juce::AudioBuffer<double>* dest, int startSample = 0)
+    {
+        capture = dest;
+        capturePosition = startSample;
+    }
+
+    int get_word() const { return word; }
+
+    bool supportsDoublePrecisionProcessing() const override      { return true; }
+    const juce::String getName() const override                  { return "Word Bus"; }
+    juce::AudioProcessorEditor* createEditor() override          { return nullptr; }
+    bool hasEditor() const override                              { return false; }
+    bool acceptsMidi() const override                            { return false; }
+    bool producesMidi() const override                           { return false; }
+    double getTailLengthSeconds() const override                 { return 0; }
+    int getNumPrograms() override                                { return 1; }
+    int getCurrentProgram() override                             { return 0; }
+    void setCurrentProgram (int) override                        {}
+    const juce::String getProgramName (int) override             { return {}; }
+    void changeProgramName (int, const juce::String&) override   {}
+    void getStateInformation (juce::MemoryBlock&) override       {}
+    void setStateInformation (const void*, int) override         {}
+
+private:
+    int word;
+    juce::AudioBuffer<double>* capture = nullptr;
+    int capturePosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WordBus)
+};
+
+#endif